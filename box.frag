@@ -0,0 +1,38 @@
+#version 400
+
+// Box blur along DIRECTION from prefix sums (scan.frag and carry.frag): the
+// average of the 2 * RADIUS + 1 pixels around is the difference of two 
+// sums, two lookups whatever the RADIUS. Pixels past the image count as 0,
+// as in the other filters. Repeated boxes make a tent or a gaussian, see 
+// tent.pipeline and boxgauss.pipeline.
+
+#ifndef DIRECTION
+#define DIRECTION ivec2(1, 0)
+#endif
+
+#ifndef RADIUS
+#define RADIUS 25
+#endif
+
+#pragma cpu(box)
+#pragma footprint(RADIUS)
+
+uniform sampler2D uTexture;
+uniform uvec2 uTextureSize;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    ivec2 pixel = ivec2(vTexCoord);
+    int   i     = pixel.x * DIRECTION.x + pixel.y * DIRECTION.y;
+    int   last  = int(uTextureSize.x) * DIRECTION.x + int(uTextureSize.y) * DIRECTION.y - 1;
+
+    // past the end the sum stays at the last one, before the start it is 0
+    vec3 hi = texelFetch(uTexture, pixel + DIRECTION * (min(i + RADIUS, last) - i), 0).rgb;
+    vec3 lo = i > RADIUS ? texelFetch(uTexture, pixel - DIRECTION * (RADIUS + 1), 0).rgb : vec3(0);
+
+    oFragColor = vec4((hi - lo) / float(2 * RADIUS + 1), 1);
+}
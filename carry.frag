@@ -0,0 +1,38 @@
+#version 400
+
+// Completes the prefix sums of scan.frag: adds the last sum of every run
+// of CHUNK pixels before this one along DIRECTION. DIRECTION and CHUNK 
+// must be the same as for scan.frag. The cost grows with the length of 
+// the rows over CHUNK, not with any radius.
+
+#ifndef DIRECTION
+#define DIRECTION ivec2(1, 0)
+#endif
+
+#ifndef CHUNK
+#define CHUNK 128
+#endif
+
+#pragma cpu(carry)
+#pragma output(rgba32f)
+
+uniform sampler2D uTexture;
+uniform uvec2 uTextureSize;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    ivec2 pixel = ivec2(vTexCoord);
+    int   i     = pixel.x * DIRECTION.x + pixel.y * DIRECTION.y;
+
+    vec3 carry = vec3(0);
+    for (int end = CHUNK - 1; end < i - i % CHUNK; end += CHUNK)
+    {
+        carry += texelFetch(uTexture, pixel + DIRECTION * (end - i), 0).rgb;
+    }
+
+    oFragColor = vec4(texelFetch(uTexture, pixel, 0).rgb + carry, 1);
+}
@@ -1,5 +1,8 @@
 #version 400
 
+#pragma cpu(faichen)
+#pragma footprint(1)
+
 uniform sampler2D uTexture;
 uniform uvec2 uTextureSize;
 
@@ -0,0 +1,13 @@
+#version 330 core
+
+// Gamma correction, out = in ^ (1 / GAMMA); alpha is kept.
+#pragma pointwise
+
+#ifndef GAMMA
+#define GAMMA 2.2
+#endif
+
+vec4 apply(vec4 color)
+{
+    return vec4(pow(color.rgb, vec3(1.0 / GAMMA)), color.a);
+}
@@ -1,23 +1,31 @@
 
 #version 400
 
-const int   kernelSize = 15;
+#include "gauss.glsl"
+
+// blur along x by default, DIRECTION=ivec2(0,1) for y
+#ifndef DIRECTION
+#define DIRECTION ivec2(1, 0)
+#endif
+
+#pragma cpu(gauss)
+#pragma footprint(KERNEL_SIZE)
 
 uniform sampler2D uTexture;
 uniform uvec2 uTextureSize;
 
 in vec2 vTexCoord;
-in float kernel[kernelSize];
+in float kernel[KERNEL_SIZE];
 
 out vec4 oFragColor;
 
 void main(void)
 {	
     vec3 result = vec3(0);
-    for (int i = -kernelSize; i <= kernelSize; i++)
+    for (int i = 1 - KERNEL_SIZE; i < KERNEL_SIZE; i++)
     {
         float f = kernel[abs(i)]; 
-        result += texelFetch(uTexture, ivec2(vTexCoord) + ivec2(i, 0), 0).rgb * f;
+        result += texelFetch(uTexture, ivec2(vTexCoord) + DIRECTION * i, 0).rgb * f;
     }
     
     oFragColor = vec4(result, 1);
@@ -0,0 +1,13 @@
+
+// Shared by gauss.vert and gauss.frag; override with -D KERNEL_SIZE=N.
+// KERNEL_SIZE is the half width including the center, so the filter is 
+// 2 * KERNEL_SIZE - 1 taps wide. The weights are passed as varyings, which
+// limits KERNEL_SIZE to about 60.
+
+#ifndef KERNEL_SIZE
+#define KERNEL_SIZE 15
+#endif
+
+#ifndef SIGMA
+#define SIGMA (KERNEL_SIZE / 3.0)
+#endif
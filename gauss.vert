@@ -1,10 +1,7 @@
 
 #version 400
 
-const int   kernelSize = 25;
-float sigma      = 0.3;
-float PI         = 3.14159265358979323846;
-float mean       = kernelSize / 2.0;
+#include "gauss.glsl"
         
 in vec3 aVertex;
 in vec3 aNormal;
@@ -12,18 +9,17 @@ in vec2 aTexCoord;
 in vec3 aTangent;
 
 out vec2 vTexCoord;
-out float kernel[kernelSize];
+out float kernel[KERNEL_SIZE];
 
 void main()
 {	
     float sum = 0;
-    for (int x = 0; x < kernelSize; ++x) 
+    for (int x = 0; x < KERNEL_SIZE; ++x) 
     {
-        kernel[x] = sqrt( exp( -0.5 * (pow((x-mean)/sigma, 2.0) + pow((mean)/sigma,2.0)) )
-            / (2 * PI * sigma * sigma) );
-        sum += kernel[x];
+        kernel[x] = exp(-0.5 * pow(x / SIGMA, 2.0));
+        sum += x == 0 ? kernel[x] : 2.0 * kernel[x];
     }
-    for (int x = 0; x < kernelSize; ++x) 
+    for (int x = 0; x < KERNEL_SIZE; ++x) 
     {
         kernel[x] /= sum;
     }
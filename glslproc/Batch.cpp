@@ -0,0 +1,345 @@
+
+#include "Batch.h"
+
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <deque>
+#include <iostream>
+
+#include "Queue.h"
+
+namespace glslproc
+{
+    struct Image
+    {
+        Job           job;
+        pkzo::Texture texture;
+
+        Image() {}
+
+        Image(const Job& j, pkzo::Texture&& t)
+        : job(j), texture(std::move(t)) {}
+
+        Image(Image&& other)
+        : job(std::move(other.job)), texture(std::move(other.texture)) {}
+
+        const Image& operator = (Image&& other)
+        {
+            job     = std::move(other.job);
+            texture = std::move(other.texture);
+            return *this;
+        }
+    };
+
+    // What the decoders hand to the GL thread. Images the processor takes
+    // in one piece are decoded straight into its staging memory: a REQUEST 
+    // for memory of the size and format is answered through the promise,
+    // the decoder fills it and sends it back STAGED, or FAILED after an 
+    // error. Other images come decoded into a TEXTURE.
+    struct Decoded
+    {
+        enum Kind
+        {
+            TEXTURE,
+            REQUEST,
+            STAGED,
+            FAILED
+        };
+
+        Kind                         kind;
+        Job                          job;
+        pkzo::Texture                texture;
+        rgm::uvec2                   size;
+        pkzo::ColorFormat            format;
+        pkzo::Staging                staging;
+        std::promise<pkzo::Staging>* promise;
+
+        Decoded()
+        : kind(TEXTURE), format(pkzo::NOCF), promise(NULL) {}
+
+        Decoded(Kind k, const Job& j, rgm::uvec2 z, pkzo::ColorFormat f)
+        : kind(k), job(j), size(z), format(f), promise(NULL) {}
+
+        Decoded(Decoded&& other)
+        : kind(other.kind), job(std::move(other.job)), texture(std::move(other.texture)), size(other.size), format(other.format), staging(other.staging), promise(other.promise) {}
+
+        const Decoded& operator = (Decoded&& other)
+        {
+            kind    = other.kind;
+            job     = std::move(other.job);
+            texture = std::move(other.texture);
+            size    = other.size;
+            format  = other.format;
+            staging = other.staging;
+            promise = other.promise;
+            return *this;
+        }
+    };
+
+    struct Pending
+    {
+        Job            job;
+        pkzo::Readback readback;
+
+        Pending(const Job& j, pkzo::Readback&& r)
+        : job(j), readback(std::move(r)) {}
+
+        Pending(Pending&& other)
+        : job(std::move(other.job)), readback(std::move(other.readback)) {}
+
+        const Pending& operator = (Pending&& other)
+        {
+            job      = std::move(other.job);
+            readback = std::move(other.readback);
+            return *this;
+        }
+    };
+
+    void report(std::mutex& mutex, const Job& job, const std::exception& ex)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cerr << job.input << ": " << ex.what() << std::endl;
+    }
+
+    Batch::Batch(Processor& p, unsigned int d, unsigned int e)
+    : processor(&p), cpu_processor(NULL), decoders(std::max(d, 1u)), encoders(std::max(e, 1u)), strip_height(0) {}
+
+    Batch::Batch(CpuProcessor& p, unsigned int d, unsigned int e)
+    : processor(NULL), cpu_processor(&p), decoders(std::max(d, 1u)), encoders(std::max(e, 1u)), strip_height(0) {}
+
+    void Batch::set_strip_height(unsigned int value)
+    {
+        strip_height = value;
+    }
+
+    unsigned int Batch::get_strip_height() const
+    {
+        return strip_height;
+    }
+
+    unsigned int Batch::run(const std::vector<Job>& jobs)
+    {
+        if (strip_height != 0)
+        {
+            return run_streamed(jobs);
+        }
+
+        // each queue holds a few images per worker feeding it, enough to 
+        // smooth out jitter without holding the whole batch in memory
+        Queue<Decoded> decoded(2 * decoders);
+        Queue<Image>   rendered(2 * encoders);
+
+        std::mutex                log_mutex;
+        std::atomic<unsigned int> failed(0);
+        std::atomic<size_t>       next(0);
+        std::atomic<unsigned int> decoding(decoders);
+
+        std::vector<std::thread> threads;
+
+        for (unsigned int i = 0; i < decoders; i++)
+        {
+            threads.push_back(std::thread([&] () {
+                size_t j = next++;
+                while (j < jobs.size())
+                {
+                    try
+                    {
+                        pkzo::PngReader reader(jobs[j].input);
+                        rgm::uvec2      size = reader.get_size();
+
+                        Decoded image(Decoded::TEXTURE, jobs[j], size, reader.get_format());
+                        if (processor != NULL && !processor->needs_tiling(size) && size[0] * size[1] != 0)
+                        {
+                            std::promise<pkzo::Staging> promise;
+                            std::future<pkzo::Staging>  staging = promise.get_future();
+
+                            Decoded request(Decoded::REQUEST, jobs[j], size, reader.get_format());
+                            request.promise = &promise;
+                            if (!decoded.push(std::move(request)))
+                            {
+                                break;
+                            }
+
+                            image.kind    = Decoded::STAGED;
+                            image.staging = staging.get();
+                            try
+                            {
+                                reader.read(image.staging.data, size[1], reader.get_stride());
+                            }
+                            catch (...)
+                            {
+                                image.kind = Decoded::FAILED;
+                                decoded.push(std::move(image));
+                                throw;
+                            }
+                        }
+                        else
+                        {
+                            std::vector<unsigned char> buffer(size[1] * reader.get_stride());
+                            if (!buffer.empty())
+                            {
+                                reader.read(&buffer[0], size[1], reader.get_stride());
+                            }
+                            image.texture = pkzo::Texture(size, reader.get_format(), std::move(buffer));
+                        }
+
+                        if (!decoded.push(std::move(image)))
+                        {
+                            break;
+                        }
+                    }
+                    catch (std::exception& ex)
+                    {
+                        report(log_mutex, jobs[j], ex);
+                        failed++;
+                    }
+                    j = next++;
+                }
+
+                if (--decoding == 0)
+                {
+                    decoded.close();
+                }
+            }));
+        }
+
+        for (unsigned int i = 0; i < encoders; i++)
+        {
+            threads.push_back(std::thread([&] () {
+                Image image;
+                while (rendered.pop(image))
+                {
+                    try
+                    {
+                        image.texture.save(image.job.output);
+                    }
+                    catch (std::exception& ex)
+                    {
+                        report(log_mutex, image.job, ex);
+                        failed++;
+                    }
+                    // free the pixels now, not when the next image comes in
+                    image.texture = pkzo::Texture();
+                }
+            }));
+        }
+
+        // The GL context is bound to this thread, so rendering happens here.
+        // Readbacks are collected once they are done or when too many are in
+        // flight; the GPU can already work on the next image meanwhile.
+        std::deque<Pending> pending;
+        auto collect = [&] () {
+            Pending p = std::move(pending.front());
+            pending.pop_front();
+            try
+            {
+                rendered.push(Image(p.job, p.readback.get()));
+            }
+            catch (std::exception& ex)
+            {
+                report(log_mutex, p.job, ex);
+                failed++;
+            }
+        };
+
+        Decoded image;
+        while (decoded.pop(image))
+        {
+            try
+            {
+                if (image.kind == Decoded::REQUEST)
+                {
+                    try
+                    {
+                        image.promise->set_value(processor->stage(image.size, image.format));
+                    }
+                    catch (...)
+                    {
+                        image.promise->set_exception(std::current_exception());
+                    }
+                    continue;
+                }
+
+                if (image.kind == Decoded::FAILED)
+                {
+                    // the decoder already reported it
+                    processor->discard(image.staging);
+                    continue;
+                }
+
+                if (cpu_processor != NULL)
+                {
+                    pkzo::Texture result = cpu_processor->process(image.texture);
+                    image.texture = pkzo::Texture();
+                    rendered.push(Image(image.job, std::move(result)));
+                    continue;
+                }
+
+                if (image.kind == Decoded::TEXTURE && processor->needs_tiling(image.size))
+                {
+                    pkzo::Texture result = processor->process_tiled(image.texture);
+                    rendered.push(Image(image.job, std::move(result)));
+                    continue;
+                }
+
+                pkzo::Readback readback = image.kind == Decoded::STAGED
+                                        ? processor->process(image.staging, image.size, image.format)
+                                        : processor->process(image.texture);
+                image.texture = pkzo::Texture();
+                pending.push_back(Pending(image.job, std::move(readback)));
+            }
+            catch (std::exception& ex)
+            {
+                report(log_mutex, image.job, ex);
+                failed++;
+            }
+
+            while (!pending.empty() && (pending.size() > processor->get_readback_depth() || pending.front().readback.is_ready()))
+            {
+                collect();
+            }
+        }
+        while (!pending.empty())
+        {
+            collect();
+        }
+        rendered.close();
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        return failed;
+    }
+
+    unsigned int Batch::run_streamed(const std::vector<Job>& jobs)
+    {
+        std::mutex   log_mutex;
+        unsigned int failed = 0;
+
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            try
+            {
+                if (cpu_processor != NULL)
+                {
+                    cpu_processor->process_streamed(jobs[i].input, jobs[i].output, strip_height);
+                }
+                else
+                {
+                    processor->process_streamed(jobs[i].input, jobs[i].output, strip_height);
+                }
+            }
+            catch (std::exception& ex)
+            {
+                report(log_mutex, jobs[i], ex);
+                failed++;
+            }
+        }
+
+        return failed;
+    }
+}
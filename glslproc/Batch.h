@@ -0,0 +1,55 @@
+
+#ifndef _GLSLPROC_BATCH_H_
+#define _GLSLPROC_BATCH_H_
+
+#include <vector>
+#include <pkzo/pkzo.h>
+
+#include "Processor.h"
+#include "CpuProcessor.h"
+
+namespace glslproc
+{
+    // Runs jobs through three overlapping stages: a pool of threads decoding 
+    // PNGs, the calling thread driving the GPU through the Processor and a
+    // pool of threads encoding the results. The stages are connected by 
+    // bounded queues, so while image N renders, N+1 decodes and N-1 encodes.
+    // Images that need no tiling are decoded straight into staging memory
+    // the calling thread maps for them, so the pixels are not copied again.
+    //
+    // With a strip height set, images are instead streamed one after the 
+    // other through Processor::process_streamed, which trades the overlap
+    // for memory that does not grow with the image.
+    //
+    // With a CpuProcessor the calling thread runs the filters instead.
+    class Batch
+    {
+    public:
+        Batch(Processor& processor, unsigned int decoders, unsigned int encoders);
+
+        Batch(CpuProcessor& processor, unsigned int decoders, unsigned int encoders);
+
+        // 0, the default, decodes images whole
+        void set_strip_height(unsigned int value);
+
+        unsigned int get_strip_height() const;
+
+        // returns the number of jobs that failed
+        unsigned int run(const std::vector<Job>& jobs);
+
+    private:
+        // one of them is NULL
+        Processor*    processor;
+        CpuProcessor* cpu_processor;
+        unsigned int  decoders;
+        unsigned int  encoders;
+        unsigned int  strip_height;
+
+        unsigned int run_streamed(const std::vector<Job>& jobs);
+
+        Batch(const Batch&) = delete;
+        const Batch& operator = (const Batch&) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,86 @@
+
+#include "Benchmark.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace glslproc
+{
+    double time_best(const std::function<void ()>& run)
+    {
+        double best = 0.0;
+        for (unsigned int r = 0; r < 4; r++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            run();
+            std::chrono::duration<double, std::milli> d = std::chrono::high_resolution_clock::now() - start;
+            best = r == 0 ? d.count() : std::min(best, d.count());
+            if (best >= 1000.0)
+            {
+                break;
+            }
+        }
+        return best;
+    }
+
+    void benchmark_scaling(CpuProcessor& processor, const pkzo::Texture& image, rgm::uvec2 size, unsigned int strip, unsigned int max_threads, std::ostream& out)
+    {
+        pkzo::PixelView source = image.view();
+        size_t          pixel  = pkzo::get_pixel_size(source.format);
+        unsigned int    halo   = processor.get_halo();
+        if (strip == 0 || strip > size[1])
+        {
+            strip = size[1];
+        }
+
+        // one strip and its halo of the repeated image, every strip reads
+        // from it
+        unsigned int               window_height = std::min(strip + 2 * halo, size[1]);
+        std::vector<unsigned char> window(size[0] * window_height * pixel);
+        for (unsigned int y = 0; y < window_height; y++)
+        {
+            const unsigned char* row = source.data + (y % source.size[1]) * source.stride;
+            for (unsigned int x = 0; x < size[0]; x++)
+            {
+                memcpy(&window[(y * size[0] + x) * pixel], row + (x % source.size[0]) * pixel, pixel);
+            }
+        }
+
+        auto run = [&] () {
+            for (unsigned int y0 = 0; y0 < size[1]; y0 += strip)
+            {
+                unsigned int y1     = std::min(y0 + strip, size[1]);
+                unsigned int top    = y0 - std::min(y0, halo);
+                unsigned int bottom = std::min(y1 + halo, size[1]);
+                pkzo::Texture input(rgm::uvec2(size[0], bottom - top), source.format, &window[0], [] () {});
+                pkzo::Texture result = processor.process(input);
+            }
+        };
+
+        std::vector<unsigned int> counts;
+        for (unsigned int t = 1; t < max_threads; t *= 2)
+        {
+            counts.push_back(t);
+        }
+        counts.push_back(std::max(max_threads, 1u));
+
+        out << size[0] << "x" << size[1] << " in strips of " << strip << " rows, " << pkzo::get_simd_name(pkzo::get_simd_level()) << " kernels" << std::endl;
+
+        double single = 0.0;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            pkzo::set_cpu_threads(counts[i]);
+
+            double best = time_best(run);
+            if (i == 0)
+            {
+                single = best;
+            }
+
+            double megapixels = (double)size[0] * size[1] / 1e6;
+            out << counts[i] << (counts[i] == 1 ? " thread: " : " threads: ") << best << " ms, " << single / best << "x, " << megapixels / (best / 1000.0) << " MP/s" << std::endl;
+        }
+    }
+}
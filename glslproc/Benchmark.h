@@ -0,0 +1,25 @@
+
+#ifndef _GLSLPROC_BENCHMARK_H_
+#define _GLSLPROC_BENCHMARK_H_
+
+#include <iostream>
+#include <functional>
+#include <pkzo/pkzo.h>
+
+#include "CpuProcessor.h"
+
+namespace glslproc
+{
+    // The best wall time in ms of a few calls of run, or of one if that 
+    // already takes a second.
+    double time_best(const std::function<void ()>& run);
+
+    // Times the CPU processor on 1, 2, 4 .. threads up to max_threads and
+    // prints one line per thread count: the time, the speedup over one
+    // thread and the throughput. The image is repeated to size, which is
+    // processed in strips as with --strip, so that even a 16k x 16k image
+    // fits into memory; strip 0 takes the image in one piece.
+    void benchmark_scaling(CpuProcessor& processor, const pkzo::Texture& image, rgm::uvec2 size, unsigned int strip, unsigned int max_threads, std::ostream& out);
+}
+
+#endif
@@ -0,0 +1,270 @@
+
+#include "Compare.h"
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+#include "path.h"
+#include "compose.h"
+#include "Benchmark.h"
+#include "Processor.h"
+#include "CpuProcessor.h"
+
+namespace glslproc
+{
+    std::vector<Comparison> get_bundled_comparisons(const std::string& dir)
+    {
+        const char* shaders[][2] = {
+            {"pass.vert",  "pass.frag"},
+            {"pass.vert",  "sobel.frag"},
+            {"gauss.vert", "gauss.frag"},
+            {"pass.vert",  "faichen.frag"},
+            {"pass.vert",  "lingauss.frag"}
+        };
+
+        std::vector<Comparison> comparisons;
+        for (size_t i = 0; i < sizeof(shaders) / sizeof(shaders[0]); i++)
+        {
+            std::string fragment = shaders[i][1];
+
+            Pass pass;
+            pass.vertex_file   = path::join(dir, shaders[i][0]);
+            pass.fragment_file = path::join(dir, fragment);
+
+            Comparison c;
+            c.name   = fragment.substr(0, fragment.find('.'));
+            c.passes = std::vector<Pass>(1, pass);
+            comparisons.push_back(c);
+        }
+        return comparisons;
+    }
+
+    // how far a sample may be off the reference, in levels of 255, as the
+    // CpuProcessor promises
+    const double tolerance = 1.0;
+
+    static std::string quote(const std::string& value)
+    {
+        std::string result = "\"";
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            char c = value[i];
+            if (c == '"' || c == '\\')
+            {
+                result += '\\';
+                result += c;
+            }
+            else if (c == '\n')
+            {
+                result += "\\n";
+            }
+            else if ((unsigned char)c >= 0x20)
+            {
+                result += c;
+            }
+        }
+        return result + "\"";
+    }
+
+    // The largest difference and the mean squared one, in levels of 255.
+    static void measure_difference(const pkzo::Texture& a, const pkzo::Texture& b, double& max_error, double& mse)
+    {
+        pkzo::PixelView va = a.view();
+        pkzo::PixelView vb = b.view();
+        if (va.size != vb.size || va.format != vb.format)
+        {
+            throw std::runtime_error("The results differ in size or format.");
+        }
+
+        size_t samples = va.size[0] * pkzo::get_channel_count(va.format);
+        bool   wide    = pkzo::get_pixel_size(va.format) / pkzo::get_channel_count(va.format) == 2;
+        double scale   = wide ? 255.0 / 65535.0 : 1.0;
+
+        double sum = 0.0;
+        max_error = 0.0;
+        for (unsigned int y = 0; y < va.size[1]; y++)
+        {
+            const unsigned char* ra = va.data + y * va.stride;
+            const unsigned char* rb = vb.data + y * vb.stride;
+            for (size_t i = 0; i < samples; i++)
+            {
+                double sa = wide ? ((const unsigned short*)ra)[i] : ra[i];
+                double sb = wide ? ((const unsigned short*)rb)[i] : rb[i];
+                double d  = std::fabs(sa - sb) * scale;
+                max_error = std::max(max_error, d);
+                sum      += d * d;
+            }
+        }
+        mse = sum / ((double)samples * va.size[1]);
+    }
+
+    static double milliseconds_since(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // null for a stage that could not be timed on its own
+    static std::string format_ms(double ms)
+    {
+        std::ostringstream buff;
+        if (ms < 0.0)
+        {
+            buff << "null";
+        }
+        else
+        {
+            buff << ms;
+        }
+        return buff.str();
+    }
+
+    unsigned int compare_backends(const std::vector<Comparison>& comparisons, const std::string& image_file, pkzo::ColorFormat format, pkzo::ProgramCache* cache, std::ostream& out)
+    {
+        pkzo::Texture image;
+        image.load(image_file);
+        rgm::uvec2 size       = image.get_size();
+        double     megapixels = (double)size[0] * size[1] / 1e6;
+
+        // where the results are encoded to, to time that
+        std::string encoded = path::join(path::tempdir(), compose("glslproc-compare-%0.png", std::chrono::high_resolution_clock::now().time_since_epoch().count()));
+
+        out << "{\"image\": " << quote(image_file) << ", \"size\": [" << size[0] << ", " << size[1] << "], "
+            << "\"simd\": " << quote(pkzo::get_simd_name(pkzo::get_simd_level())) << ", \"threads\": " << pkzo::get_cpu_threads() << ", \"comparisons\": [";
+
+        unsigned int failed = 0;
+        for (size_t i = 0; i < comparisons.size(); i++)
+        {
+            const Comparison& comparison = comparisons[i];
+            out << (i == 0 ? "" : ",") << "\n  {\"name\": " << quote(comparison.name) << ", \"runs\": [";
+
+            const char*   backends[] = {"gpu", "cpu", "translated"};
+            pkzo::Texture reference;
+            bool          has_reference = false;
+            for (unsigned int b = 0; b < 3; b++)
+            {
+                // written once complete, a failure replaces it with the error
+                std::ostringstream run;
+                try
+                {
+                    std::unique_ptr<Processor>    gpu;
+                    std::unique_ptr<CpuProcessor> cpu;
+                    std::function<pkzo::Texture (const pkzo::Texture&, StageTimes&)> process;
+                    if (b == 0)
+                    {
+                        gpu.reset(new Processor(comparison.passes, cache));
+                        gpu->set_intermediate_format(format);
+                        process = [&] (const pkzo::Texture& input, StageTimes& times) -> pkzo::Texture {
+                            if (!gpu->needs_tiling(input.get_size()))
+                            {
+                                return gpu->process_timed(input, times);
+                            }
+                            // the tiles' stages overlap, all of it counts as render
+                            auto start = std::chrono::high_resolution_clock::now();
+                            pkzo::Texture result = gpu->process_tiled(input);
+                            times.upload   = -1.0;
+                            times.render   = milliseconds_since(start);
+                            times.readback = -1.0;
+                            return result;
+                        };
+
+                        // the first run compiles and allocates
+                        StageTimes times;
+                        process(image, times);
+                    }
+                    else
+                    {
+                        cpu.reset(new CpuProcessor(comparison.passes, b == 2));
+                        cpu->set_intermediate_format(format);
+                        process = [&] (const pkzo::Texture& input, StageTimes& times) -> pkzo::Texture {
+                            return cpu->process_timed(input, times);
+                        };
+                    }
+
+                    // the best time of each stage over the runs
+                    pkzo::Texture result;
+                    double        decode = 0.0;
+                    double        encode = 0.0;
+                    StageTimes    best   = {0.0, 0.0, 0.0};
+                    unsigned int  runs   = 0;
+                    time_best([&] () {
+                        auto start = std::chrono::high_resolution_clock::now();
+                        pkzo::Texture input;
+                        input.load(image_file);
+                        double d = milliseconds_since(start);
+
+                        StageTimes times;
+                        result = process(input, times);
+
+                        start = std::chrono::high_resolution_clock::now();
+                        result.save(encoded);
+                        double e = milliseconds_since(start);
+
+                        decode        = runs == 0 ? d : std::min(decode, d);
+                        encode        = runs == 0 ? e : std::min(encode, e);
+                        best.upload   = runs == 0 ? times.upload : std::min(best.upload, times.upload);
+                        best.render   = runs == 0 ? times.render : std::min(best.render, times.render);
+                        best.readback = runs == 0 ? times.readback : std::min(best.readback, times.readback);
+                        runs++;
+                    });
+
+                    run << "\"ms\": {\"decode\": " << decode << ", \"upload\": " << format_ms(best.upload) << ", \"render\": " << best.render
+                        << ", \"readback\": " << format_ms(best.readback) << ", \"encode\": " << encode << "}, \"mps\": " << megapixels / (best.render / 1000.0);
+                    if (has_reference)
+                    {
+                        double max_error, mse;
+                        measure_difference(reference, result, max_error, mse);
+                        run << ", \"max_abs_error\": " << max_error << ", \"psnr\": ";
+                        if (mse == 0.0)
+                        {
+                            run << "null";
+                        }
+                        else
+                        {
+                            run << 10.0 * std::log10(255.0 * 255.0 / mse);
+                        }
+                        run << ", \"within_tolerance\": " << (max_error <= tolerance ? "true" : "false");
+                        if (max_error > tolerance)
+                        {
+                            failed++;
+                        }
+                    }
+                    else
+                    {
+                        reference     = std::move(result);
+                        has_reference = true;
+                    }
+                }
+                catch (pkzo::ContextError& ex)
+                {
+                    // no GPU here, not a failure of the shader
+                    run.str("");
+                    run << "\"skipped\": " << quote(ex.what());
+                }
+                catch (UnsupportedError& ex)
+                {
+                    // the translator does not cover the shader, as expected
+                    run.str("");
+                    run << "\"skipped\": " << quote(ex.what());
+                }
+                catch (std::exception& ex)
+                {
+                    run.str("");
+                    run << "\"error\": " << quote(ex.what());
+                    failed++;
+                }
+                std::remove(encoded.c_str());
+                out << (b == 0 ? "" : ",") << "\n    {\"backend\": " << quote(backends[b]) << ", " << run.str() << "}";
+            }
+            out << "]}";
+        }
+        out << "\n]}" << std::endl;
+
+        return failed;
+    }
+}
@@ -0,0 +1,52 @@
+
+#ifndef _GLSLPROC_COMPARE_H_
+#define _GLSLPROC_COMPARE_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <pkzo/pkzo.h>
+
+#include "Pipeline.h"
+
+namespace glslproc
+{
+    struct Comparison
+    {
+        std::string       name;
+        std::vector<Pass> passes;
+    };
+
+    // The bundled shaders (pass, sobel, gauss, faichen and lingauss) in
+    // dir, each as a pipeline of its own.
+    std::vector<Comparison> get_bundled_comparisons(const std::string& dir);
+
+    // Runs each pipeline on the GPU, with the CPU filters and translated
+    // on the CPU (see CpuProcessor) and writes a JSON report to out:
+    //
+    //   {"image": "lena.png", "size": [512, 512], "simd": "AVX",
+    //    "threads": 8, "comparisons": [
+    //     {"name": "sobel", "runs": [
+    //       {"backend": "gpu", "ms": {"decode": 6.1, "upload": 0.3,
+    //        "render": 1.2, "readback": 0.4, "encode": 21.5}, "mps": 218.4},
+    //       {"backend": "cpu", "ms": {...}, "mps": 84.6,
+    //        "max_abs_error": 1, "psnr": 71.2, "within_tolerance": true},
+    //       {"backend": "translated", "skipped": "..."}, ...]}, ...]}
+    //
+    // Each pipeline is timed by stage, the best of a few runs each: decode
+    // the PNG, upload, render the passes, read back and encode the result
+    // as PNG, see Processor::process_timed and CpuProcessor::process_timed.
+    // An image processed in tiles on the GPU has only its render time, the
+    // tiles' uploads and readbacks overlap with it. mps is the throughput
+    // of the render stage. The results are compared to the GPU's, or 
+    // without an OpenGL context to the CPU filters', in levels of 255 over
+    // all samples; psnr is null for equal images. They are within tolerance
+    // if no sample is off by more than 1. A backend that fails gets the 
+    // error instead, one that does not support the pipeline (no OpenGL 
+    // context, or an UnsupportedError from the CpuProcessor) gets "skipped"
+    // and the reason. Returns the number of failed runs and of runs out of
+    // tolerance.
+    unsigned int compare_backends(const std::vector<Comparison>& comparisons, const std::string& image_file, pkzo::ColorFormat format, pkzo::ProgramCache* cache, std::ostream& out);
+}
+
+#endif
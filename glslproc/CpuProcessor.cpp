@@ -0,0 +1,307 @@
+
+#include "CpuProcessor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "compose.h"
+
+namespace glslproc
+{
+    std::string get_define(const pkzo::Defines& defines, const std::string& name, const std::string& value)
+    {
+        auto i = defines.find(name);
+        return i != defines.end() ? i->second : value;
+    }
+
+    // DIRECTION of gauss, scan, carry and box, only along x or y
+    bool is_vertical(const Pass& pass)
+    {
+        std::string direction = get_define(pass.defines, "DIRECTION", "ivec2(1,0)");
+        direction.erase(std::remove(direction.begin(), direction.end(), ' '), direction.end());
+        if (direction != "ivec2(1,0)" && direction != "ivec2(0,1)")
+        {
+            throw UnsupportedError(compose("DIRECTION %0 of %1 is not supported on the CPU.", direction, describe(pass)));
+        }
+        return direction == "ivec2(0,1)";
+    }
+
+    CpuProcessor::CpuProcessor(const std::vector<Pass>& passes, bool translate_all)
+    : schedule(glslproc::schedule(passes)), float_slots(get_float_slots(schedule, passes)), halo(0), intermediate_format(pkzo::RGBA), output_format(pkzo::RGBA)
+    {
+        // halo of the result in each slot, as in the Processor
+        std::vector<unsigned int> slot_halo(schedule.slots, 0);
+
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            const Step& step = schedule.steps[i];
+            const Pass& pass = passes[step.pass];
+
+            // the bundled shaders name their filter with #pragma cpu
+            std::string fragment_code = pass.fragment_code.empty() ? pkzo::preprocess(pass.fragment_file) : pass.fragment_code;
+            std::string name          = translate_all ? "" : pkzo::get_pragma(fragment_code, "cpu");
+
+            Stage stage = {PASS, 0, 0, 0.0f, false, nullptr};
+            unsigned int footprint = 0;
+            if (name == "pass")
+            {
+                stage.filter = PASS;
+            }
+            else if (name == "sobel")
+            {
+                stage.filter = SOBEL;
+                footprint    = 1;
+            }
+            else if (name == "faichen")
+            {
+                stage.filter = FAICHEN;
+                footprint    = 1;
+            }
+            else if (name == "gauss")
+            {
+                // the defaults of gauss.glsl and gauss.frag
+                stage.filter = GAUSS;
+                stage.size   = std::atoi(get_define(pass.defines, "KERNEL_SIZE", "15").c_str());
+                stage.sigma  = pass.defines.count("SIGMA") ? (float)std::atof(pass.defines.find("SIGMA")->second.c_str()) : stage.size / 3.0f;
+                if (stage.size == 0 || stage.sigma <= 0.0f)
+                {
+                    throw std::runtime_error(compose("Invalid KERNEL_SIZE or SIGMA for %0.", describe(pass)));
+                }
+
+                stage.vertical = is_vertical(pass);
+                footprint      = stage.size - 1;
+            }
+            else if (name == "lingauss")
+            {
+                stage.filter = LINGAUSS;
+                stage.size   = std::atoi(get_define(pass.defines, "RADIUS", "25").c_str());
+                if (stage.size == 0)
+                {
+                    throw std::runtime_error(compose("Invalid RADIUS for %0.", describe(pass)));
+                }
+                footprint = stage.size;
+            }
+            else if (name == "scan" || name == "carry")
+            {
+                // box and satbox take differences, which need no halo
+                stage.filter   = name == "scan" ? SCAN : CARRY;
+                stage.size     = std::atoi(get_define(pass.defines, "CHUNK", "128").c_str());
+                stage.vertical = is_vertical(pass);
+                if (stage.size == 0)
+                {
+                    throw std::runtime_error(compose("Invalid CHUNK for %0.", describe(pass)));
+                }
+            }
+            else if (name == "box")
+            {
+                stage.filter   = BOX;
+                stage.size     = std::atoi(get_define(pass.defines, "RADIUS", "25").c_str());
+                stage.vertical = is_vertical(pass);
+                footprint      = stage.size;
+            }
+            else if (name == "satbox")
+            {
+                std::string radius = get_define(pass.defines, "RADIUS", "25");
+                stage.filter = SAT_BOX;
+                stage.size   = std::atoi(get_define(pass.defines, "RADIUS_X", radius).c_str());
+                stage.size_y = std::atoi(get_define(pass.defines, "RADIUS_Y", radius).c_str());
+                footprint    = std::max(stage.size, stage.size_y);
+            }
+            else
+            {
+                // any other shader is translated, see pkzo/CpuProgram.h, 
+                // with the defines the Processor gives it, e.g. TAPS
+                stage.filter = SHADER;
+                try
+                {
+                    pkzo::Defines defines = pass.defines;
+                    prepare_kernel(defines);
+                    std::string vertex_code = pkzo::inject_defines(pkzo::preprocess(pass.vertex_file), defines);
+                    if (pass.fragment_code.empty())
+                    {
+                        fragment_code = pkzo::inject_defines(fragment_code, defines);
+                    }
+                    stage.program = std::make_shared<pkzo::CpuProgram>(vertex_code, fragment_code);
+                }
+                catch (const std::exception& ex)
+                {
+                    throw UnsupportedError(compose("%0 can not run on the CPU: %1", describe(pass), ex.what()));
+                }
+                if (stage.program->get_input_count() > std::max<size_t>(step.inputs.size(), 1))
+                {
+                    throw std::runtime_error(compose("%0 reads uTexture%1, but has %2 inputs.", describe(pass), stage.program->get_input_count() - 1, step.inputs.size()));
+                }
+                footprint = stage.program->get_footprint();
+            }
+            stages.push_back(stage);
+
+            unsigned int h = 0;
+            for (size_t j = 0; j < step.inputs.size(); j++)
+            {
+                if (step.inputs[j] >= 0)
+                {
+                    h = std::max(h, slot_halo[step.inputs[j]]);
+                }
+            }
+            slot_halo[step.target] = h + footprint;
+        }
+
+        halo = slot_halo[schedule.steps.back().target];
+    }
+
+    CpuProcessor::~CpuProcessor() {}
+
+    unsigned int CpuProcessor::get_halo() const
+    {
+        return halo;
+    }
+
+    void CpuProcessor::set_intermediate_format(pkzo::ColorFormat value)
+    {
+        intermediate_format = value;
+    }
+
+    pkzo::ColorFormat CpuProcessor::get_intermediate_format() const
+    {
+        return intermediate_format;
+    }
+
+    void CpuProcessor::set_output_format(pkzo::ColorFormat value)
+    {
+        output_format = value;
+    }
+
+    pkzo::ColorFormat CpuProcessor::get_output_format() const
+    {
+        return output_format;
+    }
+
+    pkzo::Texture CpuProcessor::process(const pkzo::Texture& input)
+    {
+        pkzo::CpuImage result = run(pkzo::CpuImage(input.view()));
+        return result.to_texture(output_format);
+    }
+
+    pkzo::Texture CpuProcessor::process_timed(const pkzo::Texture& input, StageTimes& times)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        pkzo::CpuImage source(input.view());
+
+        auto converted = std::chrono::high_resolution_clock::now();
+        pkzo::CpuImage result = run(source);
+
+        auto rendered = std::chrono::high_resolution_clock::now();
+        pkzo::Texture texture = result.to_texture(output_format);
+
+        auto done = std::chrono::high_resolution_clock::now();
+        times.upload   = std::chrono::duration<double, std::milli>(converted - start).count();
+        times.render   = std::chrono::duration<double, std::milli>(rendered - converted).count();
+        times.readback = std::chrono::duration<double, std::milli>(done - rendered).count();
+        return texture;
+    }
+
+    void CpuProcessor::process_streamed(const std::string& input, const std::string& output, unsigned int strip)
+    {
+        pkzo::PngReader reader(input);
+        rgm::uvec2      size   = reader.get_size();
+        size_t          stride = reader.get_stride();
+        strip = std::max(strip, 1u);
+
+        pkzo::PngWriter writer(output, size, output_format);
+
+        // the image's rows first.. first + count, enough for a strip and its halo
+        std::vector<unsigned char> rows((strip + 2 * halo) * stride);
+        size_t                     result_stride = size[0] * pkzo::get_pixel_size(output_format);
+        std::vector<unsigned char> result(strip * result_stride);
+        unsigned int               first = 0;
+        unsigned int               count = 0;
+
+        for (unsigned int y0 = 0; y0 < size[1]; y0 += strip)
+        {
+            unsigned int y1 = std::min(y0 + strip, size[1]);
+
+            unsigned int top = y0 - std::min(y0, halo);
+            if (top > first)
+            {
+                unsigned int drop = top - first;
+                memmove(&rows[0], &rows[drop * stride], (count - drop) * stride);
+                count -= drop;
+                first  = top;
+            }
+
+            unsigned int bottom = std::min(y1 + halo, size[1]);
+            count += reader.read(&rows[count * stride], bottom - first - count, stride);
+
+            // rows near the ends of the window see zeros past them, only 
+            // the strip is kept
+            pkzo::PixelView view  = {&rows[0], rgm::uvec2(size[0], count), reader.get_format(), stride};
+            pkzo::CpuImage  image = run(pkzo::CpuImage(view));
+            image.store(&result[0], result_stride, output_format, y0 - first, y1 - y0);
+
+            writer.write(&result[0], y1 - y0, result_stride);
+        }
+
+        writer.finish();
+    }
+
+    pkzo::CpuImage CpuProcessor::run(const pkzo::CpuImage& source) const
+    {
+        std::vector<pkzo::CpuImage> slots(schedule.slots);
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            const Step&  step  = schedule.steps[i];
+            const Stage& stage = stages[i];
+
+            // the filters only read the first input, as their shaders do
+            std::vector<const pkzo::CpuImage*> inputs;
+            for (size_t j = 0; j < step.inputs.size(); j++)
+            {
+                inputs.push_back(step.inputs[j] < 0 ? &source : &slots[step.inputs[j]]);
+            }
+            const pkzo::CpuImage& input = *inputs[0];
+
+            pkzo::CpuImage output;
+            switch (stage.filter)
+            {
+                case PASS:
+                    output = pkzo::cpu_pass(input);
+                    break;
+                case SOBEL:
+                    output = pkzo::cpu_sobel(input);
+                    break;
+                case FAICHEN:
+                    output = pkzo::cpu_faichen(input);
+                    break;
+                case GAUSS:
+                    output = pkzo::cpu_gauss(input, stage.size, stage.sigma, stage.vertical);
+                    break;
+                case LINGAUSS:
+                    output = pkzo::cpu_lingauss(input, stage.size);
+                    break;
+                case SCAN:
+                    output = pkzo::cpu_scan(input, stage.size, stage.vertical);
+                    break;
+                case CARRY:
+                    output = pkzo::cpu_carry(input, stage.size, stage.vertical);
+                    break;
+                case BOX:
+                    output = pkzo::cpu_box(input, stage.size, stage.vertical);
+                    break;
+                case SAT_BOX:
+                    output = pkzo::cpu_sat_box(input, stage.size, stage.size_y);
+                    break;
+                case SHADER:
+                    output = stage.program->run(inputs);
+                    break;
+            }
+            output.quantize(float_slots[step.target] ? pkzo::RGBA32F : intermediate_format);
+
+            slots[step.target] = std::move(output);
+        }
+
+        return std::move(slots[schedule.steps.back().target]);
+    }
+}
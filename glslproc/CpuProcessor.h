@@ -0,0 +1,105 @@
+
+#ifndef _GLSLPROC_CPU_PROCESSOR_H_
+#define _GLSLPROC_CPU_PROCESSOR_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <pkzo/pkzo.h>
+
+#include "Pipeline.h"
+
+namespace glslproc
+{
+    // A pass can not run on the CPU: the translator does not cover what
+    // its shader does, or a filter does not take its defines.
+    class UnsupportedError : public std::runtime_error
+    {
+    public:
+        UnsupportedError(const std::string& what)
+        : std::runtime_error(what) {}
+    };
+
+    // Runs a pipeline on the CPU, for machines where no OpenGL context can
+    // be created. The bundled shaders have filters of their own, which they
+    // name with #pragma cpu(<filter>): pass, sobel, gauss, faichen, 
+    // lingauss, scan, carry, box or satbox. These take KERNEL_SIZE, SIGMA,
+    // DIRECTION, RADIUS, RADIUS_X, RADIUS_Y and CHUNK from the pass's
+    // defines, see pkzo/CpuFilter.h. Other shaders, and all of them with
+    // translate_all, are translated with pkzo::CpuProgram, which covers
+    // what texelFetch based filters usually do. Results between passes
+    // are rounded to the intermediate format, or kept as floats for prefix
+    // sums, as in the Processor's frame buffers, so that both give the same
+    // image within 1 of 255.
+    //
+    // Images are processed whole; there is no texture size to tile for.
+    class CpuProcessor
+    {
+    public:
+        CpuProcessor(const std::vector<Pass>& passes, bool translate_all = false);
+
+        ~CpuProcessor();
+
+        unsigned int get_halo() const;
+
+        void set_intermediate_format(pkzo::ColorFormat value);
+
+        pkzo::ColorFormat get_intermediate_format() const;
+
+        void set_output_format(pkzo::ColorFormat value);
+
+        pkzo::ColorFormat get_output_format() const;
+
+        pkzo::Texture process(const pkzo::Texture& input);
+
+        // process, timing the conversion to float planes, the passes and
+        // the conversion to the output format each on its own
+        pkzo::Texture process_timed(const pkzo::Texture& input, StageTimes& times);
+
+        // see Processor::process_streamed
+        void process_streamed(const std::string& input, const std::string& output, unsigned int strip);
+
+    private:
+        enum Filter
+        {
+            PASS,
+            SOBEL,
+            FAICHEN,
+            GAUSS,
+            LINGAUSS,
+            SCAN,
+            CARRY,
+            BOX,
+            SAT_BOX,
+            SHADER
+        };
+
+        struct Stage
+        {
+            Filter       filter;
+            // KERNEL_SIZE, RADIUS, RADIUS_X or CHUNK
+            unsigned int size;
+            // RADIUS_Y of satbox
+            unsigned int size_y;
+            float        sigma;
+            bool         vertical;
+            // SHADER
+            std::shared_ptr<pkzo::CpuProgram> program;
+        };
+
+        Schedule           schedule;
+        std::vector<bool>  float_slots;
+        std::vector<Stage> stages;
+        unsigned int       halo;
+        pkzo::ColorFormat  intermediate_format;
+        pkzo::ColorFormat  output_format;
+
+        pkzo::CpuImage run(const pkzo::CpuImage& source) const;
+
+        CpuProcessor(const CpuProcessor&) = delete;
+        const CpuProcessor& operator = (const CpuProcessor&) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,445 @@
+
+#include "Pipeline.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+
+#include "fs.h"
+#include "path.h"
+#include "compose.h"
+
+namespace glslproc
+{
+    // [name =] vertex fragment [(inputs)] defines
+    std::regex pass_line("^\\s*(?:(\\w+)\\s*=\\s*)?(\\S+)\\s+([^\\s(]+)\\s*(?:\\(([^)]*)\\))?(.*)$");
+    std::regex input_name("\\w+");
+
+    std::string resolve(const std::string& dir, const std::string& file)
+    {
+        return path::is_absolute(file) ? file : path::join(dir, file);
+    }
+
+    std::vector<Pass> load_pipeline(const std::string& file)
+    {
+        std::ifstream in(file.c_str());
+        if (!in.good())
+        {
+            throw std::runtime_error(compose("Failed to open %0 for reading.", file));
+        }
+
+        std::string       dir = path::dirname(file);
+        std::vector<Pass> passes;
+
+        std::string  line;
+        unsigned int number = 0;
+        while (std::getline(in, line))
+        {
+            number++;
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+            {
+                continue;
+            }
+
+            std::smatch match;
+            if (!std::regex_match(line, match, pass_line))
+            {
+                throw std::runtime_error(compose("%0(%1): Expected [<name> =] <vertex> <fragment> [(<input>, ...)].", file, number));
+            }
+
+            Pass pass;
+            pass.name          = match[1];
+            pass.vertex_file   = resolve(dir, match[2]);
+            pass.fragment_file = resolve(dir, match[3]);
+
+            std::string inputs = match[4];
+            for (std::sregex_iterator i(inputs.begin(), inputs.end(), input_name), end; i != end; ++i)
+            {
+                pass.inputs.push_back(i->str());
+            }
+            if (match[4].matched && pass.inputs.empty())
+            {
+                throw std::runtime_error(compose("%0(%1): Empty input list.", file, number));
+            }
+
+            std::stringstream buff(match[5]);
+            std::string       define;
+            while (buff >> define)
+            {
+                pkzo::parse_define(define, pass.defines);
+            }
+
+            passes.push_back(pass);
+        }
+
+        if (passes.empty())
+        {
+            throw std::runtime_error(compose("%0: No passes given.", file));
+        }
+
+        return passes;
+    }
+
+    bool is_compute(const Pass& pass)
+    {
+        return pass.fragment_code.empty() && path::ext(pass.fragment_file) == "comp";
+    }
+
+    void prefer_compute(std::vector<Pass>& passes)
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            Pass&       pass = passes[i];
+            std::string ext  = path::ext(pass.fragment_file);
+            if (!pass.fragment_code.empty() || ext.empty() || ext == "comp")
+            {
+                continue;
+            }
+
+            std::string file = pass.fragment_file.substr(0, pass.fragment_file.size() - ext.size()) + "comp";
+            if (fs::exists(file))
+            {
+                pass.fragment_file = file;
+            }
+        }
+    }
+
+    void prepare_boxes(std::vector<Pass>& passes)
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            pkzo::Defines& defines = passes[i].defines;
+            auto box = defines.find("BOX");
+            if (box == defines.end())
+            {
+                continue;
+            }
+
+            unsigned int index = std::atoi(box->second.c_str());
+            unsigned int count = defines.count("BOXES") ? std::atoi(defines["BOXES"].c_str()) : 1;
+            if (index >= count)
+            {
+                throw std::runtime_error(compose("BOX %0 of %1 is not below BOXES.", index, describe(passes[i])));
+            }
+
+            unsigned int radius = 0;
+            if (defines.count("BOX_SIGMA"))
+            {
+                radius = pkzo::box_radii((float)std::atof(defines["BOX_SIGMA"].c_str()), count)[index];
+            }
+            else
+            {
+                unsigned int total = defines.count("RADIUS") ? std::atoi(defines["RADIUS"].c_str()) : 25;
+                radius = total / count + (index < total % count ? 1 : 0);
+            }
+            defines["RADIUS"] = compose("%0", radius);
+        }
+    }
+
+    pkzo::Kernel prepare_kernel(pkzo::Defines& defines)
+    {
+        auto s = defines.find("SIGMA");
+        if (s == defines.end())
+        {
+            return pkzo::Kernel();
+        }
+
+        float        sigma  = (float)std::atof(s->second.c_str());
+        unsigned int radius = 0;
+
+        auto r = defines.find("RADIUS");
+        if (r != defines.end())
+        {
+            radius = std::atoi(r->second.c_str());
+        }
+
+        pkzo::Kernel kernel = pkzo::gaussian_kernel(sigma, radius);
+        defines["RADIUS"] = compose("%0", kernel.weights.size() - 1);
+
+        kernel = pkzo::linear_sampling(kernel);
+        defines.insert(std::make_pair("TAPS", compose("%0", kernel.weights.size())));
+        return kernel;
+    }
+
+    std::string describe(const Pass& pass)
+    {
+        return pass.name.empty() ? path::basename(pass.fragment_file) : pass.name;
+    }
+
+    const int source = -1;
+
+    // the inputs of each pass by index, -1 is the image
+    std::vector<std::vector<int>> resolve_inputs(const std::vector<Pass>& passes)
+    {
+        std::map<std::string, int> names;
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            const std::string& name = passes[i].name;
+            if (name.empty())
+            {
+                continue;
+            }
+            if (name == "input")
+            {
+                throw std::runtime_error("The pass name \"input\" is reserved for the image.");
+            }
+            if (!names.insert(std::make_pair(name, (int)i)).second)
+            {
+                throw std::runtime_error(compose("There is more than one pass named %0.", name));
+            }
+        }
+
+        std::vector<std::vector<int>> inputs(passes.size());
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].inputs.empty())
+            {
+                inputs[i].push_back((int)i - 1);
+            }
+            for (size_t j = 0; j < passes[i].inputs.size(); j++)
+            {
+                const std::string& name = passes[i].inputs[j];
+                if (name == "input")
+                {
+                    inputs[i].push_back(source);
+                    continue;
+                }
+                auto k = names.find(name);
+                if (k == names.end())
+                {
+                    throw std::runtime_error(compose("Unknown input %0 of pass %1.", name, describe(passes[i])));
+                }
+                inputs[i].push_back(k->second);
+            }
+        }
+
+        return inputs;
+    }
+
+    int find_output(const std::vector<Pass>& passes)
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == "output")
+            {
+                return (int)i;
+            }
+        }
+        return (int)passes.size() - 1;
+    }
+
+    std::vector<Pass> prepare_pointwise(const std::vector<Pass>& passes, bool fuse)
+    {
+        std::vector<std::vector<int>> inputs = resolve_inputs(passes);
+        int                           output = find_output(passes);
+
+        std::vector<unsigned int> readers(passes.size(), 0);
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            for (size_t j = 0; j < inputs[i].size(); j++)
+            {
+                if (inputs[i][j] != source)
+                {
+                    readers[inputs[i][j]]++;
+                }
+            }
+        }
+
+        std::vector<std::string> codes(passes.size());
+        std::vector<bool>        pointwise(passes.size(), false);
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].fragment_code.empty())
+            {
+                codes[i]     = pkzo::preprocess(passes[i].fragment_file);
+                pointwise[i] = pkzo::is_pointwise(codes[i]);
+            }
+        }
+
+        std::vector<Pass> result;
+        size_t i = 0;
+        while (i < passes.size())
+        {
+            if (!pointwise[i])
+            {
+                result.push_back(passes[i]);
+                i++;
+                continue;
+            }
+
+            // Grow the run while the next line reads only this pass and 
+            // nothing else does. Runs are consecutive lines, so that a 
+            // pass reading "the line before" still reads the same result.
+            std::vector<std::string> files(1, passes[i].fragment_file);
+            size_t j = i + 1;
+            while (fuse && j < passes.size() && pointwise[j] &&
+                   inputs[j].size() == 1 && inputs[j][0] == (int)j - 1 &&
+                   readers[j - 1] == 1 && (int)j - 1 != output &&
+                   passes[j].vertex_file == passes[i].vertex_file &&
+                   std::find(files.begin(), files.end(), passes[j].fragment_file) == files.end())
+            {
+                files.push_back(passes[j].fragment_file);
+                j++;
+            }
+
+            std::vector<std::string>   run_codes(codes.begin() + i, codes.begin() + j);
+            std::vector<pkzo::Defines> run_defines;
+            for (size_t k = i; k < j; k++)
+            {
+                run_defines.push_back(passes[k].defines);
+            }
+
+            // it takes the place of the last, reading what the first read
+            Pass fused          = passes[j - 1];
+            fused.vertex_file   = passes[i].vertex_file;
+            fused.inputs        = passes[i].inputs;
+            fused.fragment_code = pkzo::fuse_pointwise(run_codes, run_defines);
+            fused.defines.clear();
+            result.push_back(fused);
+
+            i = j;
+        }
+
+        return result;
+    }
+
+    Schedule schedule(const std::vector<Pass>& passes)
+    {
+        std::vector<std::vector<int>> inputs = resolve_inputs(passes);
+        int                           output = find_output(passes);
+
+        // only what the output depends on is run
+        std::vector<bool> live(passes.size(), false);
+        std::vector<int>  stack(1, output);
+        while (!stack.empty())
+        {
+            int i = stack.back();
+            stack.pop_back();
+            if (i == source || live[i])
+            {
+                continue;
+            }
+            live[i] = true;
+            stack.insert(stack.end(), inputs[i].begin(), inputs[i].end());
+        }
+
+        // Kahn's algorithm, keeping the file order where there is a choice
+        std::vector<unsigned int> missing(passes.size(), 0);
+        std::vector<unsigned int> uses(passes.size(), 0);
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (!live[i])
+            {
+                continue;
+            }
+            for (size_t j = 0; j < inputs[i].size(); j++)
+            {
+                if (inputs[i][j] != source)
+                {
+                    missing[i]++;
+                    uses[inputs[i][j]]++;
+                }
+            }
+        }
+
+        std::vector<int> order;
+        std::vector<bool> done(passes.size(), false);
+        bool progress = true;
+        while (progress)
+        {
+            progress = false;
+            for (size_t i = 0; i < passes.size(); i++)
+            {
+                if (live[i] && !done[i] && missing[i] == 0)
+                {
+                    done[i] = true;
+                    order.push_back((int)i);
+                    for (size_t k = 0; k < passes.size(); k++)
+                    {
+                        if (live[k])
+                        {
+                            missing[k] -= (unsigned int)std::count(inputs[k].begin(), inputs[k].end(), (int)i);
+                        }
+                    }
+                    progress = true;
+                    break;
+                }
+            }
+        }
+        if (order.size() != (size_t)std::count(live.begin(), live.end(), true))
+        {
+            throw std::runtime_error("The pipeline has a cycle.");
+        }
+
+        // assign slots, a result's slot is free again after its last use
+        Schedule result;
+        result.slots = 0;
+
+        std::vector<unsigned int> slot(passes.size(), 0);
+        std::vector<unsigned int> free;
+        for (size_t n = 0; n < order.size(); n++)
+        {
+            int i = order[n];
+
+            Step step;
+            step.pass = i;
+            if (free.empty())
+            {
+                step.target = result.slots++;
+            }
+            else
+            {
+                step.target = free.back();
+                free.pop_back();
+            }
+            slot[i] = step.target;
+
+            for (size_t j = 0; j < inputs[i].size(); j++)
+            {
+                int input = inputs[i][j];
+                step.inputs.push_back(input == source ? source : (int)slot[input]);
+                if (input != source && --uses[input] == 0)
+                {
+                    free.push_back(slot[input]);
+                }
+            }
+
+            result.steps.push_back(step);
+        }
+
+        return result;
+    }
+
+    bool has_float_output(const Pass& pass)
+    {
+        std::string code   = pass.fragment_code.empty() ? pkzo::preprocess(pass.fragment_file) : pass.fragment_code;
+        std::string output = pkzo::get_pragma(code, "output");
+        if (!output.empty() && output != "rgba32f")
+        {
+            throw std::runtime_error(compose("%0 asks for output %1, only rgba32f is supported.", describe(pass), output));
+        }
+        return output == "rgba32f";
+    }
+
+    std::vector<bool> get_float_slots(const Schedule& schedule, const std::vector<Pass>& passes)
+    {
+        std::vector<bool> result(schedule.slots, false);
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            if (has_float_output(passes[schedule.steps[i].pass]))
+            {
+                result[schedule.steps[i].target] = true;
+            }
+        }
+        return result;
+    }
+}
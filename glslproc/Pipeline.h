@@ -0,0 +1,118 @@
+
+#ifndef _GLSLPROC_PIPELINE_H_
+#define _GLSLPROC_PIPELINE_H_
+
+#include <string>
+#include <vector>
+#include <pkzo/pkzo.h>
+
+namespace glslproc
+{
+    struct Pass
+    {
+        std::string   vertex_file;
+        std::string   fragment_file;
+        pkzo::Defines defines;
+        // empty means unnamed
+        std::string              name;
+        // empty means the previous pass, or the image for the first pass
+        std::vector<std::string> inputs;
+        // generated code, used instead of fragment_file if not empty
+        std::string              fragment_code;
+    };
+
+    // A pipeline file lists one pass per line:
+    //
+    //   [<name> =] <vertex> <fragment> [(<input>, ...)] [NAME=VALUE ...]
+    //
+    // Without inputs a pass reads the result of the line before, so a plain
+    // list of shaders is a chain:
+    //
+    //   # blur, then find edges
+    //   gauss.vert gauss.frag KERNEL_SIZE=7
+    //   pass.vert  sobel.frag
+    //
+    // Named passes make a graph. "input" is the image, the result is the
+    // pass named "output" or else the last one. Input N is bound to
+    // uTextureN and its size to uTextureSizeN; the first one also to
+    // uTexture and uTextureSize.
+    //
+    //   blur   = gauss.vert gauss.frag (input)
+    //   output = pass.vert unsharp.frag (input, blur)
+    //
+    // A .comp file in place of the fragment shader makes a compute pass; it
+    // writes its result through imageStore to uOutput and the vertex shader
+    // is not used.
+    //
+    // Shader files are relative to the pipeline file. Empty lines and lines
+    // starting with # are ignored.
+    std::vector<Pass> load_pipeline(const std::string& file);
+
+    bool is_compute(const Pass& pass);
+
+    // the name of the pass, or else of its fragment shader, for messages
+    std::string describe(const Pass& pass);
+
+    // Run the compute version of a filter, the .comp file next to the 
+    // fragment shader, wherever there is one.
+    void prefer_compute(std::vector<Pass>& passes);
+
+    // A pass with BOX=i is the i-th of BOXES (1 by default) box filters in
+    // a row and gets its own RADIUS: from pkzo::box_radii with BOX_SIGMA,
+    // otherwise the RADIUS (25 by default) of all of them split up. See 
+    // tent.pipeline and boxgauss.pipeline.
+    void prepare_boxes(std::vector<Pass>& passes);
+
+    // A SIGMA define asks for gaussian weights, see sepgauss.frag: returns
+    // them merged for bilinear lookups and defines TAPS to their number and
+    // RADIUS, if not given, to the footprint. Without SIGMA the kernel is 
+    // empty and the defines stay as they are.
+    pkzo::Kernel prepare_kernel(pkzo::Defines& defines);
+
+    // Pointwise shaders (#pragma pointwise) have no main of their own; 
+    // generate one for each run of them. A run is consecutive lines where 
+    // each pass reads only the one before and is its only reader; it runs 
+    // in one draw without a frame buffer in between. Without fuse every 
+    // pointwise pass is a run of its own. See pkzo::fuse_pointwise.
+    std::vector<Pass> prepare_pointwise(const std::vector<Pass>& passes, bool fuse = true);
+
+    // One draw of a scheduled pipeline. Intermediate results live in frame
+    // buffer slots; -1 stands for the image.
+    struct Step
+    {
+        size_t           pass;
+        std::vector<int> inputs;
+        unsigned int     target;
+    };
+
+    struct Schedule
+    {
+        std::vector<Step> steps;
+        unsigned int      slots;
+    };
+
+    // How long the stages of processing one image took, in ms. On the CPU
+    // upload and readback are the conversions to and from float planes.
+    struct StageTimes
+    {
+        double upload;
+        double render;
+        double readback;
+    };
+
+    // Order the passes that contribute to the output so that every pass
+    // runs after its inputs and assign frame buffer slots. A slot is reused
+    // as soon as the last consumer of its result ran, so the number of
+    // slots is the most results that are alive at once.
+    Schedule schedule(const std::vector<Pass>& passes);
+
+    // A shader with #pragma output(rgba32f) writes results that must stay
+    // floats, like the prefix sums of scan and carry, which box and satbox
+    // take differences of. The slots these results go to hold RGBA32F 
+    // whatever the intermediate format.
+    bool has_float_output(const Pass& pass);
+
+    std::vector<bool> get_float_slots(const Schedule& schedule, const std::vector<Pass>& passes);
+}
+
+#endif
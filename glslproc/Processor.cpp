@@ -0,0 +1,501 @@
+
+#include "Processor.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include "compose.h"
+
+namespace glslproc
+{
+    std::vector<Job> load_jobs(std::istream& in)
+    {
+        std::vector<Job> jobs;
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::stringstream buff(line);
+            Job job;
+            buff >> job.input >> job.output;
+            if (job.input.empty())
+            {
+                continue;
+            }
+            if (job.output.empty())
+            {
+                throw std::runtime_error(compose("No output given for %0.", job.input));
+            }
+            jobs.push_back(job);
+        }
+
+        return jobs;
+    }
+
+    std::vector<Job> load_jobs(const std::string& file)
+    {
+        if (file == "-")
+        {
+            return load_jobs(std::cin);
+        }
+
+        std::ifstream in(file.c_str());
+        if (!in.good())
+        {
+            throw std::runtime_error(compose("Failed to open %0 for reading.", file));
+        }
+        return load_jobs(in);
+    }
+
+    Processor::Processor(const std::vector<Pass>& passes, pkzo::ProgramCache* cache)
+    : window("glslproc", rgm::ivec2(0, 0), rgm::uvec2(1, 1)), schedule(glslproc::schedule(passes)), float_slots(get_float_slots(schedule, passes)), halo(0), tile_size(pkzo::get_max_texture_size()), source_mipmaps(false), intermediate_format(pkzo::RGBA), output_format(pkzo::RGBA), uploads(3), readbacks(3)
+    {
+        // halo of the result in each slot, -1 is the image
+        std::vector<unsigned int> slot_halo(schedule.slots, 0);
+
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            const Step& step = schedule.steps[i];
+            const Pass& pass = passes[step.pass];
+
+            pkzo::Defines defines = pass.defines;
+            pkzo::Kernel  kernel  = prepare_kernel(defines);
+
+            std::unique_ptr<Stage> stage(new Stage);
+            if (is_compute(pass))
+            {
+                stage->shader.load_compute(pass.fragment_file);
+            }
+            else if (pass.fragment_code.empty())
+            {
+                stage->shader.load(pass.vertex_file, pass.fragment_file);
+            }
+            else
+            {
+                stage->shader.set_vertex_code(pkzo::preprocess(pass.vertex_file));
+                stage->shader.set_fragment_code(pass.fragment_code);
+            }
+            stage->shader.set_defines(defines);
+            stage->shader.set_cache(cache);
+            stage->shader.compile();
+
+            // uniforms stay with the program, so once is enough
+            if (!kernel.weights.empty())
+            {
+                stage->shader.bind();
+                stage->shader.set_uniform("uOffsets", kernel.offsets);
+                stage->shader.set_uniform("uWeights", kernel.weights);
+                stage->shader.unbind();
+            }
+
+            stage->output_uniform       = stage->shader.uniform("uOutput");
+            stage->texture_uniform      = stage->shader.uniform("uTexture");
+            stage->texture_size_uniform = stage->shader.uniform("uTextureSize");
+            for (size_t j = 0; j < step.inputs.size(); j++)
+            {
+                stage->input_uniforms.push_back(stage->shader.uniform(compose("uTexture%0", j)));
+                stage->input_size_uniforms.push_back(stage->shader.uniform(compose("uTextureSize%0", j)));
+            }
+
+            unsigned int h = 0;
+            for (size_t j = 0; j < step.inputs.size(); j++)
+            {
+                if (step.inputs[j] >= 0)
+                {
+                    h = std::max(h, slot_halo[step.inputs[j]]);
+                }
+            }
+            slot_halo[step.target] = h + stage->shader.get_footprint();
+
+            stages.push_back(std::move(stage));
+        }
+
+        halo           = slot_halo[schedule.steps.back().target];
+        source_mipmaps = source_needs_mipmaps();
+    }
+
+    Processor::~Processor() {}
+
+    double Processor::get_startup_time() const
+    {
+        return window.get_startup_time();
+    }
+
+    unsigned int Processor::get_readback_depth() const
+    {
+        return readbacks.get_count() - 1;
+    }
+
+    void Processor::set_tile_size(unsigned int value)
+    {
+        tile_size = std::min(value, pkzo::get_max_texture_size());
+    }
+
+    unsigned int Processor::get_tile_size() const
+    {
+        return tile_size;
+    }
+
+    unsigned int Processor::get_halo() const
+    {
+        return halo;
+    }
+
+    bool Processor::needs_tiling(rgm::uvec2 size) const
+    {
+        return size[0] > tile_size || size[1] > tile_size;
+    }
+
+    void Processor::set_intermediate_format(pkzo::ColorFormat value)
+    {
+        intermediate_format = value;
+    }
+
+    pkzo::ColorFormat Processor::get_intermediate_format() const
+    {
+        return intermediate_format;
+    }
+
+    void Processor::set_output_format(pkzo::ColorFormat value)
+    {
+        output_format = value;
+    }
+
+    pkzo::ColorFormat Processor::get_output_format() const
+    {
+        return output_format;
+    }
+
+    const pkzo::ResourcePool& Processor::get_pool() const
+    {
+        return pool;
+    }
+
+    pkzo::Staging Processor::stage(rgm::uvec2 size, pkzo::ColorFormat format)
+    {
+        return uploads.map(size[0] * size[1] * pkzo::get_pixel_size(format));
+    }
+
+    pkzo::Readback Processor::process(pkzo::Staging staging, rgm::uvec2 size, pkzo::ColorFormat format)
+    {
+        pkzo::Texture  source = upload(staging, size, format);
+        pkzo::Readback result = render(source);
+        pool.release(std::move(source));
+        return result;
+    }
+
+    void Processor::discard(pkzo::Staging staging)
+    {
+        uploads.discard(staging);
+    }
+
+    pkzo::Readback Processor::process(pkzo::Texture& input)
+    {
+        pkzo::PixelView view = input.view();
+        return process(stage(view), view.size, view.format);
+    }
+
+    pkzo::Texture Processor::process_timed(const pkzo::Texture& input, StageTimes& times)
+    {
+        if (needs_tiling(input.get_size()))
+        {
+            throw std::invalid_argument("Images processed in tiles can not be timed by stage.");
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        pkzo::PixelView view   = input.view();
+        pkzo::Texture   source = upload(stage(view), view.size, view.format);
+        window.finish();
+
+        auto uploaded = std::chrono::high_resolution_clock::now();
+        pkzo::Readback readback = render(source);
+        pool.release(std::move(source));
+        window.finish();
+
+        auto rendered = std::chrono::high_resolution_clock::now();
+        pkzo::Texture result = readback.get();
+
+        auto done = std::chrono::high_resolution_clock::now();
+        times.upload   = std::chrono::duration<double, std::milli>(uploaded - start).count();
+        times.render   = std::chrono::duration<double, std::milli>(rendered - uploaded).count();
+        times.readback = std::chrono::duration<double, std::milli>(done - rendered).count();
+        return result;
+    }
+
+    struct Tile
+    {
+        pkzo::Readback readback;
+        // where the interior goes in the image, how big it is and where it
+        // starts in the tile
+        rgm::uvec2     origin;
+        rgm::uvec2     extent;
+        rgm::uvec2     offset;
+
+        Tile(pkzo::Readback r, rgm::uvec2 o, rgm::uvec2 e, rgm::uvec2 f)
+        : readback(std::move(r)), origin(o), extent(e), offset(f) {}
+
+        Tile(Tile&& other)
+        : readback(std::move(other.readback)), origin(other.origin), extent(other.extent), offset(other.offset) {}
+    };
+
+    pkzo::Texture Processor::process_tiled(const pkzo::Texture& input)
+    {
+        rgm::uvec2                 size = input.get_size();
+        std::vector<unsigned char> output(size[0] * size[1] * pkzo::get_pixel_size(output_format));
+
+        render_rows(input.view(), 0, size[1], 0, size[1], &output[0]);
+
+        return pkzo::Texture(size, output_format, std::move(output));
+    }
+
+    void Processor::process_streamed(const std::string& input, const std::string& output, unsigned int strip)
+    {
+        pkzo::PngReader reader(input);
+        rgm::uvec2      size   = reader.get_size();
+        size_t          stride = reader.get_stride();
+        strip = std::max(strip, 1u);
+
+        pkzo::PngWriter writer(output, size, output_format);
+
+        // the image's rows first.. first + count, enough for a strip and its halo
+        std::vector<unsigned char> rows((strip + 2 * halo) * stride);
+        size_t                     result_stride = size[0] * pkzo::get_pixel_size(output_format);
+        std::vector<unsigned char> result(strip * result_stride);
+        unsigned int               first = 0;
+        unsigned int               count = 0;
+
+        for (unsigned int y0 = 0; y0 < size[1]; y0 += strip)
+        {
+            unsigned int y1 = std::min(y0 + strip, size[1]);
+
+            // drop what is above the halo, the rest moves to the top
+            unsigned int top = y0 - std::min(y0, halo);
+            if (top > first)
+            {
+                unsigned int drop = top - first;
+                memmove(&rows[0], &rows[drop * stride], (count - drop) * stride);
+                count -= drop;
+                first  = top;
+            }
+
+            unsigned int bottom = std::min(y1 + halo, size[1]);
+            count += reader.read(&rows[count * stride], bottom - first - count, stride);
+
+            pkzo::PixelView view = {&rows[0], rgm::uvec2(size[0], count), reader.get_format(), stride};
+            render_rows(view, first, size[1], y0, y1, &result[0]);
+
+            writer.write(&result[0], y1 - y0, result_stride);
+        }
+
+        writer.finish();
+    }
+
+    void Processor::render_rows(const pkzo::PixelView& view, unsigned int view_y, unsigned int height, unsigned int y0, unsigned int y1, unsigned char* output)
+    {
+        unsigned int width = view.size[0];
+        size_t       pixel = pkzo::get_pixel_size(view.format);
+        size_t       out   = pkzo::get_pixel_size(output_format);
+        if (tile_size <= 2 * halo)
+        {
+            throw std::runtime_error(compose("A tile size of %0 leaves nothing inside the halo of %1.", tile_size, halo));
+        }
+        unsigned int inner = tile_size - 2 * halo;
+
+        std::deque<Tile> pending;
+
+        auto stitch = [&] () {
+            Tile tile = std::move(pending.front());
+            pending.pop_front();
+
+            // straight from the mapped buffer, released with the tile
+            pkzo::PixelView rv = tile.readback.view();
+            for (unsigned int y = 0; y < tile.extent[1]; y++)
+            {
+                const unsigned char* src = rv.data + (tile.offset[1] + y) * rv.stride + tile.offset[0] * out;
+                unsigned char*       dst = output + ((tile.origin[1] - y0 + y) * width + tile.origin[0]) * out;
+                memcpy(dst, src, tile.extent[0] * out);
+            }
+        };
+
+        for (unsigned int ty0 = y0; ty0 < y1; ty0 += inner)
+        {
+            for (unsigned int tx0 = 0; tx0 < width; tx0 += inner)
+            {
+                // interior tx0..tx1, with the halo rx0..rx1 as far as the image goes
+                unsigned int tx1 = std::min(tx0 + inner, width);
+                unsigned int ty1 = std::min(ty0 + inner, y1);
+                unsigned int rx0 = tx0 - std::min(tx0, halo);
+                unsigned int ry0 = ty0 - std::min(ty0, halo);
+                unsigned int rx1 = std::min(tx1 + halo, width);
+                unsigned int ry1 = std::min(ty1 + halo, height);
+                if (ry0 < view_y || ry1 > view_y + view.size[1])
+                {
+                    throw std::logic_error("The rows given do not cover the halo.");
+                }
+
+                rgm::uvec2 tsize(rx1 - rx0, ry1 - ry0);
+                pkzo::Texture source = acquire_source(tsize, view.format);
+
+                pkzo::Staging staging = uploads.map(tsize[0] * tsize[1] * pixel);
+                for (unsigned int y = 0; y < tsize[1]; y++)
+                {
+                    memcpy(staging.data + y * tsize[0] * pixel, view.data + (ry0 - view_y + y) * view.stride + rx0 * pixel, tsize[0] * pixel);
+                }
+                uploads.upload(source, staging);
+
+                pending.push_back(Tile(render(source), rgm::uvec2(tx0, ty0), rgm::uvec2(tx1 - tx0, ty1 - ty0), rgm::uvec2(tx0 - rx0, ty0 - ry0)));
+                pool.release(std::move(source));
+                while (pending.size() > get_readback_depth())
+                {
+                    stitch();
+                }
+            }
+        }
+        while (!pending.empty())
+        {
+            stitch();
+        }
+    }
+
+    pkzo::Readback Processor::render(pkzo::Texture& source)
+    {
+        rgm::uvec2  size = source.get_size();
+        pkzo::Mesh& quad = get_quad(size);
+
+        std::vector<std::unique_ptr<pkzo::FrameBuffer>> targets;
+        for (unsigned int i = 0; i < schedule.slots; i++)
+        {
+            targets.push_back(pool.acquire_frame_buffer(size, float_slots[i] ? pkzo::RGBA32F : intermediate_format));
+        }
+
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            const Step& step  = schedule.steps[i];
+            Stage&      stage = *stages[i];
+
+            if (!stage.shader.is_compute())
+            {
+                targets[step.target]->bind();
+            }
+
+            stage.shader.bind();
+
+            for (size_t j = 0; j < step.inputs.size(); j++)
+            {
+                pkzo::Texture& texture = step.inputs[j] < 0 ? source : targets[step.inputs[j]]->get_color();
+                texture.bind(j);
+                stage.shader.set_uniform(stage.input_uniforms[j], (int)j);
+                stage.shader.set_uniform(stage.input_size_uniforms[j], size);
+            }
+            stage.shader.set_uniform(stage.texture_uniform, 0);
+            stage.shader.set_uniform(stage.texture_size_uniform, size);
+
+            if (stage.shader.is_compute())
+            {
+                targets[step.target]->get_color().bind_image(0);
+                stage.shader.set_uniform(stage.output_uniform, 0);
+                stage.shader.dispatch(size);
+            }
+            else
+            {
+                quad.draw(stage.shader);
+            }
+        }
+
+        pkzo::Readback result = readbacks.read(*targets[schedule.steps.back().target], output_format);
+
+        // the GL runs the commands in order, the next image can have them
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            pool.release(std::move(targets[i]));
+        }
+
+        return result;
+    }
+
+    pkzo::Mesh& Processor::get_quad(rgm::uvec2 size)
+    {
+        QuadKey key(size[0], size[1]);
+        auto i = quads.find(key);
+        if (i != quads.end())
+        {
+            return *i->second;
+        }
+
+        // tiling needs up to four sizes (inside, right, bottom, corner); 
+        // beyond that the sizes likely keep changing, so do not hoard them
+        if (quads.size() >= 4)
+        {
+            quads.clear();
+        }
+
+        std::unique_ptr<pkzo::Mesh> quad(new pkzo::Mesh);
+        quad->add_vertex(rgm::vec3(-1, -1, 0), rgm::vec3(1, 0, 0), rgm::vec2(0, 0));
+        quad->add_vertex(rgm::vec3(-1, 1, 0), rgm::vec3(0, 1, 0), rgm::vec2(0, size[1]));
+        quad->add_vertex(rgm::vec3(1, 1, 0), rgm::vec3(0, 0, 1), rgm::vec2(size[0], size[1]));
+        quad->add_vertex(rgm::vec3(1, -1, 0), rgm::vec3(1, 1, 1), rgm::vec2(size[0], 0));
+        quad->add_face(0, 1, 2);
+        quad->add_face(2, 3, 0);
+
+        pkzo::Mesh& result = *quad;
+        quads[key] = std::move(quad);
+        return result;
+    }
+
+    pkzo::Staging Processor::stage(const pkzo::PixelView& view)
+    {
+        size_t        row     = view.size[0] * pkzo::get_pixel_size(view.format);
+        pkzo::Staging staging = stage(view.size, view.format);
+        for (unsigned int y = 0; y < view.size[1]; y++)
+        {
+            memcpy(staging.data + y * row, view.data + y * view.stride, row);
+        }
+        return staging;
+    }
+
+    pkzo::Texture Processor::upload(pkzo::Staging staging, rgm::uvec2 size, pkzo::ColorFormat format)
+    {
+        pkzo::Texture source;
+        try
+        {
+            source = acquire_source(size, format);
+            uploads.upload(source, staging);
+        }
+        catch (...)
+        {
+            uploads.discard(staging);
+            throw;
+        }
+        return source;
+    }
+
+    pkzo::Texture Processor::acquire_source(rgm::uvec2 size, pkzo::ColorFormat format)
+    {
+        return pool.acquire_texture(size, format, source_mipmaps);
+    }
+
+    bool Processor::source_needs_mipmaps() const
+    {
+        for (size_t i = 0; i < schedule.steps.size(); i++)
+        {
+            const std::vector<int>& inputs = schedule.steps[i].inputs;
+            if (std::find(inputs.begin(), inputs.end(), -1) != inputs.end() && stages[i]->shader.needs_mipmaps())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
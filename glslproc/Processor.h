@@ -0,0 +1,160 @@
+
+#ifndef _GLSLPROC_PROCESSOR_H_
+#define _GLSLPROC_PROCESSOR_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pkzo/pkzo.h>
+
+#include "Pipeline.h"
+
+namespace glslproc
+{
+    struct Job
+    {
+        std::string input;
+        std::string output;
+    };
+
+    std::vector<Job> load_jobs(const std::string& file);
+
+    // Holds one context and the shaders and pushes any number of images
+    // through them. Per image only the upload, draws, readback and the PNG
+    // decode / encode remain. The passes run in the order of the pipeline's
+    // schedule, sampling the results of earlier passes straight from their
+    // frame buffers; only the final result leaves the GPU. Textures and 
+    // frame buffers come from a pool, so an image of a size seen before 
+    // allocates nothing. Uploads stream through pixel buffers. The readback
+    // is asynchronous; keep up to get_readback_depth() readbacks in flight
+    // to not stall the GPU.
+    //
+    // Images larger than the tile size are cut into tiles that overlap by 
+    // the pipeline's halo: the sum of the passes' footprints along the way 
+    // from the image to the output. Each tile runs through the passes as 
+    // if it were an image and only its interior is kept, so the result is
+    // the same as in one piece while GPU memory stays bounded by the tile
+    // size. Shaders see the tile through uTextureSize.
+    class Processor
+    {
+    public:
+        // cache may be NULL, otherwise it is used to skip the shader compile
+        Processor(const std::vector<Pass>& passes, pkzo::ProgramCache* cache = NULL);
+
+        ~Processor();
+
+        double get_startup_time() const;
+
+        unsigned int get_readback_depth() const;
+
+        // tiles are at most value x value pixels, by default the largest
+        // texture size
+        void set_tile_size(unsigned int value);
+
+        unsigned int get_tile_size() const;
+
+        unsigned int get_halo() const;
+
+        bool needs_tiling(rgm::uvec2 size) const;
+
+        // Format of the frame buffers the passes render to, RGBA by 
+        // default. With RGBA16F or RGBA32F results are not quantized to 8
+        // bit between passes. Prefix sums are always RGBA32F.
+        void set_intermediate_format(pkzo::ColorFormat value);
+
+        pkzo::ColorFormat get_intermediate_format() const;
+
+        // Format the result is read back in, RGBA by default. A gray format
+        // takes the red channel.
+        void set_output_format(pkzo::ColorFormat value);
+
+        pkzo::ColorFormat get_output_format() const;
+
+        const pkzo::ResourcePool& get_pool() const;
+
+        // Driver visible memory for an image of size and format, tightly
+        // packed. It may be filled on any thread, e.g. by decoding straight
+        // into it, but has to come back to process or discard on this one.
+        pkzo::Staging stage(rgm::uvec2 size, pkzo::ColorFormat format);
+
+        pkzo::Readback process(pkzo::Staging staging, rgm::uvec2 size, pkzo::ColorFormat format);
+
+        void discard(pkzo::Staging staging);
+
+        // an image already in memory, copied to staging memory first
+        pkzo::Readback process(pkzo::Texture& input);
+
+        // process tile by tile, waits for the result
+        pkzo::Texture process_tiled(const pkzo::Texture& input);
+
+        // Process an image that needs no tiling and wait for the GPU after
+        // each stage, to time it on its own: the upload from memory, the
+        // passes up to the copy of the result into a pixel buffer, and the
+        // readback into memory. Slower than process, for reports.
+        pkzo::Texture process_timed(const pkzo::Texture& input, StageTimes& times);
+
+        // Stream a PNG through the pipeline strip rows at a time: decode the
+        // strip and its halo, run it as a row of tiles and encode the result
+        // right away. Only about (strip + 2 * halo) rows of the image are in
+        // memory at once, whatever its height.
+        void process_streamed(const std::string& input, const std::string& output, unsigned int strip);
+
+    private:
+        // one per scheduled step
+        struct Stage
+        {
+            pkzo::Shader                     shader;
+            pkzo::UniformHandle              output_uniform;
+            pkzo::UniformHandle              texture_uniform;
+            pkzo::UniformHandle              texture_size_uniform;
+            std::vector<pkzo::UniformHandle> input_uniforms;
+            std::vector<pkzo::UniformHandle> input_size_uniforms;
+        };
+
+        typedef std::pair<unsigned int, unsigned int> QuadKey;
+
+        pkzo::Window window;
+
+        Schedule                            schedule;
+        std::vector<bool>                   float_slots;
+        std::vector<std::unique_ptr<Stage>> stages;
+        unsigned int                        halo;
+        unsigned int                        tile_size;
+        bool                                source_mipmaps;
+        pkzo::ColorFormat                   intermediate_format;
+        pkzo::ColorFormat                   output_format;
+
+        std::map<QuadKey, std::unique_ptr<pkzo::Mesh>> quads;
+        pkzo::ResourcePool                             pool;
+        pkzo::UploadRing                               uploads;
+        pkzo::ReadbackRing                             readbacks;
+
+        pkzo::Mesh& get_quad(rgm::uvec2 size);
+
+        pkzo::Texture acquire_source(rgm::uvec2 size, pkzo::ColorFormat format);
+
+        // copy an image in memory to staging memory
+        pkzo::Staging stage(const pkzo::PixelView& view);
+
+        // a source texture with the staged image, the staging memory is 
+        // given back either way
+        pkzo::Texture upload(pkzo::Staging staging, rgm::uvec2 size, pkzo::ColorFormat format);
+
+        // Run the passes on source, with frame buffers from the pool, and 
+        // start reading back the result.
+        pkzo::Readback render(pkzo::Texture& source);
+
+        // Render rows y0..y1 of an image that is height rows high tile by 
+        // tile into output, RGBA and tightly packed. view holds the image's
+        // rows from view_y on, at least those of y0..y1 and their halo.
+        void render_rows(const pkzo::PixelView& view, unsigned int view_y, unsigned int height, unsigned int y0, unsigned int y1, unsigned char* output);
+
+        bool source_needs_mipmaps() const;
+
+        Processor(const Processor&) = delete;
+        const Processor& operator = (const Processor&) = delete;
+    };
+}
+
+#endif
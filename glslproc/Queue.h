@@ -0,0 +1,78 @@
+
+#ifndef _GLSLPROC_QUEUE_H_
+#define _GLSLPROC_QUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace glslproc
+{
+    // Bounded blocking queue to connect the stages of a batch run. 
+    // push blocks while the queue is full and pop while it is empty. Once
+    // closed, push fails and pop drains what is left and then fails.
+    template <typename T>
+    class Queue
+    {
+    public:
+
+        Queue(size_t c)
+        : capacity(c), closed(false) {}
+
+        bool push(T&& value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this] () {
+                return closed || items.size() < capacity;
+            });
+
+            if (closed)
+            {
+                return false;
+            }
+
+            items.push_back(std::move(value));
+            not_empty.notify_one();
+            return true;
+        }
+
+        bool pop(T& value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this] () {
+                return closed || !items.empty();
+            });
+
+            if (items.empty())
+            {
+                return false;
+            }
+
+            value = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            closed = true;
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+
+    private:
+        std::mutex              mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<T>           items;
+        size_t                  capacity;
+        bool                    closed;
+
+        Queue(const Queue&) = delete;
+        const Queue& operator = (const Queue&) = delete;
+    };
+}
+
+#endif
@@ -1,77 +1,450 @@
+// glslproc runs GLSL shaders over PNG images, on the GPU or without one on
+// the CPU; glslproc --help explains the options.
 
-/*
-    Note:
-    Just in case you are wondering why no windowless context is used here...
-    The windowless context can be created through the ARB extentions; but they 
-    need to be loaded through a context. So to get the functions for a windowless
-    context a context with a window needs to be created...
-    If there is already a hidden window, why not just use that context and 
-    render everything to an FBO and be done with it.
-*/
-
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
 #include <pkzo/pkzo.h>
 
+#include "compose.h"
+
+#include "Processor.h"
+#include "CpuProcessor.h"
+#include "Batch.h"
+#include "Benchmark.h"
+#include "Compare.h"
+
+void usage(std::ostream& out)
+{
+    out << "Usage: " << std::endl
+          << "glslproc [options] <image> <vertex code> <fragment code> <output>" << std::endl
+          << "glslproc [options] [-j threads] -b <list> <vertex code> <fragment code>" << std::endl
+          << "glslproc [options] -p <pipeline> <image> <output>" << std::endl
+          << "glslproc [options] [-j threads] -p <pipeline> -b <list>" << std::endl
+          << "glslproc [options] --scaling <size> <image> <vertex code> <fragment code>" << std::endl
+          << "glslproc [options] --scaling <size> -p <pipeline> <image>" << std::endl
+          << "glslproc [options] --compare <report> <image> [<shader dir>]" << std::endl
+          << "glslproc [options] --compare <report> -p <pipeline> <image>" << std::endl
+          << "Options:" << std::endl
+          << "  -h, --help        show this and notes on the options" << std::endl
+          << "  -t                print timing and cache statistics" << std::endl
+          << "  -D NAME[=VALUE]   define NAME in the shaders" << std::endl
+          << "  --no-cache        do not use the program binary cache" << std::endl
+          << "  --no-fuse         run pointwise shaders as separate passes" << std::endl
+          << "  --compute         use the compute version of a shader where there is one" << std::endl
+          << "  --cpu             run on the CPU, also the default without OpenGL" << std::endl
+          << "  --translate       run all shaders translated on the CPU, implies --cpu" << std::endl
+          << "  --simd <level>    use at most scalar, sse4 or avx code on the CPU" << std::endl
+          << "  --threads <count> threads for the filters on the CPU, by default all" << std::endl
+          << "  --compare <file>  compare and time GPU and CPU, write a JSON report" << std::endl
+          << "  --scaling <size>  time the CPU filters on 1 to all threads, on the image" << std::endl
+          << "                    repeated to size WxH (0 for as it is)" << std::endl
+          << "  --format <format> store results between passes as rgba8 (default)," << std::endl
+          << "                    rgba16, rgba16f or rgba32f" << std::endl
+          << "  --output-format <format>" << std::endl
+          << "                    write gray8, gray16, rgb8, rgb16, rgba8 (default) or" << std::endl
+          << "                    rgba16 PNGs" << std::endl
+          << "  --cache-dir <dir> store program binaries in dir" << std::endl
+          << "  --tile <size>     process images in tiles of at most size x size" << std::endl
+          << "  --strip <rows>    stream images through in strips of rows" << std::endl;
+}
+
+void help()
+{
+    usage(std::cout);
+    std::cout << "Notes:" << std::endl
+              << "  Shaders may #include files; -D defines are added right after #version," << std::endl
+              << "  e.g. -D KERNEL_SIZE=7 for gauss, -D RADIUS=10 for lingauss." << std::endl
+              << "  A pipeline (-p) chains passes on the GPU without reading back between" << std::endl
+              << "  them, see Pipeline.h. Consecutive #pragma pointwise shaders are fused." << std::endl
+              << "  Linked programs are cached in ~/.pkzo/programs (%ProgramData%\\pkzo\\" << std::endl
+              << "  programs on Windows) unless --cache-dir is given." << std::endl
+              << "  Images may be 8 or 16 bit gray, gray alpha, RGB, RGBA or palette PNGs." << std::endl
+              << "  --compute needs OpenGL 4.3; it runs faichen.comp, lingauss.comp and" << std::endl
+              << "  scan.comp instead of the fragment shaders." << std::endl
+              << "  On the CPU the bundled filters have code of their own and other shaders" << std::endl
+              << "  are translated from GLSL, see CpuProcessor.h. They use AVX or SSE4 where" << std::endl
+              << "  there is one and run in cache sized tiles on all cores." << std::endl
+              << "  box, tent, boxgauss and sat.pipeline blur in constant time per pixel" << std::endl
+              << "  from prefix sums, which are always kept as rgba32f." << std::endl
+              << "  Images larger than the texture size, or --tile, are processed in tiles" << std::endl
+              << "  that overlap by the shaders' #pragma footprint(N)." << std::endl
+              << "  A list (-b) has one \"<image> <output>\" pair per line; -j threads each" << std::endl
+              << "  decode and encode PNGs while the images render." << std::endl
+              << "  --compare writes a JSON report of how fast and how close to the GPU the" << std::endl
+              << "  CPU filters and translated shaders are, see Compare.h." << std::endl;
+}
+
+pkzo::ColorFormat parse_format(const std::string& value)
+{
+    const char*             names[]   = {"gray8", "gray16", "rgb8", "rgb16", "rgba8", "rgba16", "rgba16f", "rgba32f"};
+    const pkzo::ColorFormat formats[] = {pkzo::R8, pkzo::R16, pkzo::RGB, pkzo::RGB16, pkzo::RGBA, pkzo::RGBA16, pkzo::RGBA16F, pkzo::RGBA32F};
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (value == names[i])
+        {
+            return formats[i];
+        }
+    }
+    throw std::invalid_argument(compose("Unknown format %0.", value));
+}
+
+pkzo::SimdLevel parse_simd(const std::string& value)
+{
+    const char*           names[]  = {"scalar", "sse4", "avx"};
+    const pkzo::SimdLevel levels[] = {pkzo::SCALAR, pkzo::SSE4, pkzo::AVX};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        if (value == names[i])
+        {
+            return levels[i];
+        }
+    }
+    throw std::invalid_argument(compose("Unknown instruction set %0.", value));
+}
+
+rgm::uvec2 parse_size(const std::string& value)
+{
+    if (value == "0")
+    {
+        return rgm::uvec2(0, 0);
+    }
+
+    unsigned int width  = 0;
+    unsigned int height = 0;
+    size_t       x      = value.find('x');
+    if (x != std::string::npos)
+    {
+        width  = std::atoi(value.substr(0, x).c_str());
+        height = std::atoi(value.substr(x + 1).c_str());
+    }
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument(compose("Invalid size %0, expected WxH.", value));
+    }
+    return rgm::uvec2(width, height);
+}
+
 int main(int argc, char* argv[])
 {
     // options
     try
     {
-        std::string input;
-        std::string vcode;
-        std::string fcode;
-        std::string output;
-        if (argc == 5)
+        bool          timing  = false;
+        bool          caching = true;
+        bool          fusing  = true;
+        bool          compute = false;
+        bool          cpu     = false;
+        bool          translate = false;
+        bool          scaling = false;
+        rgm::uvec2    scaling_size(0, 0);
+        unsigned int  cpu_threads = 0;
+        std::string   cache_dir;
+        pkzo::Defines defines;
+        unsigned int  threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+        std::string   list;
+        std::string   pipeline;
+        std::string   report;
+        unsigned int  tile_size = 0;
+        unsigned int  strip_height = 0;
+        pkzo::ColorFormat format = pkzo::RGBA;
+        pkzo::ColorFormat output_format = pkzo::RGBA;
+        std::vector<std::string> args;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "-h" || arg == "--help")
+            {
+                help();
+                return 0;
+            }
+            else if (arg == "-t")
+            {
+                timing = true;
+            }
+            else if (arg == "-D" && i + 1 < argc)
+            {
+                pkzo::parse_define(argv[++i], defines);
+            }
+            else if (arg.size() > 2 && arg.compare(0, 2, "-D") == 0)
+            {
+                pkzo::parse_define(arg.substr(2), defines);
+            }
+            else if (arg == "--no-cache")
+            {
+                caching = false;
+            }
+            else if (arg == "--compute")
+            {
+                compute = true;
+            }
+            else if (arg == "--cpu")
+            {
+                cpu = true;
+            }
+            else if (arg == "--translate")
+            {
+                translate = true;
+                cpu       = true;
+            }
+            else if (arg == "--simd" && i + 1 < argc)
+            {
+                pkzo::set_simd_level(parse_simd(argv[++i]));
+            }
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                cpu_threads = std::max(std::atoi(argv[++i]), 1);
+            }
+            else if (arg == "--scaling" && i + 1 < argc)
+            {
+                scaling      = true;
+                scaling_size = parse_size(argv[++i]);
+                cpu          = true;
+            }
+            else if (arg == "--compare" && i + 1 < argc)
+            {
+                report = argv[++i];
+            }
+            else if (arg == "--no-fuse")
+            {
+                fusing = false;
+            }
+            else if (arg == "--format" && i + 1 < argc)
+            {
+                format = parse_format(argv[++i]);
+                if (pkzo::get_channel_count(format) != 4)
+                {
+                    throw std::invalid_argument("Results between passes need all four channels.");
+                }
+            }
+            else if (arg == "--output-format" && i + 1 < argc)
+            {
+                output_format = parse_format(argv[++i]);
+            }
+            else if (arg == "--cache-dir" && i + 1 < argc)
+            {
+                cache_dir = argv[++i];
+            }
+            else if (arg == "--tile" && i + 1 < argc)
+            {
+                tile_size = std::max(std::atoi(argv[++i]), 1);
+            }
+            else if (arg == "--strip" && i + 1 < argc)
+            {
+                strip_height = std::max(std::atoi(argv[++i]), 1);
+            }
+            else if (arg == "-j" && i + 1 < argc)
+            {
+                threads = std::max(std::atoi(argv[++i]), 1);
+            }
+            else if (arg == "-p" && i + 1 < argc)
+            {
+                pipeline = argv[++i];
+            }
+            else if (arg == "-b" && i + 1 < argc)
+            {
+                list = argv[++i];
+            }
+            else
+            {
+                args.push_back(arg);
+            }
+        }
+
+        if (!report.empty())
+        {
+            // the image and the shader directory, or the image for a pipeline
+            if (args.empty() || args.size() > (pipeline.empty() ? 2u : 1u) || !list.empty() || scaling)
+            {
+                usage(std::cerr);
+                return -1;
+            }
+
+            std::vector<glslproc::Comparison> comparisons;
+            if (pipeline.empty())
+            {
+                comparisons = glslproc::get_bundled_comparisons(args.size() == 2 ? args[1] : ".");
+            }
+            else
+            {
+                glslproc::Comparison comparison = {pipeline, glslproc::load_pipeline(pipeline)};
+                comparisons.push_back(comparison);
+            }
+            for (auto c = comparisons.begin(); c != comparisons.end(); ++c)
+            {
+                for (auto i = c->passes.begin(); i != c->passes.end(); ++i)
+                {
+                    i->defines.insert(defines.begin(), defines.end());
+                }
+                glslproc::prepare_boxes(c->passes);
+                c->passes = glslproc::prepare_pointwise(c->passes, fusing);
+            }
+
+            std::unique_ptr<pkzo::ProgramCache> cache;
+            if (caching)
+            {
+                cache.reset(cache_dir.empty() ? new pkzo::ProgramCache : new pkzo::ProgramCache(cache_dir));
+            }
+
+            std::ofstream out(report);
+            if (!out)
+            {
+                throw std::runtime_error(compose("Failed to open %0 for writing.", report));
+            }
+            pkzo::set_cpu_threads(cpu_threads);
+            unsigned int failed = glslproc::compare_backends(comparisons, args[0], format, cache.get(), out);
+            return failed == 0 ? 0 : -1;
+        }
+
+        // the shaders come either from the command line or a pipeline file, 
+        // the images either from the command line or a list; --scaling
+        // writes no output
+        size_t shader_args = pipeline.empty() ? 2 : 0;
+        size_t image_args  = list.empty() ? (scaling ? 1 : 2) : 0;
+        if (args.size() != shader_args + image_args || (scaling && !list.empty()))
         {
-            input  = argv[1];
-            vcode  = argv[2];
-            fcode  = argv[3];
-            output = argv[4];
+            usage(std::cerr);
+            return -1;
+        }
+
+        std::vector<glslproc::Job> jobs;
+        if (list.empty())
+        {
+            glslproc::Job job = {args.front(), scaling ? "" : args.back()};
+            jobs.push_back(job);
         }
         else
         {
-            std::cerr << "Usage: " << std::endl
-                      << "glslproc <image> <vertex code> <fragment code> <output>" << std::endl;
+            jobs = glslproc::load_jobs(list);
+        }
 
+        std::vector<glslproc::Pass> passes;
+        if (pipeline.empty())
+        {
+            size_t first = list.empty() ? 1 : 0;
+            glslproc::Pass pass;
+            pass.vertex_file   = args[first];
+            pass.fragment_file = args[first + 1];
+            passes.push_back(pass);
+        }
+        else
+        {
+            passes = glslproc::load_pipeline(pipeline);
         }
 
-        pkzo::Texture input_texture;
-        input_texture.load(input);
-        
-        pkzo::Window window("dummy", rgm::ivec2(0, 0), input_texture.get_size());
-        window.show();
+        // -D applies to all passes, unless the pipeline overrides it
+        for (auto i = passes.begin(); i != passes.end(); ++i)
+        {
+            i->defines.insert(defines.begin(), defines.end());
+        }
+        glslproc::prepare_boxes(passes);
 
-        pkzo::Shader shader;
-        shader.load(vcode, fcode);
+        // the CPU knows the filters by their #pragma cpu, not compute, and 
+        // translates the rest
+        std::vector<glslproc::Pass> cpu_passes = glslproc::prepare_pointwise(passes, fusing);
 
-        rgm::uvec2 is = input_texture.get_size();
+        size_t pass_count = passes.size();
+        passes = glslproc::prepare_pointwise(passes, fusing);
+        if (compute)
+        {
+            glslproc::prefer_compute(passes);
+        }
 
-        pkzo::Mesh mesh;
-        mesh.add_vertex(rgm::vec3(-1, -1, 0), rgm::vec3(1, 0, 0), rgm::vec2(0, 0));
-        mesh.add_vertex(rgm::vec3(-1, 1, 0), rgm::vec3(0, 1, 0), rgm::vec2(0, is[1]));
-        mesh.add_vertex(rgm::vec3(1, 1, 0), rgm::vec3(0, 0, 1), rgm::vec2(is[0], is[1]));
-        mesh.add_vertex(rgm::vec3(1, -1, 0), rgm::vec3(1, 1, 1), rgm::vec2(is[0], 0));
-        mesh.add_face(0, 1, 2);
-        mesh.add_face(2, 3, 0);
-        
-        window.on_draw([&] () {
-            shader.bind();        
+        std::unique_ptr<pkzo::ProgramCache> cache;
+        if (caching)
+        {
+            cache.reset(cache_dir.empty() ? new pkzo::ProgramCache : new pkzo::ProgramCache(cache_dir));
+        }
 
-            input_texture.bind(0);
-            shader.set_uniform("uTexture", 0);
-            shader.set_uniform("uTextureSize", input_texture.get_size());
+        auto compile_start = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<glslproc::Processor>    processor;
+        std::unique_ptr<glslproc::CpuProcessor> cpu_processor;
+        std::unique_ptr<glslproc::Batch>        batch;
+        if (!cpu)
+        {
+            try
+            {
+                processor.reset(new glslproc::Processor(passes, cache.get()));
+            }
+            catch (pkzo::ContextError& ex)
+            {
+                std::cerr << ex.what() << " Running on the CPU." << std::endl;
+            }
+        }
+
+        if (processor)
+        {
+            if (tile_size != 0)
+            {
+                processor->set_tile_size(tile_size);
+            }
+            processor->set_intermediate_format(format);
+            processor->set_output_format(output_format);
+            batch.reset(new glslproc::Batch(*processor, threads, threads));
+        }
+        else
+        {
+            pkzo::set_cpu_threads(cpu_threads);
+            cpu_processor.reset(new glslproc::CpuProcessor(cpu_passes, translate));
+            cpu_processor->set_intermediate_format(format);
+            cpu_processor->set_output_format(output_format);
+            batch.reset(new glslproc::Batch(*cpu_processor, threads, threads));
+        }
+        batch->set_strip_height(strip_height);
+
+        if (timing && processor)
+        {
+            std::chrono::duration<double, std::milli> d = std::chrono::high_resolution_clock::now() - compile_start;
+            std::cerr << "context creation: " << processor->get_startup_time() << " ms" << std::endl
+                      << "shader setup: " << d.count() - processor->get_startup_time() << " ms" << std::endl;
+            if (passes.size() != pass_count)
+            {
+                std::cerr << "fused " << pass_count << " passes into " << passes.size() << std::endl;
+            }
+            if (cache)
+            {
+                std::cerr << "program cache: " << cache->get_hits() << " hits, " << cache->get_misses() << " misses";
+                if (cache->get_rejects() != 0)
+                {
+                    std::cerr << " (" << cache->get_rejects() << " rejected)";
+                }
+                std::cerr << std::endl;
+            }
+        }
+        if (timing && cpu_processor)
+        {
+            std::cerr << "running on the CPU with " << pkzo::get_simd_name(pkzo::get_simd_level()) << " kernels on " << pkzo::get_cpu_threads() << " threads" << std::endl;
+        }
 
-            mesh.draw(shader);
+        if (scaling)
+        {
+            pkzo::Texture image;
+            image.load(jobs.front().input);
+            rgm::uvec2 size = scaling_size[0] != 0 ? scaling_size : image.get_size();
+            unsigned int max_threads = cpu_threads != 0 ? cpu_threads : std::max(std::thread::hardware_concurrency(), 1u);
+            glslproc::benchmark_scaling(*cpu_processor, image, size, strip_height, max_threads, std::cout);
+            return 0;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
 
-            pkzo::Texture& output_texture = window.read_color();
-            output_texture.save(output);
+        unsigned int failed = batch->run(jobs);
 
-            window.close();
-        });            
-        
-        window.run();              
-        
+        if (timing)
+        {
+            std::chrono::duration<double, std::milli> d = std::chrono::high_resolution_clock::now() - start;
+            std::cerr << "processed " << jobs.size() << " images in " << d.count() << " ms" << std::endl;
+            if (processor)
+            {
+                std::cerr << "frame buffers and textures: " << processor->get_pool().get_allocations() << " allocated, " << processor->get_pool().get_reuses() << " reused" << std::endl;
+            }
+        }
 
-        return 0;
+        return failed == 0 ? 0 : -1;
     }
     catch (std::exception& ex)
     {
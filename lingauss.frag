@@ -1,6 +1,11 @@
 #version 400
  
-int radius = 25;
+#ifndef RADIUS
+#define RADIUS 25
+#endif
+
+#pragma cpu(lingauss)
+#pragma footprint(RADIUS)
  
 uniform sampler2D uTexture;
 uniform uvec2 uTextureSize;
@@ -12,12 +17,12 @@ out vec4 oFragColor;
 void main(void)
 {	
     vec3 result = vec3(0);
-    for (int i = -radius; i <= radius; i++)
+    for (int i = -RADIUS; i <= RADIUS; i++)
     {
-        for (int j = -radius; j <= radius; j++) 
+        for (int j = -RADIUS; j <= RADIUS; j++) 
         {
-            float r = radius;
-            float f = (radius - length(vec2(0,0) - vec2(i,j))) / r;
+            float r = RADIUS;
+            float f = (RADIUS - length(vec2(0,0) - vec2(i,j))) / r;
             result += texelFetch(uTexture, ivec2(vTexCoord) + ivec2(i, j), 0).rgb * f;
         }
     }
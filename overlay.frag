@@ -0,0 +1,23 @@
+#version 400
+
+// Draw edges on top of the image: uTexture0 is the original, uTexture1 the
+// edges, e.g. from sobel.frag.
+
+#ifndef EDGE_COLOR
+#define EDGE_COLOR vec3(1.0, 0.0, 0.0)
+#endif
+
+uniform sampler2D uTexture0;
+uniform sampler2D uTexture1;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    vec3  original = texelFetch(uTexture0, ivec2(vTexCoord), 0).rgb;
+    float edge     = clamp(texelFetch(uTexture1, ivec2(vTexCoord), 0).r, 0.0, 1.0);
+
+    oFragColor = vec4(mix(original, EDGE_COLOR, edge), 1);
+}
@@ -1,5 +1,7 @@
 #version 400
 
+#pragma cpu(pass)
+
 uniform sampler2D uTexture;
 uniform uvec2 uTextureSize;
 
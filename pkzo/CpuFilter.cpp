@@ -0,0 +1,515 @@
+
+#include "CpuFilter.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "CpuKernels.h"
+#include "CpuPlane.h"
+
+namespace pkzo
+{
+    SimdLevel detect_simd()
+    {
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool sse4    = (info[2] & (1 << 19)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx     = (info[2] & (1 << 28)) != 0;
+
+        // the OS must also save the upper halves of the registers
+        bool ymm = osxsave && (_xgetbv(0) & 6) == 6;
+
+        if (avx && ymm)
+        {
+            return AVX;
+        }
+        return sse4 ? SSE4 : SCALAR;
+    #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx"))
+        {
+            return AVX;
+        }
+        return __builtin_cpu_supports("sse4.1") ? SSE4 : SCALAR;
+    #else
+        return SCALAR;
+    #endif
+    }
+
+    SimdLevel get_supported_simd()
+    {
+        static const SimdLevel supported = detect_simd();
+        return supported;
+    }
+
+    // -1 is the best supported; atomic, as any level gives the same result
+    // a filter may pick up a new one halfway
+    static std::atomic<int> simd_limit(-1);
+
+    void set_simd_level(SimdLevel value)
+    {
+        simd_limit = value;
+    }
+
+    SimdLevel get_simd_level()
+    {
+        SimdLevel supported = get_supported_simd();
+        int       limit     = simd_limit;
+        return limit < 0 ? supported : std::min((SimdLevel)limit, supported);
+    }
+
+    const char* get_simd_name(SimdLevel level)
+    {
+        switch (level)
+        {
+            case AVX:
+                return get_avx_kernels().name;
+            case SSE4:
+                return get_sse4_kernels().name;
+            default:
+                return get_scalar_kernels().name;
+        }
+    }
+
+    const CpuKernels& get_cpu_kernels()
+    {
+        switch (get_simd_level())
+        {
+            case AVX:
+                return get_avx_kernels();
+            case SSE4:
+                return get_sse4_kernels();
+            default:
+                return get_scalar_kernels();
+        }
+    }
+
+    static std::unique_ptr<TileScheduler> cpu_scheduler;
+    static unsigned int                   cpu_threads = 0;
+
+    void set_cpu_threads(unsigned int value)
+    {
+        if (value != cpu_threads)
+        {
+            cpu_threads = value;
+            cpu_scheduler.reset();
+        }
+    }
+
+    unsigned int get_cpu_threads()
+    {
+        return get_cpu_scheduler().get_thread_count();
+    }
+
+    TileScheduler& get_cpu_scheduler()
+    {
+        if (!cpu_scheduler)
+        {
+            cpu_scheduler.reset(new TileScheduler(cpu_threads));
+        }
+        return *cpu_scheduler;
+    }
+
+    void fill_row(float* row, float value, unsigned int count)
+    {
+        std::fill(row, row + count, value);
+    }
+
+    CpuImage cpu_pass(const CpuImage& input)
+    {
+        rgm::uvec2 size = input.get_size();
+        CpuImage   output(size);
+        get_cpu_scheduler().run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int y = first; y < first + count; y++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    memcpy(output.get_row(c, y), input.get_row(c, y), size[0] * sizeof(float));
+                }
+                fill_row(output.get_row(3, y), 1.0f, size[0]);
+            }
+        });
+        return output;
+    }
+
+    typedef void (*Stencil)(float* out, const float* above, const float* row, const float* below, size_t count);
+
+    // a 3x3 kernel on the length of each pixel's RGB, into all channels
+    CpuImage apply_stencil(const CpuImage& input, const CpuKernels& kernels, Stencil stencil)
+    {
+        TileScheduler& scheduler = get_cpu_scheduler();
+        rgm::uvec2     size      = input.get_size();
+
+        Plane plane(size, 1);
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int y = first; y < first + count; y++)
+            {
+                kernels.intensity(plane.get_row(y), input.get_row(0, y), input.get_row(1, y), input.get_row(2, y), size[0]);
+            }
+        });
+
+        // reads the intensities, writes four channels
+        CpuImage output(size);
+        scheduler.run(size, 1, 5, [&] (const Tile& tile) {
+            unsigned int x = tile.origin[0];
+            unsigned int w = tile.size[0];
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                float* out = output.get_row(0, y) + x;
+                stencil(out, plane.get_row((int)y - 1) + x, plane.get_row(y) + x, plane.get_row(y + 1) + x, w);
+                for (unsigned int c = 1; c < 4; c++)
+                {
+                    memcpy(output.get_row(c, y) + x, out, w * sizeof(float));
+                }
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_sobel(const CpuImage& input)
+    {
+        const CpuKernels& kernels = get_cpu_kernels();
+        return apply_stencil(input, kernels, kernels.sobel);
+    }
+
+    CpuImage cpu_faichen(const CpuImage& input)
+    {
+        const CpuKernels& kernels = get_cpu_kernels();
+        return apply_stencil(input, kernels, kernels.faichen);
+    }
+
+    CpuImage cpu_scan(const CpuImage& input, unsigned int chunk, bool vertical)
+    {
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+        CpuImage          output(size);
+        if (chunk == 0)
+        {
+            chunk = vertical ? size[1] : size[0];
+        }
+
+        if (!vertical)
+        {
+            scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+                for (unsigned int y = first; y < first + count; y++)
+                {
+                    for (unsigned int c = 0; c < 3; c++)
+                    {
+                        const float* in  = input.get_row(c, y);
+                        float*       out = output.get_row(c, y);
+                        float        sum = 0.0f;
+                        for (unsigned int x = 0; x < size[0]; x++)
+                        {
+                            sum    = x % chunk == 0 ? in[x] : sum + in[x];
+                            out[x] = sum;
+                        }
+                    }
+                    fill_row(output.get_row(3, y), 1.0f, size[0]);
+                }
+            });
+            return output;
+        }
+
+        // a tile is one run of rows, which only depends on itself
+        unsigned int width = scheduler.get_tile_size(size, 0, 2)[0];
+        scheduler.run(size, rgm::uvec2(width, chunk), [&] (const Tile& tile) {
+            unsigned int x = tile.origin[0];
+            unsigned int w = tile.size[0];
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    float* out = output.get_row(c, y) + x;
+                    memcpy(out, input.get_row(c, y) + x, w * sizeof(float));
+                    if (y != tile.origin[1])
+                    {
+                        kernels.accumulate(out, output.get_row(c, y - 1) + x, 1.0f, w);
+                    }
+                }
+                fill_row(output.get_row(3, y) + x, 1.0f, w);
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_carry(const CpuImage& input, unsigned int chunk, bool vertical)
+    {
+        if (chunk == 0)
+        {
+            throw std::invalid_argument("The chunk of carry must be at least 1.");
+        }
+
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+        CpuImage          output(size);
+
+        if (!vertical)
+        {
+            scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+                for (unsigned int y = first; y < first + count; y++)
+                {
+                    for (unsigned int c = 0; c < 3; c++)
+                    {
+                        const float* in    = input.get_row(c, y);
+                        float*       out   = output.get_row(c, y);
+                        float        carry = 0.0f;
+                        for (unsigned int x = 0; x < size[0]; x++)
+                        {
+                            if (x != 0 && x % chunk == 0)
+                            {
+                                carry += in[x - 1];
+                            }
+                            out[x] = in[x] + carry;
+                        }
+                    }
+                    fill_row(output.get_row(3, y), 1.0f, size[0]);
+                }
+            });
+            return output;
+        }
+
+        // columns depend on all rows above, so tiles are as high as the image
+        unsigned int width = scheduler.get_tile_size(size, 0, 3)[0];
+        scheduler.run(size, rgm::uvec2(width, size[1]), [&] (const Tile& tile) {
+            unsigned int       x = tile.origin[0];
+            unsigned int       w = tile.size[0];
+            std::vector<float> carry(3 * w, 0.0f);
+            for (unsigned int y = 0; y < size[1]; y++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    if (y != 0 && y % chunk == 0)
+                    {
+                        kernels.accumulate(&carry[c * w], input.get_row(c, y - 1) + x, 1.0f, w);
+                    }
+                    float* out = output.get_row(c, y) + x;
+                    memcpy(out, input.get_row(c, y) + x, w * sizeof(float));
+                    kernels.accumulate(out, &carry[c * w], 1.0f, w);
+                }
+                fill_row(output.get_row(3, y) + x, 1.0f, w);
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_box(const CpuImage& input, unsigned int radius, bool vertical)
+    {
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+        int               r         = (int)radius;
+        float             divisor   = (float)(2 * radius + 1);
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return CpuImage(size);
+        }
+
+        Plane red(size, radius + 1), green(size, radius + 1), blue(size, radius + 1);
+        Plane* planes[3] = {&red, &green, &blue};
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                planes[c]->copy(input, c, first, count);
+            }
+        });
+        for (unsigned int c = 0; c < 3; c++)
+        {
+            planes[c]->extend(size);
+        }
+
+        CpuImage output(size);
+        scheduler.run(size, radius, 2, [&] (const Tile& tile) {
+            unsigned int x = tile.origin[0];
+            unsigned int w = tile.size[0];
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    const float* hi = vertical ? planes[c]->get_row((int)y + r) + x : planes[c]->get_row(y) + x + r;
+                    const float* lo = vertical ? planes[c]->get_row((int)y - r - 1) + x : planes[c]->get_row(y) + x - r - 1;
+                    kernels.difference(output.get_row(c, y) + x, hi, lo, divisor, w);
+                }
+                fill_row(output.get_row(3, y) + x, 1.0f, w);
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_sat_box(const CpuImage& input, unsigned int radius_x, unsigned int radius_y)
+    {
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+        unsigned int      border    = std::max(radius_x, radius_y) + 1;
+        float             divisor   = (float)((2 * radius_x + 1) * (2 * radius_y + 1));
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return CpuImage(size);
+        }
+
+        Plane red(size, border), green(size, border), blue(size, border);
+        Plane* planes[3] = {&red, &green, &blue};
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                planes[c]->copy(input, c, first, count);
+            }
+        });
+        for (unsigned int c = 0; c < 3; c++)
+        {
+            planes[c]->extend(size);
+        }
+
+        CpuImage output(size);
+        scheduler.run(size, border, 2, [&] (const Tile& tile) {
+            int x = (int)tile.origin[0];
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    const float* top    = planes[c]->get_row((int)y - (int)radius_y - 1) + x - (int)radius_x - 1;
+                    const float* bottom = planes[c]->get_row((int)y + (int)radius_y) + x - (int)radius_x - 1;
+                    kernels.rectangle(output.get_row(c, y) + x, top, bottom, 2 * radius_x + 1, divisor, tile.size[0]);
+                }
+                fill_row(output.get_row(3, y) + x, 1.0f, tile.size[0]);
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_gauss(const CpuImage& input, unsigned int kernel_size, float sigma, bool vertical)
+    {
+        if (kernel_size == 0)
+        {
+            throw std::invalid_argument("The kernel size of a gaussian must be at least 1.");
+        }
+
+        // as gauss.vert computes them
+        std::vector<float> kernel(kernel_size);
+        float sum = 0.0f;
+        for (unsigned int x = 0; x < kernel_size; x++)
+        {
+            kernel[x] = std::exp(-0.5f * std::pow(x / sigma, 2.0f));
+            sum += x == 0 ? kernel[x] : 2.0f * kernel[x];
+        }
+        for (unsigned int x = 0; x < kernel_size; x++)
+        {
+            kernel[x] /= sum;
+        }
+
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+        int               k         = (int)kernel_size;
+
+        Plane red(size, kernel_size - 1), green(size, kernel_size - 1), blue(size, kernel_size - 1);
+        Plane* planes[3] = {&red, &green, &blue};
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                planes[c]->copy(input, c, first, count);
+            }
+        });
+
+        // one channel after the other, reading one plane and writing another
+        CpuImage output(size);
+        scheduler.run(size, kernel_size - 1, 2, [&] (const Tile& tile) {
+            unsigned int x = tile.origin[0];
+            unsigned int w = tile.size[0];
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+                {
+                    float* out = output.get_row(c, y) + x;
+                    fill_row(out, 0.0f, w);
+                    for (int i = 1 - k; i < k; i++)
+                    {
+                        const float* src = vertical ? planes[c]->get_row((int)y + i) + x : planes[c]->get_row(y) + x + i;
+                        kernels.accumulate(out, src, kernel[std::abs(i)], w);
+                    }
+                }
+            }
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                fill_row(output.get_row(3, y) + x, 1.0f, w);
+            }
+        });
+        return output;
+    }
+
+    CpuImage cpu_lingauss(const CpuImage& input, unsigned int radius)
+    {
+        if (radius == 0)
+        {
+            throw std::invalid_argument("The radius of lingauss must be at least 1.");
+        }
+
+        // the weights as lingauss.frag computes them, by offset
+        int                r    = (int)radius;
+        size_t             side = 2 * radius + 1;
+        std::vector<float> weights(side * side);
+        for (int i = -r; i <= r; i++)
+        {
+            for (int j = -r; j <= r; j++)
+            {
+                float length = std::sqrt((float)(i * i) + (float)(j * j));
+                weights[(i + r) * side + j + r] = ((float)r - length) / (float)r;
+            }
+        }
+
+        const CpuKernels& kernels   = get_cpu_kernels();
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        rgm::uvec2        size      = input.get_size();
+
+        Plane red(size, radius), green(size, radius), blue(size, radius);
+        Plane* planes[3] = {&red, &green, &blue};
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                planes[c]->copy(input, c, first, count);
+            }
+        });
+
+        CpuImage output(size);
+        scheduler.run(size, radius, 2, [&] (const Tile& tile) {
+            unsigned int x = tile.origin[0];
+            unsigned int w = tile.size[0];
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+                {
+                    float* out = output.get_row(c, y) + x;
+                    fill_row(out, 0.0f, w);
+                    for (int i = -r; i <= r; i++)
+                    {
+                        for (int j = -r; j <= r; j++)
+                        {
+                            kernels.accumulate(out, planes[c]->get_row((int)y + j) + x + i, weights[(i + r) * side + j + r], w);
+                        }
+                    }
+                }
+            }
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                kernels.normalize(output.get_row(0, y) + x, output.get_row(1, y) + x, output.get_row(2, y) + x, w);
+                fill_row(output.get_row(3, y) + x, 1.0f, w);
+            }
+        });
+        return output;
+    }
+}
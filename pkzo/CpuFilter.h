@@ -0,0 +1,78 @@
+
+#ifndef _PKZO_CPU_FILTER_H_
+#define _PKZO_CPU_FILTER_H_
+
+#include "config.h"
+#include "CpuImage.h"
+#include "TileScheduler.h"
+
+namespace pkzo
+{
+    enum SimdLevel
+    {
+        SCALAR,
+        SSE4,
+        AVX
+    };
+
+    // the best instruction set the processor and OS support
+    PKZO_EXPORT SimdLevel get_supported_simd();
+
+    // Limit the CPU filters to an instruction set, e.g. to compare them;
+    // more than the supported one is not used. By default the best is. It
+    // may change while a filter runs, the sets give the same result.
+    PKZO_EXPORT void set_simd_level(SimdLevel value);
+
+    PKZO_EXPORT SimdLevel get_simd_level();
+
+    PKZO_EXPORT const char* get_simd_name(SimdLevel level);
+
+    // The CPU filters run in tiles on all threads of one TileScheduler;
+    // set_cpu_threads gives it that many threads, 0 (the default) is one per
+    // hardware thread. Not to be changed while a filter runs, and the first
+    // call of get_cpu_scheduler, which creates it, must not race another.
+    PKZO_EXPORT void set_cpu_threads(unsigned int value);
+
+    PKZO_EXPORT unsigned int get_cpu_threads();
+
+    PKZO_EXPORT TileScheduler& get_cpu_scheduler();
+
+    // The bundled shaders on the CPU, for machines without a GPU. They
+    // compute the same as the shaders, in floats and in the same order, so
+    // that results differ from the GPU's only by how its driver rounds;
+    // after quantizing to 8 bit that is at most 1. Pixels outside the image
+    // read as 0, as texelFetch does in Mesa and on most drivers. As each
+    // pixel is computed the same way in any tile, the result does not
+    // depend on the number of threads.
+
+    // pass.frag
+    PKZO_EXPORT CpuImage cpu_pass(const CpuImage& input);
+
+    // sobel.frag
+    PKZO_EXPORT CpuImage cpu_sobel(const CpuImage& input);
+
+    // faichen.frag
+    PKZO_EXPORT CpuImage cpu_faichen(const CpuImage& input);
+
+    // gauss.vert and gauss.frag along x, or along y if vertical
+    PKZO_EXPORT CpuImage cpu_gauss(const CpuImage& input, unsigned int kernel_size, float sigma, bool vertical = false);
+
+    // lingauss.frag
+    PKZO_EXPORT CpuImage cpu_lingauss(const CpuImage& input, unsigned int radius);
+
+    // scan.frag, prefix sums along x or y restarting every chunk pixels;
+    // a chunk of 0 sums whole rows or columns
+    PKZO_EXPORT CpuImage cpu_scan(const CpuImage& input, unsigned int chunk, bool vertical = false);
+
+    // carry.frag, completes the prefix sums of cpu_scan
+    PKZO_EXPORT CpuImage cpu_carry(const CpuImage& input, unsigned int chunk, bool vertical = false);
+
+    // box.frag, the average of 2 * radius + 1 pixels from prefix sums
+    PKZO_EXPORT CpuImage cpu_box(const CpuImage& input, unsigned int radius, bool vertical = false);
+
+    // satbox.frag, the average of a rectangle from a summed-area table, i.e.
+    // prefix sums along x and then y
+    PKZO_EXPORT CpuImage cpu_sat_box(const CpuImage& input, unsigned int radius_x, unsigned int radius_y);
+}
+
+#endif
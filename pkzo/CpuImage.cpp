@@ -0,0 +1,204 @@
+
+#include "CpuImage.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "compose.h"
+#include "CpuKernels.h"
+#include "CpuFilter.h"
+
+namespace pkzo
+{
+    // floats in a 64 byte cache line, also a multiple of what AVX loads
+    const size_t cpu_alignment = 16;
+
+    CpuImage::CpuImage()
+    : size(0, 0), stride(0), offset(0) {}
+
+    CpuImage::CpuImage(rgm::uvec2 s)
+    : size(s), stride((s[0] + cpu_alignment - 1) / cpu_alignment * cpu_alignment), offset(0)
+    {
+        data.resize(4 * stride * size[1] + cpu_alignment);
+        size_t misalign = (reinterpret_cast<size_t>(&data[0]) / sizeof(float)) % cpu_alignment;
+        offset = (cpu_alignment - misalign) % cpu_alignment;
+    }
+
+    CpuImage::CpuImage(const PixelView& view)
+    : CpuImage(view.size)
+    {
+        size_t pixel = get_pixel_size(view.format);
+        get_cpu_scheduler().run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int y = first; y < first + count; y++)
+            {
+                const unsigned char* src = view.data + y * view.stride;
+                float* r = get_row(0, y);
+                float* g = get_row(1, y);
+                float* b = get_row(2, y);
+                float* a = get_row(3, y);
+                for (unsigned int x = 0; x < size[0]; x++)
+                {
+                    float rgba[4];
+                    decode_pixel(src + x * pixel, view.format, rgba);
+                    r[x] = rgba[0];
+                    g[x] = rgba[1];
+                    b[x] = rgba[2];
+                    a[x] = rgba[3];
+                }
+            }
+        });
+    }
+
+    CpuImage::CpuImage(CpuImage&& other)
+    : size(other.size), stride(other.stride), data(std::move(other.data)), offset(other.offset)
+    {
+        other.size   = rgm::uvec2(0, 0);
+        other.stride = 0;
+        other.offset = 0;
+    }
+
+    CpuImage::~CpuImage() {}
+
+    const CpuImage& CpuImage::operator = (CpuImage&& other)
+    {
+        if (this != &other)
+        {
+            size   = other.size;
+            stride = other.stride;
+            data   = std::move(other.data);
+            offset = other.offset;
+
+            other.size   = rgm::uvec2(0, 0);
+            other.stride = 0;
+            other.offset = 0;
+        }
+        return *this;
+    }
+
+    rgm::uvec2 CpuImage::get_size() const
+    {
+        return size;
+    }
+
+    size_t CpuImage::get_stride() const
+    {
+        return stride;
+    }
+
+    float* CpuImage::get_row(unsigned int channel, unsigned int y)
+    {
+        return &data[offset + (channel * size[1] + y) * stride];
+    }
+
+    const float* CpuImage::get_row(unsigned int channel, unsigned int y) const
+    {
+        return &data[offset + (channel * size[1] + y) * stride];
+    }
+
+    // clamped to 0..1 and rounded to one of levels + 1 steps, NaN is 0
+    float unorm(float value, float levels)
+    {
+        value = value > 0.0f ? value : 0.0f;
+        value = value < 1.0f ? value : 1.0f;
+        return std::floor(value * levels + 0.5f);
+    }
+
+    void CpuImage::quantize(ColorFormat format)
+    {
+        float levels = 0.0f;
+        switch (format)
+        {
+            case RGB: case RGBA: case R8: case RG8:
+                levels = 255.0f;
+                break;
+            case RGB16: case RGBA16: case R16: case RG16:
+                levels = 65535.0f;
+                break;
+            case RGBA16F:
+                break;
+            case R32F: case RGBA32F:
+                return;
+            default:
+                throw std::invalid_argument(compose("Can not quantize to format %0.", format));
+        }
+
+        const CpuKernels& kernels = get_cpu_kernels();
+        get_cpu_scheduler().run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                for (unsigned int y = first; y < first + count; y++)
+                {
+                    float* row = get_row(c, y);
+                    if (levels != 0.0f)
+                    {
+                        kernels.quantize(row, levels, size[0]);
+                        continue;
+                    }
+                    for (unsigned int x = 0; x < size[0]; x++)
+                    {
+                        row[x] = half_to_float(float_to_half(row[x]));
+                    }
+                }
+            }
+        });
+    }
+
+    void CpuImage::store(unsigned char* pixels, size_t pstride, ColorFormat format, unsigned int y0, unsigned int count) const
+    {
+        if (y0 + count > size[1])
+        {
+            throw std::out_of_range("Rows out of the image.");
+        }
+
+        size_t channels = get_channel_count(format);
+        size_t pixel    = get_pixel_size(format);
+        size_t sample   = pixel / channels;
+        bool   floats   = format == R32F || format == RGBA16F || format == RGBA32F;
+        float  levels   = sample == 1 ? 255.0f : 65535.0f;
+
+        get_cpu_scheduler().run_rows(count, [&] (unsigned int first, unsigned int n) {
+            for (unsigned int y = first; y < first + n; y++)
+            {
+                unsigned char* dst = pixels + y * pstride;
+                for (size_t c = 0; c < channels; c++)
+                {
+                    const float* row = get_row((unsigned int)c, y0 + y);
+                    for (unsigned int x = 0; x < size[0]; x++)
+                    {
+                        unsigned char* s = dst + x * pixel + c * sample;
+                        if (!floats && sample == 1)
+                        {
+                            *s = (unsigned char)unorm(row[x], levels);
+                        }
+                        else if (!floats)
+                        {
+                            unsigned short v = (unsigned short)unorm(row[x], levels);
+                            memcpy(s, &v, sizeof(v));
+                        }
+                        else if (sample == 2)
+                        {
+                            unsigned short h = float_to_half(row[x]);
+                            memcpy(s, &h, sizeof(h));
+                        }
+                        else
+                        {
+                            memcpy(s, &row[x], sizeof(float));
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    Texture CpuImage::to_texture(ColorFormat format) const
+    {
+        size_t                     pixel = get_pixel_size(format);
+        std::vector<unsigned char> pixels(size[0] * size[1] * pixel);
+        if (!pixels.empty())
+        {
+            store(&pixels[0], size[0] * pixel, format, 0, size[1]);
+        }
+        return Texture(size, format, std::move(pixels));
+    }
+}
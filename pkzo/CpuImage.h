@@ -0,0 +1,68 @@
+
+#ifndef _PKZO_CPU_IMAGE_H_
+#define _PKZO_CPU_IMAGE_H_
+
+#include <vector>
+#include <rgm/rgm.h>
+
+#include "config.h"
+#include "Texture.h"
+
+namespace pkzo
+{
+    // An image in main memory for the CPU filters, see CpuFilter.h. The
+    // pixels are floats like in a shader, one plane per channel (R, G, B,
+    // A), so that the filters can work on a whole row of one channel with
+    // SIMD instructions. Rows are padded to a multiple of 64 bytes and
+    // aligned to 64 bytes, so that tiles of whole cache lines can be
+    // written from different threads (see TileScheduler).
+    class PKZO_EXPORT CpuImage
+    {
+    public:
+
+        CpuImage();
+
+        // the pixels are undefined
+        CpuImage(rgm::uvec2 size);
+
+        // Convert the pixels, sampled like a texture of that format.
+        CpuImage(const PixelView& view);
+
+        CpuImage(CpuImage&& other);
+
+        ~CpuImage();
+
+        const CpuImage& operator = (CpuImage&& other);
+
+        rgm::uvec2 get_size() const;
+
+        // floats from one row to the next
+        size_t get_stride() const;
+
+        float* get_row(unsigned int channel, unsigned int y);
+
+        const float* get_row(unsigned int channel, unsigned int y) const;
+
+        // Round to what format can hold and clamp 8 and 16 bit formats to
+        // 0..1, as when rendering to a frame buffer of that format.
+        void quantize(ColorFormat format);
+
+        // Write count rows from y on into pixels, stride bytes apart. Like a
+        // readback, one and two channel formats take red and green.
+        void store(unsigned char* pixels, size_t stride, ColorFormat format, unsigned int y, unsigned int count) const;
+
+        Texture to_texture(ColorFormat format) const;
+
+    private:
+        rgm::uvec2         size;
+        size_t             stride;
+        std::vector<float> data;
+        // index of the first float of the image in data, for the alignment
+        size_t             offset;
+
+        CpuImage(const CpuImage&) = delete;
+        const CpuImage& operator = (const CpuImage&) = delete;
+    };
+}
+
+#endif
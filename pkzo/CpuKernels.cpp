@@ -0,0 +1,290 @@
+
+#include "CpuKernels.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace pkzo
+{
+    const float sqrt2 = std::sqrt(2.0f);
+    const float fc_a  = 1.0f / (2.0f * sqrt2);
+    const float fc_b  = 1.0f / 2.0f;
+    const float fc_c  = 1.0f / 6.0f;
+    const float fc_d  = 1.0f / 3.0f;
+
+    const float faichen_masks[9][3][3] = {
+        {{fc_a, fc_a * sqrt2, fc_a}, {0.0f, 0.0f, 0.0f}, {-fc_a, -fc_a * sqrt2, -fc_a}},
+        {{fc_a, 0.0f, -fc_a}, {fc_a * sqrt2, 0.0f, -fc_a * sqrt2}, {fc_a, 0.0f, -fc_a}},
+        {{0.0f, -fc_a, fc_a * sqrt2}, {fc_a, 0.0f, -fc_a}, {-fc_a * sqrt2, fc_a, 0.0f}},
+        {{fc_a * sqrt2, -fc_a, 0.0f}, {-fc_a, 0.0f, fc_a}, {0.0f, fc_a, -fc_a * sqrt2}},
+        {{0.0f, fc_b, 0.0f}, {-fc_b, 0.0f, -fc_b}, {0.0f, fc_b, 0.0f}},
+        {{-fc_b, 0.0f, fc_b}, {0.0f, 0.0f, 0.0f}, {fc_b, 0.0f, -fc_b}},
+        {{fc_c, -2.0f * fc_c, fc_c}, {-2.0f * fc_c, 4.0f * fc_c, -2.0f * fc_c}, {fc_c, -2.0f * fc_c, fc_c}},
+        {{-2.0f * fc_c, fc_c, -2.0f * fc_c}, {fc_c, 4.0f * fc_c, fc_c}, {-2.0f * fc_c, fc_c, -2.0f * fc_c}},
+        {{fc_d, fc_d, fc_d}, {fc_d, fc_d, fc_d}, {fc_d, fc_d, fc_d}}
+    };
+
+    const float sobel_masks[2][3][3] = {
+        {{1.0f, 2.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, {-1.0f, -2.0f, -1.0f}},
+        {{1.0f, 0.0f, -1.0f}, {2.0f, 0.0f, -2.0f}, {1.0f, 0.0f, -1.0f}}
+    };
+
+    // dot(G[0], I[0]) + dot(G[1], I[1]) + dot(G[2], I[2]), where I[i][j] 
+    // is p[j][i], the pixel at (x + i - 1, y + j - 1)
+    float apply_mask(const float mask[3][3], const float* p[3])
+    {
+        float d0 = mask[0][0] * p[0][0] + mask[0][1] * p[1][0] + mask[0][2] * p[2][0];
+        float d1 = mask[1][0] * p[0][1] + mask[1][1] * p[1][1] + mask[1][2] * p[2][1];
+        float d2 = mask[2][0] * p[0][2] + mask[2][1] * p[1][2] + mask[2][2] * p[2][2];
+        return d0 + d1 + d2;
+    }
+
+    // as maxps and minps, NaN becomes 0
+    float saturate(float value)
+    {
+        value = value > 0.0f ? value : 0.0f;
+        return value < 1.0f ? value : 1.0f;
+    }
+
+    void scalar_accumulate(float* acc, const float* src, float weight, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            acc[x] += weight * src[x];
+        }
+    }
+
+    void scalar_intensity(float* out, const float* r, const float* g, const float* b, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = std::sqrt(r[x] * r[x] + g[x] * g[x] + b[x] * b[x]);
+        }
+    }
+
+    void scalar_sobel(float* out, const float* above, const float* row, const float* below, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            const float* p[3] = {above + x - 1, row + x - 1, below + x - 1};
+            float cnv[2];
+            for (int k = 0; k < 2; k++)
+            {
+                float dp3 = apply_mask(sobel_masks[k], p);
+                cnv[k] = dp3 * dp3;
+            }
+            out[x] = 0.5f * std::sqrt(cnv[0] * cnv[0] + cnv[1] * cnv[1]);
+        }
+    }
+
+    void scalar_faichen(float* out, const float* above, const float* row, const float* below, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            const float* p[3] = {above + x - 1, row + x - 1, below + x - 1};
+            float cnv[9];
+            for (int k = 0; k < 9; k++)
+            {
+                float dp3 = apply_mask(faichen_masks[k], p);
+                cnv[k] = dp3 * dp3;
+            }
+            float M = (cnv[0] + cnv[1]) + (cnv[2] + cnv[3]);
+            float S = (cnv[4] + cnv[5]) + (cnv[6] + cnv[7]) + (cnv[8] + M);
+            out[x] = std::sqrt(M / S);
+        }
+    }
+
+    void scalar_normalize(float* r, float* g, float* b, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            float length = std::sqrt(r[x] * r[x] + g[x] * g[x] + b[x] * b[x]);
+            r[x] = r[x] / length;
+            g[x] = g[x] / length;
+            b[x] = b[x] / length;
+        }
+    }
+
+    void scalar_quantize(float* row, float levels, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            row[x] = std::floor(saturate(row[x]) * levels + 0.5f) / levels;
+        }
+    }
+
+    void scalar_difference(float* out, const float* hi, const float* lo, float divisor, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = (hi[x] - lo[x]) / divisor;
+        }
+    }
+
+    void scalar_rectangle(float* out, const float* top, const float* bottom, size_t width, float divisor, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = ((bottom[x + width] - bottom[x]) - (top[x + width] - top[x])) / divisor;
+        }
+    }
+
+    float apply_binary(CpuOp op, float a, float b)
+    {
+        switch (op)
+        {
+            case OP_ADD:
+                return a + b;
+            case OP_SUBTRACT:
+                return a - b;
+            case OP_MULTIPLY:
+                return a * b;
+            case OP_DIVIDE:
+                return a / b;
+            case OP_MIN:
+                return a < b ? a : b;
+            case OP_MAX:
+                return a > b ? a : b;
+            case OP_MOD:
+                return a - b * std::floor(a / b);
+            case OP_POW:
+                return std::pow(a, b);
+            case OP_ATAN2:
+                return std::atan2(a, b);
+            case OP_LESS:
+                return a < b ? 1.0f : 0.0f;
+            case OP_LESS_EQUAL:
+                return a <= b ? 1.0f : 0.0f;
+            case OP_EQUAL:
+                return a == b ? 1.0f : 0.0f;
+            case OP_NOT_EQUAL:
+                return a != b ? 1.0f : 0.0f;
+            default:
+                throw std::invalid_argument("Not a binary operation.");
+        }
+    }
+
+    float apply_unary(CpuOp op, float a)
+    {
+        switch (op)
+        {
+            case OP_NEGATE:
+                return -a;
+            case OP_ABS:
+                return std::fabs(a);
+            case OP_SIGN:
+                return a > 0.0f ? 1.0f : (a < 0.0f ? -1.0f : 0.0f);
+            case OP_FLOOR:
+                return std::floor(a);
+            case OP_CEIL:
+                return std::ceil(a);
+            case OP_TRUNC:
+                return std::trunc(a);
+            case OP_ROUND:
+                return std::round(a);
+            case OP_FRACT:
+                return a - std::floor(a);
+            case OP_SQRT:
+                return std::sqrt(a);
+            case OP_INVERSE_SQRT:
+                return 1.0f / std::sqrt(a);
+            case OP_EXP:
+                return std::exp(a);
+            case OP_LOG:
+                return std::log(a);
+            case OP_EXP2:
+                return std::exp2(a);
+            case OP_LOG2:
+                return std::log2(a);
+            case OP_SIN:
+                return std::sin(a);
+            case OP_COS:
+                return std::cos(a);
+            case OP_TAN:
+                return std::tan(a);
+            case OP_ASIN:
+                return std::asin(a);
+            case OP_ACOS:
+                return std::acos(a);
+            case OP_ATAN:
+                return std::atan(a);
+            default:
+                throw std::invalid_argument("Not a unary operation.");
+        }
+    }
+
+    void scalar_binary(float* out, const float* a, const float* b, CpuOp op, size_t count)
+    {
+        switch (op)
+        {
+            case OP_ADD:
+                for (size_t x = 0; x < count; x++)
+                {
+                    out[x] = a[x] + b[x];
+                }
+                break;
+            case OP_SUBTRACT:
+                for (size_t x = 0; x < count; x++)
+                {
+                    out[x] = a[x] - b[x];
+                }
+                break;
+            case OP_MULTIPLY:
+                for (size_t x = 0; x < count; x++)
+                {
+                    out[x] = a[x] * b[x];
+                }
+                break;
+            default:
+                for (size_t x = 0; x < count; x++)
+                {
+                    out[x] = apply_binary(op, a[x], b[x]);
+                }
+                break;
+        }
+    }
+
+    void scalar_unary(float* out, const float* a, CpuOp op, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = apply_unary(op, a[x]);
+        }
+    }
+
+    void scalar_multiply_add(float* out, const float* a, const float* b, const float* c, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = c[x] + a[x] * b[x];
+        }
+    }
+
+    void scalar_select(float* out, const float* condition, const float* a, const float* b, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            out[x] = condition[x] != 0.0f ? a[x] : b[x];
+        }
+    }
+
+    const CpuKernels& get_scalar_kernels()
+    {
+        static const CpuKernels kernels = {
+            "scalar",
+            scalar_accumulate,
+            scalar_intensity,
+            scalar_sobel,
+            scalar_faichen,
+            scalar_normalize,
+            scalar_quantize,
+            scalar_difference,
+            scalar_rectangle,
+            scalar_binary,
+            scalar_unary,
+            scalar_multiply_add,
+            scalar_select
+        };
+        return kernels;
+    }
+}
@@ -0,0 +1,127 @@
+
+#ifndef _PKZO_CPU_KERNELS_H_
+#define _PKZO_CPU_KERNELS_H_
+
+#include <cstddef>
+
+namespace pkzo
+{
+    // The operations of a CpuProgram, on one float per pixel. Comparisons
+    // give 1 or 0 and select takes a if its condition is not 0.
+    enum CpuOp
+    {
+        // out = a op b
+        OP_ADD,
+        OP_SUBTRACT,
+        OP_MULTIPLY,
+        OP_DIVIDE,
+        OP_MIN,
+        OP_MAX,
+        OP_MOD,
+        OP_POW,
+        OP_ATAN2,
+        OP_LESS,
+        OP_LESS_EQUAL,
+        OP_EQUAL,
+        OP_NOT_EQUAL,
+        // out = op(a)
+        OP_NEGATE,
+        OP_ABS,
+        OP_SIGN,
+        OP_FLOOR,
+        OP_CEIL,
+        OP_TRUNC,
+        OP_ROUND,
+        OP_FRACT,
+        OP_SQRT,
+        OP_INVERSE_SQRT,
+        OP_EXP,
+        OP_LOG,
+        OP_EXP2,
+        OP_LOG2,
+        OP_SIN,
+        OP_COS,
+        OP_TAN,
+        OP_ASIN,
+        OP_ACOS,
+        OP_ATAN,
+        // out = c + a * b
+        OP_MULTIPLY_ADD,
+        // out = condition != 0 ? a : b
+        OP_SELECT
+    };
+
+    // The inner loops of the CPU filters, one row of one channel at a time.
+    // There is a scalar, an SSE4 and an AVX set; the SIMD sets leave the
+    // last few pixels to the scalar set. All of them do the same operations
+    // in the same order, so they give the same result to the bit.
+    //
+    // Rows passed as above, row and below are padded by at least one pixel
+    // on either side.
+    struct CpuKernels
+    {
+        const char* name;
+
+        // acc[x] += weight * src[x]
+        void (*accumulate)(float* acc, const float* src, float weight, size_t count);
+
+        // out[x] = length(vec3(r[x], g[x], b[x]))
+        void (*intensity)(float* out, const float* r, const float* g, const float* b, size_t count);
+
+        // sobel.frag on intensities
+        void (*sobel)(float* out, const float* above, const float* row, const float* below, size_t count);
+
+        // faichen.frag on intensities
+        void (*faichen)(float* out, const float* above, const float* row, const float* below, size_t count);
+
+        // (r, g, b)[x] = normalize(vec3(r[x], g[x], b[x]))
+        void (*normalize)(float* r, float* g, float* b, size_t count);
+
+        // row[x] = round(clamp(row[x], 0, 1) * levels) / levels
+        void (*quantize)(float* row, float levels, size_t count);
+
+        // out[x] = (hi[x] - lo[x]) / divisor, box.frag on prefix sums
+        void (*difference)(float* out, const float* hi, const float* lo, float divisor, size_t count);
+
+        // out[x] = ((bottom[x + width] - bottom[x]) - (top[x + width] - top[x])) / divisor,
+        // satbox.frag on a summed-area table
+        void (*rectangle)(float* out, const float* top, const float* bottom, size_t width, float divisor, size_t count);
+
+        // out[x] = a[x] op b[x], for the binary operations of CpuOp; the 
+        // SIMD sets leave pow and atan2 to the scalar set
+        void (*binary)(float* out, const float* a, const float* b, CpuOp op, size_t count);
+
+        // out[x] = op(a[x]), for the unary operations of CpuOp; the SIMD 
+        // sets leave round, exp, log and the trigonometry to the scalar set
+        void (*unary)(float* out, const float* a, CpuOp op, size_t count);
+
+        // out[x] = c[x] + a[x] * b[x], rounded after each step
+        void (*multiply_add)(float* out, const float* a, const float* b, const float* c, size_t count);
+
+        // out[x] = condition[x] != 0 ? a[x] : b[x]
+        void (*select)(float* out, const float* condition, const float* a, const float* b, size_t count);
+    };
+
+    // The Frei-Chen masks of faichen.frag, faichen_masks[k][i][j] is
+    // G[k][i][j] there, for the pixel at (i - 1, j - 1).
+    extern const float faichen_masks[9][3][3];
+
+    // the same for sobel.frag
+    extern const float sobel_masks[2][3][3];
+
+    // one element of binary and unary, also for folding constants
+    float apply_binary(CpuOp op, float a, float b);
+
+    float apply_unary(CpuOp op, float a);
+
+    const CpuKernels& get_scalar_kernels();
+
+    const CpuKernels& get_sse4_kernels();
+
+    const CpuKernels& get_avx_kernels();
+
+    // the set for get_simd_level(), see CpuFilter.h
+    const CpuKernels& get_cpu_kernels();
+}
+
+#endif
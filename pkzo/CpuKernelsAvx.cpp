@@ -0,0 +1,69 @@
+
+#include "CpuKernels.h"
+
+#include <immintrin.h>
+
+// Visual C++ builds this file with /arch:AVX, see pkzo.vcxproj; for GCC
+// and Clang the target is limited to the kernels, as in CpuKernelsSse4.cpp.
+// The kernels only need AVX: 8 wide float arithmetic, no AVX2 integer ops
+// and no FMA, which would round differently from the other sets.
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC target("avx")
+#endif
+
+#define SIMD(name)              avx_##name
+#define SIMD_FLOAT              __m256
+#define SIMD_WIDTH              8
+#define SIMD_LOAD(p)            _mm256_loadu_ps(p)
+#define SIMD_STORE(p, v)        _mm256_storeu_ps(p, v)
+#define SIMD_SET1(f)            _mm256_set1_ps(f)
+#define SIMD_ZERO()             _mm256_setzero_ps()
+#define SIMD_ADD(a, b)          _mm256_add_ps(a, b)
+#define SIMD_SUB(a, b)          _mm256_sub_ps(a, b)
+#define SIMD_MUL(a, b)          _mm256_mul_ps(a, b)
+#define SIMD_DIV(a, b)          _mm256_div_ps(a, b)
+#define SIMD_MIN(a, b)          _mm256_min_ps(a, b)
+#define SIMD_MAX(a, b)          _mm256_max_ps(a, b)
+#define SIMD_AND(a, b)          _mm256_and_ps(a, b)
+#define SIMD_ANDNOT(a, b)       _mm256_andnot_ps(a, b)
+#define SIMD_XOR(a, b)          _mm256_xor_ps(a, b)
+#define SIMD_SQRT(a)            _mm256_sqrt_ps(a)
+#define SIMD_FLOOR(a)           _mm256_floor_ps(a)
+#define SIMD_CEIL(a)            _mm256_ceil_ps(a)
+#define SIMD_TRUNC(a)           _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+#define SIMD_LT(a, b)           _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define SIMD_LE(a, b)           _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define SIMD_EQ(a, b)           _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+#define SIMD_NEQ(a, b)          _mm256_cmp_ps(a, b, _CMP_NEQ_UQ)
+#define SIMD_GT(a, b)           _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define SIMD_BLENDV(a, b, m)    _mm256_blendv_ps(a, b, m)
+
+#include "CpuKernelsSimd.h"
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+
+namespace pkzo
+{
+    const CpuKernels& get_avx_kernels()
+    {
+        static const CpuKernels kernels = {
+            "AVX",
+            avx_accumulate,
+            avx_intensity,
+            avx_sobel,
+            avx_faichen,
+            avx_normalize,
+            avx_quantize,
+            avx_difference,
+            avx_rectangle,
+            avx_binary,
+            avx_unary,
+            avx_multiply_add,
+            avx_select
+        };
+        return kernels;
+    }
+}
@@ -0,0 +1,259 @@
+
+// The SIMD kernels, written once for any vector width. This is not a
+// header for the rest of pkzo: CpuKernelsSse4.cpp and CpuKernelsAvx.cpp
+// each define the vector type and operations below and include it inside
+// their target region, which makes the sse4_ and avx_ kernels. Hence no
+// include guard.
+//
+//   SIMD(name)                       the kernel's name, e.g. sse4_##name
+//   SIMD_FLOAT, SIMD_WIDTH           the vector type and how many floats
+//   SIMD_LOAD(p), SIMD_STORE(p, v)   unaligned load and store
+//   SIMD_SET1(f), SIMD_ZERO()
+//   SIMD_ADD, SUB, MUL, DIV, MIN, MAX, AND, ANDNOT, XOR (a, b)
+//   SIMD_SQRT, FLOOR, CEIL, TRUNC (a)
+//   SIMD_LT, LE, EQ, NEQ, GT (a, b)  all bits set where true
+//   SIMD_BLENDV(a, b, mask)          b where mask is set, otherwise a
+
+namespace pkzo
+{
+    // m[0] * c[0] + m[1] * c[1] + m[2] * c[2]
+    SIMD_FLOAT SIMD(dot)(const float m[3], const SIMD_FLOAT* c)
+    {
+        SIMD_FLOAT a = SIMD_MUL(SIMD_SET1(m[0]), c[0]);
+        SIMD_FLOAT b = SIMD_MUL(SIMD_SET1(m[1]), c[1]);
+        SIMD_FLOAT d = SIMD_MUL(SIMD_SET1(m[2]), c[2]);
+        return SIMD_ADD(SIMD_ADD(a, b), d);
+    }
+
+    // I[3 * i + j] is the pixel at (x + i - 1, y + j - 1)
+    SIMD_FLOAT SIMD(mask)(const float mask[3][3], const SIMD_FLOAT* I)
+    {
+        return SIMD_ADD(SIMD_ADD(SIMD(dot)(mask[0], I), SIMD(dot)(mask[1], I + 3)), SIMD(dot)(mask[2], I + 6));
+    }
+
+    void SIMD(neighborhood)(SIMD_FLOAT* I, const float* above, const float* row, const float* below, size_t x)
+    {
+        const float* rows[3] = {above + x - 1, row + x - 1, below + x - 1};
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                I[3 * i + j] = SIMD_LOAD(rows[j] + i);
+            }
+        }
+    }
+
+    SIMD_FLOAT SIMD(length)(const float* r, const float* g, const float* b)
+    {
+        SIMD_FLOAT vr = SIMD_LOAD(r);
+        SIMD_FLOAT vg = SIMD_LOAD(g);
+        SIMD_FLOAT vb = SIMD_LOAD(b);
+        SIMD_FLOAT ss = SIMD_ADD(SIMD_ADD(SIMD_MUL(vr, vr), SIMD_MUL(vg, vg)), SIMD_MUL(vb, vb));
+        return SIMD_SQRT(ss);
+    }
+
+    void SIMD(accumulate)(float* acc, const float* src, float weight, size_t count)
+    {
+        SIMD_FLOAT w = SIMD_SET1(weight);
+        size_t     x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_STORE(acc + x, SIMD_ADD(SIMD_LOAD(acc + x), SIMD_MUL(w, SIMD_LOAD(src + x))));
+        }
+        get_scalar_kernels().accumulate(acc + x, src + x, weight, count - x);
+    }
+
+    void SIMD(intensity)(float* out, const float* r, const float* g, const float* b, size_t count)
+    {
+        size_t x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_STORE(out + x, SIMD(length)(r + x, g + x, b + x));
+        }
+        get_scalar_kernels().intensity(out + x, r + x, g + x, b + x, count - x);
+    }
+
+    void SIMD(sobel)(float* out, const float* above, const float* row, const float* below, size_t count)
+    {
+        size_t x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT I[9];
+            SIMD(neighborhood)(I, above, row, below, x);
+
+            SIMD_FLOAT d0 = SIMD(mask)(sobel_masks[0], I);
+            SIMD_FLOAT d1 = SIMD(mask)(sobel_masks[1], I);
+            SIMD_FLOAT c0 = SIMD_MUL(d0, d0);
+            SIMD_FLOAT c1 = SIMD_MUL(d1, d1);
+            SIMD_FLOAT v  = SIMD_SQRT(SIMD_ADD(SIMD_MUL(c0, c0), SIMD_MUL(c1, c1)));
+            SIMD_STORE(out + x, SIMD_MUL(SIMD_SET1(0.5f), v));
+        }
+        get_scalar_kernels().sobel(out + x, above + x, row + x, below + x, count - x);
+    }
+
+    void SIMD(faichen)(float* out, const float* above, const float* row, const float* below, size_t count)
+    {
+        size_t x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT I[9];
+            SIMD(neighborhood)(I, above, row, below, x);
+
+            SIMD_FLOAT c[9];
+            for (int k = 0; k < 9; k++)
+            {
+                SIMD_FLOAT d = SIMD(mask)(faichen_masks[k], I);
+                c[k] = SIMD_MUL(d, d);
+            }
+
+            SIMD_FLOAT M = SIMD_ADD(SIMD_ADD(c[0], c[1]), SIMD_ADD(c[2], c[3]));
+            SIMD_FLOAT S = SIMD_ADD(SIMD_ADD(SIMD_ADD(c[4], c[5]), SIMD_ADD(c[6], c[7])), SIMD_ADD(c[8], M));
+            SIMD_STORE(out + x, SIMD_SQRT(SIMD_DIV(M, S)));
+        }
+        get_scalar_kernels().faichen(out + x, above + x, row + x, below + x, count - x);
+    }
+
+    void SIMD(normalize)(float* r, float* g, float* b, size_t count)
+    {
+        size_t x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT length = SIMD(length)(r + x, g + x, b + x);
+            SIMD_STORE(r + x, SIMD_DIV(SIMD_LOAD(r + x), length));
+            SIMD_STORE(g + x, SIMD_DIV(SIMD_LOAD(g + x), length));
+            SIMD_STORE(b + x, SIMD_DIV(SIMD_LOAD(b + x), length));
+        }
+        get_scalar_kernels().normalize(r + x, g + x, b + x, count - x);
+    }
+
+    void SIMD(quantize)(float* row, float levels, size_t count)
+    {
+        SIMD_FLOAT l    = SIMD_SET1(levels);
+        SIMD_FLOAT half = SIMD_SET1(0.5f);
+        size_t     x    = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT v = SIMD_MIN(SIMD_MAX(SIMD_LOAD(row + x), SIMD_ZERO()), SIMD_SET1(1.0f));
+            v = SIMD_FLOOR(SIMD_ADD(SIMD_MUL(v, l), half));
+            SIMD_STORE(row + x, SIMD_DIV(v, l));
+        }
+        get_scalar_kernels().quantize(row + x, levels, count - x);
+    }
+
+    void SIMD(difference)(float* out, const float* hi, const float* lo, float divisor, size_t count)
+    {
+        SIMD_FLOAT d = SIMD_SET1(divisor);
+        size_t     x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_STORE(out + x, SIMD_DIV(SIMD_SUB(SIMD_LOAD(hi + x), SIMD_LOAD(lo + x)), d));
+        }
+        get_scalar_kernels().difference(out + x, hi + x, lo + x, divisor, count - x);
+    }
+
+    void SIMD(rectangle)(float* out, const float* top, const float* bottom, size_t width, float divisor, size_t count)
+    {
+        SIMD_FLOAT d = SIMD_SET1(divisor);
+        size_t     x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT b = SIMD_SUB(SIMD_LOAD(bottom + x + width), SIMD_LOAD(bottom + x));
+            SIMD_FLOAT t = SIMD_SUB(SIMD_LOAD(top + x + width), SIMD_LOAD(top + x));
+            SIMD_STORE(out + x, SIMD_DIV(SIMD_SUB(b, t), d));
+        }
+        get_scalar_kernels().rectangle(out + x, top + x, bottom + x, width, divisor, count - x);
+    }
+
+    // one loop per operation, so the switch is not in the loop
+    #define SIMD_BINARY_CASE(OP, EXPR)                                  \
+        case OP:                                                        \
+            for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)            \
+            {                                                           \
+                SIMD_FLOAT va = SIMD_LOAD(a + x);                       \
+                SIMD_FLOAT vb = SIMD_LOAD(b + x);                       \
+                SIMD_STORE(out + x, EXPR);                              \
+            }                                                           \
+            break;
+
+    void SIMD(binary)(float* out, const float* a, const float* b, CpuOp op, size_t count)
+    {
+        SIMD_FLOAT one = SIMD_SET1(1.0f);
+        size_t     x   = 0;
+        switch (op)
+        {
+            SIMD_BINARY_CASE(OP_ADD,        SIMD_ADD(va, vb))
+            SIMD_BINARY_CASE(OP_SUBTRACT,   SIMD_SUB(va, vb))
+            SIMD_BINARY_CASE(OP_MULTIPLY,   SIMD_MUL(va, vb))
+            SIMD_BINARY_CASE(OP_DIVIDE,     SIMD_DIV(va, vb))
+            SIMD_BINARY_CASE(OP_MIN,        SIMD_MIN(va, vb))
+            SIMD_BINARY_CASE(OP_MAX,        SIMD_MAX(va, vb))
+            SIMD_BINARY_CASE(OP_MOD,        SIMD_SUB(va, SIMD_MUL(vb, SIMD_FLOOR(SIMD_DIV(va, vb)))))
+            SIMD_BINARY_CASE(OP_LESS,       SIMD_AND(SIMD_LT(va, vb), one))
+            SIMD_BINARY_CASE(OP_LESS_EQUAL, SIMD_AND(SIMD_LE(va, vb), one))
+            SIMD_BINARY_CASE(OP_EQUAL,      SIMD_AND(SIMD_EQ(va, vb), one))
+            SIMD_BINARY_CASE(OP_NOT_EQUAL,  SIMD_AND(SIMD_NEQ(va, vb), one))
+            default:
+                break;
+        }
+        get_scalar_kernels().binary(out + x, a + x, b + x, op, count - x);
+    }
+
+    #undef SIMD_BINARY_CASE
+
+    #define SIMD_UNARY_CASE(OP, EXPR)                                   \
+        case OP:                                                        \
+            for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)            \
+            {                                                           \
+                SIMD_FLOAT va = SIMD_LOAD(a + x);                       \
+                SIMD_STORE(out + x, EXPR);                              \
+            }                                                           \
+            break;
+
+    void SIMD(unary)(float* out, const float* a, CpuOp op, size_t count)
+    {
+        SIMD_FLOAT one  = SIMD_SET1(1.0f);
+        SIMD_FLOAT zero = SIMD_ZERO();
+        SIMD_FLOAT sign = SIMD_SET1(-0.0f);
+        size_t     x    = 0;
+        switch (op)
+        {
+            SIMD_UNARY_CASE(OP_NEGATE,       SIMD_XOR(va, sign))
+            SIMD_UNARY_CASE(OP_ABS,          SIMD_ANDNOT(sign, va))
+            SIMD_UNARY_CASE(OP_SIGN,         SIMD_SUB(SIMD_AND(SIMD_GT(va, zero), one), SIMD_AND(SIMD_LT(va, zero), one)))
+            SIMD_UNARY_CASE(OP_FLOOR,        SIMD_FLOOR(va))
+            SIMD_UNARY_CASE(OP_CEIL,         SIMD_CEIL(va))
+            SIMD_UNARY_CASE(OP_TRUNC,        SIMD_TRUNC(va))
+            SIMD_UNARY_CASE(OP_FRACT,        SIMD_SUB(va, SIMD_FLOOR(va)))
+            SIMD_UNARY_CASE(OP_SQRT,         SIMD_SQRT(va))
+            SIMD_UNARY_CASE(OP_INVERSE_SQRT, SIMD_DIV(one, SIMD_SQRT(va)))
+            default:
+                break;
+        }
+        get_scalar_kernels().unary(out + x, a + x, op, count - x);
+    }
+
+    #undef SIMD_UNARY_CASE
+
+    void SIMD(multiply_add)(float* out, const float* a, const float* b, const float* c, size_t count)
+    {
+        size_t x = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT product = SIMD_MUL(SIMD_LOAD(a + x), SIMD_LOAD(b + x));
+            SIMD_STORE(out + x, SIMD_ADD(SIMD_LOAD(c + x), product));
+        }
+        get_scalar_kernels().multiply_add(out + x, a + x, b + x, c + x, count - x);
+    }
+
+    void SIMD(select)(float* out, const float* condition, const float* a, const float* b, size_t count)
+    {
+        SIMD_FLOAT zero = SIMD_ZERO();
+        size_t     x    = 0;
+        for (; x + SIMD_WIDTH <= count; x += SIMD_WIDTH)
+        {
+            SIMD_FLOAT mask = SIMD_NEQ(SIMD_LOAD(condition + x), zero);
+            SIMD_STORE(out + x, SIMD_BLENDV(SIMD_LOAD(b + x), SIMD_LOAD(a + x), mask));
+        }
+        get_scalar_kernels().select(out + x, condition + x, a + x, b + x, count - x);
+    }
+}
@@ -0,0 +1,67 @@
+
+#include "CpuKernels.h"
+
+#include <smmintrin.h>
+
+// GCC and Clang only emit SSE4 for functions that ask for it; the rest of
+// pkzo must run on any x86.
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#define SIMD(name)              sse4_##name
+#define SIMD_FLOAT              __m128
+#define SIMD_WIDTH              4
+#define SIMD_LOAD(p)            _mm_loadu_ps(p)
+#define SIMD_STORE(p, v)        _mm_storeu_ps(p, v)
+#define SIMD_SET1(f)            _mm_set1_ps(f)
+#define SIMD_ZERO()             _mm_setzero_ps()
+#define SIMD_ADD(a, b)          _mm_add_ps(a, b)
+#define SIMD_SUB(a, b)          _mm_sub_ps(a, b)
+#define SIMD_MUL(a, b)          _mm_mul_ps(a, b)
+#define SIMD_DIV(a, b)          _mm_div_ps(a, b)
+#define SIMD_MIN(a, b)          _mm_min_ps(a, b)
+#define SIMD_MAX(a, b)          _mm_max_ps(a, b)
+#define SIMD_AND(a, b)          _mm_and_ps(a, b)
+#define SIMD_ANDNOT(a, b)       _mm_andnot_ps(a, b)
+#define SIMD_XOR(a, b)          _mm_xor_ps(a, b)
+#define SIMD_SQRT(a)            _mm_sqrt_ps(a)
+#define SIMD_FLOOR(a)           _mm_floor_ps(a)
+#define SIMD_CEIL(a)            _mm_ceil_ps(a)
+#define SIMD_TRUNC(a)           _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+#define SIMD_LT(a, b)           _mm_cmplt_ps(a, b)
+#define SIMD_LE(a, b)           _mm_cmple_ps(a, b)
+#define SIMD_EQ(a, b)           _mm_cmpeq_ps(a, b)
+#define SIMD_NEQ(a, b)          _mm_cmpneq_ps(a, b)
+#define SIMD_GT(a, b)           _mm_cmpgt_ps(a, b)
+#define SIMD_BLENDV(a, b, m)    _mm_blendv_ps(a, b, m)
+
+#include "CpuKernelsSimd.h"
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+
+namespace pkzo
+{
+    const CpuKernels& get_sse4_kernels()
+    {
+        static const CpuKernels kernels = {
+            "SSE4",
+            sse4_accumulate,
+            sse4_intensity,
+            sse4_sobel,
+            sse4_faichen,
+            sse4_normalize,
+            sse4_quantize,
+            sse4_difference,
+            sse4_rectangle,
+            sse4_binary,
+            sse4_unary,
+            sse4_multiply_add,
+            sse4_select
+        };
+        return kernels;
+    }
+}
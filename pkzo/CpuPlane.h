@@ -0,0 +1,58 @@
+
+#ifndef _PKZO_CPU_PLANE_H_
+#define _PKZO_CPU_PLANE_H_
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <rgm/rgm.h>
+
+#include "CpuImage.h"
+
+namespace pkzo
+{
+    // One channel with a border of zeros around it, so that the kernels
+    // can read past the edges of the image without checks.
+    class Plane
+    {
+    public:
+        Plane(rgm::uvec2 s, unsigned int b)
+        : width(s[0] + 2 * b), border(b), data((size_t)width * (s[1] + 2 * b), 0.0f) {}
+
+        // y may be up to border outside the image
+        float* get_row(int y)
+        {
+            return &data[(y + border) * width + border];
+        }
+
+        void copy(const CpuImage& image, unsigned int channel, unsigned int first, unsigned int count)
+        {
+            for (unsigned int y = first; y < first + count; y++)
+            {
+                memcpy(get_row(y), image.get_row(channel, y), image.get_size()[0] * sizeof(float));
+            }
+        }
+
+        // Repeat the last column and row of the image into the border to
+        // the right and below, for prefix sums that end at the image.
+        void extend(rgm::uvec2 size)
+        {
+            for (unsigned int y = 0; y < size[1]; y++)
+            {
+                float* row = get_row(y);
+                std::fill(row + size[0], row + size[0] + border, row[size[0] - 1]);
+            }
+            for (unsigned int y = size[1]; y < size[1] + border; y++)
+            {
+                memcpy(get_row(y) - border, get_row(size[1] - 1) - border, width * sizeof(float));
+            }
+        }
+
+    private:
+        size_t             width;
+        unsigned int       border;
+        std::vector<float> data;
+    };
+}
+
+#endif
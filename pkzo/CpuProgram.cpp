@@ -0,0 +1,2518 @@
+
+#include "CpuProgram.h"
+
+#include <map>
+#include <set>
+#include <cmath>
+#include <tuple>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "compose.h"
+#include "GlslParser.h"
+#include "CpuPlane.h"
+#include "CpuFilter.h"
+
+namespace pkzo
+{
+    enum ShaderBase
+    {
+        VOID_TYPE,
+        BOOL_TYPE,
+        INT_TYPE,
+        UINT_TYPE,
+        FLOAT_TYPE,
+        SAMPLER_TYPE
+    };
+
+    struct ShaderType
+    {
+        ShaderBase   base;
+        // the components of a vector, the rows of a matrix
+        unsigned int rows;
+        unsigned int columns;
+        // -1 if not an array
+        int          array;
+
+        unsigned int get_components() const
+        {
+            return rows * columns;
+        }
+
+        size_t get_size() const
+        {
+            return get_components() * (array < 0 ? 1 : array);
+        }
+
+        bool is_scalar() const
+        {
+            return rows == 1 && columns == 1 && array < 0;
+        }
+
+        bool is_vector() const
+        {
+            return rows > 1 && columns == 1 && array < 0;
+        }
+
+        bool is_matrix() const
+        {
+            return columns > 1 && array < 0;
+        }
+
+        ShaderType get_element() const
+        {
+            ShaderType element = *this;
+            element.array = -1;
+            return element;
+        }
+    };
+
+    ShaderType make_type(ShaderBase base, unsigned int rows = 1, unsigned int columns = 1)
+    {
+        ShaderType type = {base, rows, columns, -1};
+        return type;
+    }
+
+    bool operator == (const ShaderType& a, const ShaderType& b)
+    {
+        return a.base == b.base && a.rows == b.rows && a.columns == b.columns && a.array == b.array;
+    }
+
+    bool operator != (const ShaderType& a, const ShaderType& b)
+    {
+        return !(a == b);
+    }
+
+    std::string get_type_name(const ShaderType& type)
+    {
+        std::string name;
+        const char* prefixes[] = {"", "b", "i", "u", "", ""};
+        const char* scalars[]  = {"void", "bool", "int", "uint", "float", "sampler2D"};
+        if (type.columns > 1)
+        {
+            name = type.columns == type.rows ? compose("mat%0", type.rows) : compose("mat%0x%1", type.columns, type.rows);
+        }
+        else if (type.rows > 1)
+        {
+            name = compose("%0vec%1", prefixes[type.base], type.rows);
+        }
+        else
+        {
+            name = scalars[type.base];
+        }
+        return type.array < 0 ? name : compose("%0[%1]", name, type.array);
+    }
+
+    // A component of a value while translating: a constant, a node of the
+    // program, the pixel's x or y plus an offset or something that can
+    // not be known on the CPU, e.g. a uniform.
+    struct ShaderScalar
+    {
+        enum Kind
+        {
+            CONSTANT,
+            NODE,
+            COORD,
+            UNKNOWN
+        };
+
+        Kind   kind;
+        // CONSTANT, or the offset of COORD
+        double value;
+        // the node, the axis of COORD or the reason why it is UNKNOWN
+        int    index;
+    };
+
+    ShaderScalar make_constant(double value)
+    {
+        ShaderScalar s = {ShaderScalar::CONSTANT, value, 0};
+        return s;
+    }
+
+    ShaderScalar make_node(int node)
+    {
+        ShaderScalar s = {ShaderScalar::NODE, 0.0, node};
+        return s;
+    }
+
+    ShaderScalar make_coord(int axis, double offset)
+    {
+        ShaderScalar s = {ShaderScalar::COORD, offset, axis};
+        return s;
+    }
+
+    ShaderScalar make_unknown(int reason)
+    {
+        ShaderScalar s = {ShaderScalar::UNKNOWN, 0.0, reason};
+        return s;
+    }
+
+    bool operator == (const ShaderScalar& a, const ShaderScalar& b)
+    {
+        return a.kind == b.kind && a.value == b.value && a.index == b.index;
+    }
+
+    bool operator != (const ShaderScalar& a, const ShaderScalar& b)
+    {
+        return !(a == b);
+    }
+
+    struct ShaderValue
+    {
+        ShaderType                type;
+        // column by column, element by element
+        std::vector<ShaderScalar> data;
+    };
+
+    ShaderValue make_value(const ShaderType& type, const ShaderScalar& fill = make_constant(0.0))
+    {
+        ShaderValue value;
+        value.type = type;
+        value.data.assign(type.get_size(), fill);
+        return value;
+    }
+
+    ShaderValue make_scalar(ShaderBase base, const ShaderScalar& s)
+    {
+        return make_value(make_type(base), s);
+    }
+
+    double round_float(double value)
+    {
+        return (double)(float)value;
+    }
+
+    unsigned int float_bits(float value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    int swizzle_index(char c)
+    {
+        const char* sets[] = {"xyzw", "rgba", "stpq"};
+        for (int s = 0; s < 3; s++)
+        {
+            const char* p = strchr(sets[s], c);
+            if (p != NULL && c != 0)
+            {
+                return (int)(p - sets[s]);
+            }
+        }
+        return -1;
+    }
+
+    // Runs the shader symbolically and records what is left to compute
+    // per pixel as nodes, which become the program's instructions.
+    class GlslTranslator
+    {
+    public:
+
+        GlslTranslator(CpuProgram& p)
+        : program(p), reach(0), inputs(0), line(0), iterations(0) {}
+
+        void translate(const std::string& vertex_code, const std::string& fragment_code)
+        {
+            std::map<std::string, ShaderValue> varyings;
+            if (!vertex_code.empty())
+            {
+                GlslShader vertex = parse_glsl(vertex_code);
+                run_shader(vertex, false, varyings);
+            }
+
+            GlslShader fragment = parse_glsl(fragment_code);
+            ShaderValue color = run_shader(fragment, true, varyings);
+
+            unsigned int declared = 0;
+            for (size_t i = 0; i < fragment.footprints.size(); i++)
+            {
+                declared = std::max(declared, fragment.footprints[i]);
+            }
+
+            Ref outputs[4];
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                ShaderScalar s = c < color.data.size() ? color.data[c] : make_constant(c == 3 ? 1.0 : 0.0);
+                outputs[c] = get_ref(s);
+            }
+            finish(outputs, std::max(declared, reach));
+        }
+
+    private:
+        // a node or a constant
+        struct Ref
+        {
+            int   node;
+            float value;
+        };
+
+        struct Node
+        {
+            // a texel near the pixel, not an instruction
+            bool                           load;
+            CpuProgram::Instruction::Kind  kind;
+            CpuOp                          op;
+            Ref                            a;
+            Ref                            b;
+            Ref                            c;
+            unsigned int                   plane;
+            int                            x;
+            int                            y;
+        };
+
+        typedef std::tuple<bool, int, int, int, unsigned int, int, unsigned int, int, unsigned int, unsigned int, int, int> NodeKey;
+
+        enum Flow
+        {
+            NEXT,
+            BREAK,
+            CONTINUE,
+            RETURN
+        };
+
+        struct Frame
+        {
+            std::vector<std::map<std::string, ShaderValue>> scopes;
+            ShaderType                                      type;
+            ShaderValue                                     result;
+        };
+
+        // an assignable part of a variable
+        struct Target
+        {
+            std::string         name;
+            std::vector<size_t> components;
+            ShaderType          type;
+        };
+
+        CpuProgram&                                        program;
+        std::vector<Node>                                  nodes;
+        std::map<NodeKey, int>                             node_index;
+        std::vector<std::string>                           reasons;
+        std::map<std::pair<unsigned int, unsigned int>, unsigned int> plane_index;
+        unsigned int                                       reach;
+        unsigned int                                       inputs;
+
+        bool                                               fragment;
+        std::map<std::string, std::vector<const GlslFunction*>> functions;
+        std::map<std::string, ShaderValue>                 globals;
+        std::vector<Frame>                                 frames;
+        unsigned int                                       line;
+        size_t                                             iterations;
+
+        void error(const std::string& message) const
+        {
+            throw std::runtime_error(compose("line %0: %1", line, message));
+        }
+
+        int add_reason(const std::string& reason)
+        {
+            reasons.push_back(reason);
+            return (int)reasons.size() - 1;
+        }
+
+        // Nodes
+
+        int emit(const Node& node)
+        {
+            NodeKey key(node.load, node.kind, node.op, node.a.node, float_bits(node.a.value), node.b.node, float_bits(node.b.value), node.c.node, float_bits(node.c.value), node.plane, node.x, node.y);
+            auto i = node_index.find(key);
+            if (i != node_index.end())
+            {
+                return i->second;
+            }
+
+            if (nodes.size() >= (1u << 22))
+            {
+                error("The shader is too large to unroll.");
+            }
+            nodes.push_back(node);
+            node_index[key] = (int)nodes.size() - 1;
+            return (int)nodes.size() - 1;
+        }
+
+        static Ref constant_ref(float value)
+        {
+            Ref r = {-1, value};
+            return r;
+        }
+
+        static Ref node_ref(int node)
+        {
+            Ref r = {node, 0.0f};
+            return r;
+        }
+
+        int emit(CpuProgram::Instruction::Kind kind, CpuOp op, Ref a, Ref b, Ref c, unsigned int plane = 0)
+        {
+            Node node = {false, kind, op, a, b, c, plane, 0, 0};
+            return emit(node);
+        }
+
+        int emit_operation(CpuOp op, Ref a, Ref b = constant_ref(0.0f), Ref c = constant_ref(0.0f))
+        {
+            // the same either way around
+            if ((op == OP_ADD || op == OP_MULTIPLY) && (a.node < b.node || (a.node == b.node && a.value < b.value)))
+            {
+                std::swap(a, b);
+            }
+            return emit(CpuProgram::Instruction::OPERATION, op, a, b, c);
+        }
+
+        int emit_special(CpuProgram::Instruction::Kind kind)
+        {
+            return emit(kind, OP_ADD, constant_ref(0.0f), constant_ref(0.0f), constant_ref(0.0f));
+        }
+
+        unsigned int get_plane(unsigned int input, unsigned int channel)
+        {
+            auto key = std::make_pair(input, channel);
+            auto i   = plane_index.find(key);
+            if (i != plane_index.end())
+            {
+                return i->second;
+            }
+            CpuProgram::PlaneSource source = {input, channel};
+            program.planes.push_back(source);
+            plane_index[key] = (unsigned int)program.planes.size() - 1;
+            return plane_index[key];
+        }
+
+        Ref get_ref(const ShaderScalar& s)
+        {
+            switch (s.kind)
+            {
+                case ShaderScalar::CONSTANT:
+                    return constant_ref((float)s.value);
+                case ShaderScalar::NODE:
+                    return node_ref(s.index);
+                case ShaderScalar::COORD:
+                {
+                    int base = emit_special(s.index == 0 ? CpuProgram::Instruction::COLUMN : CpuProgram::Instruction::ROW);
+                    if (s.value == 0.0)
+                    {
+                        return node_ref(base);
+                    }
+                    return node_ref(emit_operation(OP_ADD, node_ref(base), constant_ref((float)s.value)));
+                }
+                default:
+                    error(compose("The result depends on %0.", reasons[s.index]));
+                    return constant_ref(0.0f);
+            }
+        }
+
+        // Scalar operations, folded where possible
+
+        double fold(CpuOp op, double a, double b, ShaderBase base)
+        {
+            if (base == FLOAT_TYPE)
+            {
+                return apply_binary(op, (float)a, (float)b);
+            }
+
+            switch (op)
+            {
+                case OP_ADD:
+                    return a + b;
+                case OP_SUBTRACT:
+                    return a - b;
+                case OP_MULTIPLY:
+                    return a * b;
+                case OP_DIVIDE:
+                    if (b == 0.0)
+                    {
+                        error("Integer division by zero.");
+                    }
+                    return (double)((long long)a / (long long)b);
+                case OP_MOD:
+                    if (b == 0.0)
+                    {
+                        error("Integer division by zero.");
+                    }
+                    return (double)((long long)a % (long long)b);
+                case OP_MIN:
+                    return std::min(a, b);
+                case OP_MAX:
+                    return std::max(a, b);
+                case OP_LESS:
+                    return a < b ? 1.0 : 0.0;
+                case OP_LESS_EQUAL:
+                    return a <= b ? 1.0 : 0.0;
+                case OP_EQUAL:
+                    return a == b ? 1.0 : 0.0;
+                case OP_NOT_EQUAL:
+                    return a != b ? 1.0 : 0.0;
+                default:
+                    return apply_binary(op, (float)a, (float)b);
+            }
+        }
+
+        ShaderScalar binary(CpuOp op, const ShaderScalar& a, const ShaderScalar& b, ShaderBase base)
+        {
+            if (a.kind == ShaderScalar::UNKNOWN)
+            {
+                return a;
+            }
+            if (b.kind == ShaderScalar::UNKNOWN)
+            {
+                return b;
+            }
+
+            bool ca = a.kind == ShaderScalar::CONSTANT;
+            bool cb = b.kind == ShaderScalar::CONSTANT;
+            if (ca && cb)
+            {
+                return make_constant(fold(op, a.value, b.value, base));
+            }
+
+            // the pixel's coordinates stay that until used otherwise
+            if (op == OP_ADD && a.kind == ShaderScalar::COORD && cb)
+            {
+                return make_coord(a.index, a.value + b.value);
+            }
+            if (op == OP_ADD && ca && b.kind == ShaderScalar::COORD)
+            {
+                return make_coord(b.index, a.value + b.value);
+            }
+            if (op == OP_SUBTRACT && a.kind == ShaderScalar::COORD && cb)
+            {
+                return make_coord(a.index, a.value - b.value);
+            }
+            if (op == OP_SUBTRACT && a.kind == ShaderScalar::COORD && b.kind == ShaderScalar::COORD && a.index == b.index)
+            {
+                return make_constant(a.value - b.value);
+            }
+
+            if ((op == OP_ADD || op == OP_SUBTRACT) && cb && b.value == 0.0)
+            {
+                return a;
+            }
+            if (op == OP_ADD && ca && a.value == 0.0)
+            {
+                return b;
+            }
+            if ((op == OP_MULTIPLY || op == OP_DIVIDE) && cb && b.value == 1.0)
+            {
+                return a;
+            }
+            if (op == OP_MULTIPLY && ca && a.value == 1.0)
+            {
+                return b;
+            }
+            if (op == OP_MULTIPLY && ((ca && a.value == 0.0) || (cb && b.value == 0.0)))
+            {
+                return make_constant(0.0);
+            }
+
+            if (op == OP_MOD && base != FLOAT_TYPE)
+            {
+                // a - b * trunc(a / b), as the integers are floats here
+                ShaderScalar q = binary(OP_DIVIDE, a, b, base);
+                return binary(OP_SUBTRACT, a, binary(OP_MULTIPLY, b, q, base), base);
+            }
+
+            int node = emit_operation(op, get_ref(a), get_ref(b));
+            if (op == OP_DIVIDE && base != FLOAT_TYPE)
+            {
+                node = emit_operation(OP_TRUNC, node_ref(node));
+            }
+            return make_node(node);
+        }
+
+        ShaderScalar unary(CpuOp op, const ShaderScalar& a, ShaderBase base)
+        {
+            switch (a.kind)
+            {
+                case ShaderScalar::UNKNOWN:
+                    return a;
+                case ShaderScalar::CONSTANT:
+                    if (base != FLOAT_TYPE && op == OP_NEGATE)
+                    {
+                        return make_constant(-a.value);
+                    }
+                    if (base != FLOAT_TYPE && op == OP_ABS)
+                    {
+                        return make_constant(std::fabs(a.value));
+                    }
+                    return make_constant(apply_unary(op, (float)a.value));
+                default:
+                    return make_node(emit_operation(op, get_ref(a)));
+            }
+        }
+
+        ShaderScalar select(const ShaderScalar& condition, const ShaderScalar& a, const ShaderScalar& b)
+        {
+            if (condition.kind == ShaderScalar::UNKNOWN)
+            {
+                return condition;
+            }
+            if (condition.kind == ShaderScalar::CONSTANT)
+            {
+                return condition.value != 0.0 ? a : b;
+            }
+            if (a == b)
+            {
+                return a;
+            }
+            if (a.kind == ShaderScalar::UNKNOWN)
+            {
+                return a;
+            }
+            if (b.kind == ShaderScalar::UNKNOWN)
+            {
+                return b;
+            }
+            return make_node(emit_operation(OP_SELECT, get_ref(condition), get_ref(a), get_ref(b)));
+        }
+
+        ShaderScalar convert(const ShaderScalar& s, ShaderBase from, ShaderBase to)
+        {
+            if (from == to || s.kind == ShaderScalar::UNKNOWN || from == SAMPLER_TYPE || to == SAMPLER_TYPE)
+            {
+                return s;
+            }
+
+            switch (to)
+            {
+                case BOOL_TYPE:
+                    if (s.kind == ShaderScalar::CONSTANT)
+                    {
+                        return make_constant(s.value != 0.0 ? 1.0 : 0.0);
+                    }
+                    return binary(OP_NOT_EQUAL, s, make_constant(0.0), FLOAT_TYPE);
+                case INT_TYPE:
+                case UINT_TYPE:
+                    if (from != FLOAT_TYPE)
+                    {
+                        return s;
+                    }
+                    if (s.kind == ShaderScalar::CONSTANT)
+                    {
+                        return make_constant(s.value < 0.0 ? std::ceil(s.value) : std::floor(s.value));
+                    }
+                    // the pixel's coordinates are not negative
+                    if (s.kind == ShaderScalar::COORD && s.value >= 0.0)
+                    {
+                        return make_coord(s.index, std::floor(s.value));
+                    }
+                    return unary(OP_TRUNC, s, FLOAT_TYPE);
+                case FLOAT_TYPE:
+                    return s;
+                default:
+                    return s;
+            }
+        }
+
+        ShaderValue convert(const ShaderValue& value, ShaderBase base)
+        {
+            if (value.type.base == base)
+            {
+                return value;
+            }
+            if (value.type.base == SAMPLER_TYPE || base == SAMPLER_TYPE || value.type.base == VOID_TYPE)
+            {
+                error(compose("Can not convert %0.", get_type_name(value.type)));
+            }
+            ShaderValue result = value;
+            result.type.base = base;
+            for (size_t i = 0; i < result.data.size(); i++)
+            {
+                result.data[i] = convert(value.data[i], value.type.base, base);
+            }
+            return result;
+        }
+
+        // value as type, implicitly as for an initializer or an argument
+        ShaderValue convert(const ShaderValue& value, const ShaderType& type)
+        {
+            ShaderType shape = value.type;
+            shape.base = type.base;
+            if (shape != type)
+            {
+                error(compose("Can not convert %0 to %1.", get_type_name(value.type), get_type_name(type)));
+            }
+            if (value.type.base != type.base && !(type.base == FLOAT_TYPE && (value.type.base == INT_TYPE || value.type.base == UINT_TYPE)) && !(type.base == UINT_TYPE && value.type.base == INT_TYPE))
+            {
+                error(compose("Can not convert %0 to %1.", get_type_name(value.type), get_type_name(type)));
+            }
+            return convert(value, type.base);
+        }
+
+        // Types
+
+        long long evaluate_integer(const GlslExpressionPtr& expression)
+        {
+            ShaderValue value = evaluate(*expression);
+            if (!value.type.is_scalar() || value.data[0].kind != ShaderScalar::CONSTANT || (value.type.base != INT_TYPE && value.type.base != UINT_TYPE))
+            {
+                error("Expected a constant integer.");
+            }
+            return (long long)value.data[0].value;
+        }
+
+        ShaderType get_type(const std::string& name)
+        {
+            if (name == "void")
+            {
+                return make_type(VOID_TYPE, 0, 0);
+            }
+            if (name == "bool")
+            {
+                return make_type(BOOL_TYPE);
+            }
+            if (name == "int")
+            {
+                return make_type(INT_TYPE);
+            }
+            if (name == "uint")
+            {
+                return make_type(UINT_TYPE);
+            }
+            if (name == "float")
+            {
+                return make_type(FLOAT_TYPE);
+            }
+            if (name.find("sampler2D") != std::string::npos)
+            {
+                return make_type(SAMPLER_TYPE);
+            }
+
+            size_t vec = name.find("vec");
+            if (vec != std::string::npos && name.size() == vec + 4)
+            {
+                ShaderBase bases[] = {FLOAT_TYPE, BOOL_TYPE, INT_TYPE, UINT_TYPE};
+                const char* prefixes = " biu";
+                ShaderBase  base     = vec == 0 ? FLOAT_TYPE : bases[strchr(prefixes, name[0]) - prefixes];
+                return make_type(base, name[vec + 3] - '0');
+            }
+            if (name.compare(0, 3, "mat") == 0)
+            {
+                unsigned int columns = name[3] - '0';
+                unsigned int rows    = name.size() == 6 ? name[5] - '0' : columns;
+                return make_type(FLOAT_TYPE, rows, columns);
+            }
+
+            error(compose("Unknown type %0.", name));
+            return make_type(VOID_TYPE);
+        }
+
+        // An array size of 0 is unsized, to be taken from the initializer.
+        ShaderType get_type(const GlslType& type)
+        {
+            ShaderType result = get_type(type.name);
+            if (type.array)
+            {
+                result.array = type.array_size ? (int)evaluate_integer(type.array_size) : 0;
+                if (result.array < 0 || (type.array_size && result.array == 0))
+                {
+                    error("Arrays must have a positive size.");
+                }
+            }
+            return result;
+        }
+
+        // Variables
+
+        ShaderValue* find(const std::string& name)
+        {
+            if (!frames.empty())
+            {
+                std::vector<std::map<std::string, ShaderValue>>& scopes = frames.back().scopes;
+                for (size_t i = scopes.size(); i > 0; i--)
+                {
+                    auto v = scopes[i - 1].find(name);
+                    if (v != scopes[i - 1].end())
+                    {
+                        return &v->second;
+                    }
+                }
+            }
+            auto g = globals.find(name);
+            return g != globals.end() ? &g->second : NULL;
+        }
+
+        void declare(const std::string& name, const ShaderValue& value)
+        {
+            if (frames.empty())
+            {
+                globals[name] = value;
+            }
+            else
+            {
+                frames.back().scopes.back()[name] = value;
+            }
+        }
+
+        ShaderValue initialize(const GlslDeclarator& declarator)
+        {
+            ShaderType type = get_type(declarator.type);
+            if (!declarator.initializer)
+            {
+                if (type.array == 0)
+                {
+                    error(compose("%0 needs a size.", declarator.name));
+                }
+                return make_value(type);
+            }
+
+            ShaderValue value = evaluate(*declarator.initializer);
+            if (type.array == 0)
+            {
+                type.array = value.type.array;
+            }
+            return convert(value, type);
+        }
+
+        Target resolve(const GlslExpression& e)
+        {
+            line = e.line;
+            Target target;
+            switch (e.kind)
+            {
+                case GlslExpression::NAME:
+                {
+                    ShaderValue* v = find(e.name);
+                    if (v == NULL)
+                    {
+                        error(compose("Unknown name %0.", e.name));
+                    }
+                    target.name = e.name;
+                    target.type = v->type;
+                    for (size_t i = 0; i < v->data.size(); i++)
+                    {
+                        target.components.push_back(i);
+                    }
+                    return target;
+                }
+                case GlslExpression::INDEX:
+                {
+                    target = resolve(*e.operands[0]);
+                    long long index = evaluate_index(e.operands[1]);
+                    select_part(target.type, target.components, index);
+                    return target;
+                }
+                case GlslExpression::MEMBER:
+                {
+                    target = resolve(*e.operands[0]);
+                    std::vector<size_t> components;
+                    target.type = swizzle(target.type, e.name, components);
+                    std::vector<size_t> selected;
+                    for (size_t i = 0; i < components.size(); i++)
+                    {
+                        if (std::count(components.begin(), components.begin() + i, components[i]))
+                        {
+                            error(compose("Can not assign to .%0.", e.name));
+                        }
+                        selected.push_back(target.components[components[i]]);
+                    }
+                    target.components = selected;
+                    return target;
+                }
+                default:
+                    error("Expected something to assign to.");
+                    return target;
+            }
+        }
+
+        ShaderValue read(const Target& target)
+        {
+            ShaderValue* v = find(target.name);
+            ShaderValue value;
+            value.type = target.type;
+            for (size_t i = 0; i < target.components.size(); i++)
+            {
+                value.data.push_back(v->data[target.components[i]]);
+            }
+            return value;
+        }
+
+        void write(const Target& target, const ShaderValue& value)
+        {
+            ShaderValue converted = convert(value, target.type);
+            ShaderValue* v = find(target.name);
+            for (size_t i = 0; i < target.components.size(); i++)
+            {
+                v->data[target.components[i]] = converted.data[i];
+            }
+        }
+
+        long long evaluate_index(const GlslExpressionPtr& expression)
+        {
+            ShaderValue index = evaluate(*expression);
+            if (!index.type.is_scalar() || (index.type.base != INT_TYPE && index.type.base != UINT_TYPE))
+            {
+                error("An index must be an integer.");
+            }
+            if (index.data[0].kind == ShaderScalar::UNKNOWN)
+            {
+                error(compose("An index depends on %0.", reasons[index.data[0].index]));
+            }
+            if (index.data[0].kind != ShaderScalar::CONSTANT)
+            {
+                error("An index must not depend on the pixel.");
+            }
+            return (long long)index.data[0].value;
+        }
+
+        // an element of an array, a column of a matrix or a component
+        void select_part(ShaderType& type, std::vector<size_t>& components, long long index)
+        {
+            size_t count;
+            if (type.array >= 0)
+            {
+                count = type.get_components();
+                if (index < 0 || index >= type.array)
+                {
+                    error(compose("Index %0 is out of range.", index));
+                }
+                type = type.get_element();
+            }
+            else if (type.columns > 1)
+            {
+                count = type.rows;
+                if (index < 0 || index >= type.columns)
+                {
+                    error(compose("Index %0 is out of range.", index));
+                }
+                type = make_type(type.base, type.rows);
+            }
+            else if (type.rows > 1)
+            {
+                count = 1;
+                if (index < 0 || index >= type.rows)
+                {
+                    error(compose("Index %0 is out of range.", index));
+                }
+                type = make_type(type.base);
+            }
+            else
+            {
+                error("Only arrays, matrices and vectors can be indexed.");
+                return;
+            }
+            std::vector<size_t> part(components.begin() + (size_t)index * count, components.begin() + ((size_t)index + 1) * count);
+            components = part;
+        }
+
+        ShaderType swizzle(const ShaderType& type, const std::string& name, std::vector<size_t>& components)
+        {
+            if (type.columns > 1 || type.array >= 0 || type.base == SAMPLER_TYPE || name.size() > 4)
+            {
+                error(compose("Invalid member .%0 of %1.", name, get_type_name(type)));
+            }
+            for (size_t i = 0; i < name.size(); i++)
+            {
+                int c = swizzle_index(name[i]);
+                if (c < 0 || (unsigned int)c >= type.rows)
+                {
+                    error(compose("Invalid member .%0 of %1.", name, get_type_name(type)));
+                }
+                components.push_back(c);
+            }
+            return make_type(type.base, (unsigned int)name.size());
+        }
+
+        // Expressions
+
+        ShaderValue evaluate(const GlslExpression& e)
+        {
+            line = e.line;
+            switch (e.kind)
+            {
+                case GlslExpression::LITERAL:
+                    if (e.boolean)
+                    {
+                        return make_scalar(BOOL_TYPE, make_constant(e.value));
+                    }
+                    if (e.integer)
+                    {
+                        return make_scalar(e.unsigned_integer ? UINT_TYPE : INT_TYPE, make_constant(e.value));
+                    }
+                    return make_scalar(FLOAT_TYPE, make_constant(round_float(e.value)));
+
+                case GlslExpression::NAME:
+                {
+                    ShaderValue* v = find(e.name);
+                    if (v == NULL)
+                    {
+                        error(compose("Unknown name %0.", e.name));
+                    }
+                    return *v;
+                }
+
+                case GlslExpression::CALL:
+                    return call(e);
+
+                case GlslExpression::MEMBER:
+                {
+                    ShaderValue base = evaluate(*e.operands[0]);
+                    line = e.line;
+                    if (e.name == "length()")
+                    {
+                        if (base.type.array < 0 && base.type.columns == 1 && base.type.rows == 1)
+                        {
+                            error("length() of a scalar.");
+                        }
+                        int length = base.type.array >= 0 ? base.type.array : base.type.columns > 1 ? base.type.columns : base.type.rows;
+                        return make_scalar(INT_TYPE, make_constant(length));
+                    }
+                    std::vector<size_t> components;
+                    ShaderValue result;
+                    result.type = swizzle(base.type, e.name, components);
+                    for (size_t i = 0; i < components.size(); i++)
+                    {
+                        result.data.push_back(base.data[components[i]]);
+                    }
+                    return result;
+                }
+
+                case GlslExpression::INDEX:
+                {
+                    ShaderValue base = evaluate(*e.operands[0]);
+                    long long index = evaluate_index(e.operands[1]);
+                    line = e.line;
+                    std::vector<size_t> components;
+                    for (size_t i = 0; i < base.data.size(); i++)
+                    {
+                        components.push_back(i);
+                    }
+                    ShaderValue result;
+                    result.type = base.type;
+                    select_part(result.type, components, index);
+                    for (size_t i = 0; i < components.size(); i++)
+                    {
+                        result.data.push_back(base.data[components[i]]);
+                    }
+                    return result;
+                }
+
+                case GlslExpression::UNARY:
+                {
+                    if (e.op == "++" || e.op == "--")
+                    {
+                        Target target = resolve(*e.operands[0]);
+                        ShaderValue value = increment(read(target), e.op == "++" ? 1.0 : -1.0);
+                        write(target, value);
+                        return value;
+                    }
+
+                    ShaderValue value = evaluate(*e.operands[0]);
+                    line = e.line;
+                    if (e.op == "+")
+                    {
+                        return value;
+                    }
+                    if (e.op == "-")
+                    {
+                        check_arithmetic(value.type);
+                        for (size_t i = 0; i < value.data.size(); i++)
+                        {
+                            value.data[i] = unary(OP_NEGATE, value.data[i], value.type.base);
+                        }
+                        return value;
+                    }
+                    if (e.op == "!")
+                    {
+                        if (value.type != make_type(BOOL_TYPE))
+                        {
+                            error("! needs a bool.");
+                        }
+                        value.data[0] = binary(OP_EQUAL, value.data[0], make_constant(0.0), BOOL_TYPE);
+                        return value;
+                    }
+                    // ~
+                    return bitwise("~", value, value);
+                }
+
+                case GlslExpression::POSTFIX:
+                {
+                    Target target = resolve(*e.operands[0]);
+                    ShaderValue value = read(target);
+                    write(target, increment(value, e.op == "++" ? 1.0 : -1.0));
+                    return value;
+                }
+
+                case GlslExpression::BINARY:
+                {
+                    if (e.op == "&&" || e.op == "||")
+                    {
+                        return logical(e);
+                    }
+                    ShaderValue a = evaluate(*e.operands[0]);
+                    ShaderValue b = evaluate(*e.operands[1]);
+                    line = e.line;
+                    if (e.op == ",")
+                    {
+                        return b;
+                    }
+                    return operate(e.op, a, b);
+                }
+
+                case GlslExpression::ASSIGN:
+                {
+                    ShaderValue value = evaluate(*e.operands[1]);
+                    Target target = resolve(*e.operands[0]);
+                    line = e.line;
+                    if (e.op != "=")
+                    {
+                        value = operate(e.op.substr(0, e.op.size() - 1), read(target), value);
+                    }
+                    write(target, value);
+                    return read(target);
+                }
+
+                case GlslExpression::CONDITIONAL:
+                {
+                    ShaderScalar condition = evaluate_condition(*e.operands[0]);
+                    if (condition.kind == ShaderScalar::CONSTANT)
+                    {
+                        return evaluate(*e.operands[condition.value != 0.0 ? 1 : 2]);
+                    }
+                    ShaderValue a = evaluate(*e.operands[1]);
+                    ShaderValue b = evaluate(*e.operands[2]);
+                    line = e.line;
+                    if (a.type != b.type)
+                    {
+                        b = convert(b, a.type);
+                    }
+                    for (size_t i = 0; i < a.data.size(); i++)
+                    {
+                        a.data[i] = select(condition, a.data[i], b.data[i]);
+                    }
+                    return a;
+                }
+            }
+            return ShaderValue();
+        }
+
+        ShaderValue increment(const ShaderValue& value, double step)
+        {
+            check_arithmetic(value.type);
+            ShaderValue result = value;
+            for (size_t i = 0; i < result.data.size(); i++)
+            {
+                result.data[i] = binary(OP_ADD, value.data[i], make_constant(step), value.type.base);
+            }
+            return result;
+        }
+
+        void check_arithmetic(const ShaderType& type)
+        {
+            if (type.base != FLOAT_TYPE && type.base != INT_TYPE && type.base != UINT_TYPE)
+            {
+                error(compose("No arithmetic on %0.", get_type_name(type)));
+            }
+            if (type.array >= 0)
+            {
+                error("No arithmetic on arrays.");
+            }
+        }
+
+        ShaderScalar evaluate_condition(const GlslExpression& e)
+        {
+            ShaderValue value = evaluate(e);
+            line = e.line;
+            if (value.type != make_type(BOOL_TYPE))
+            {
+                error("A condition must be a bool.");
+            }
+            if (value.data[0].kind == ShaderScalar::UNKNOWN)
+            {
+                error(compose("A condition depends on %0.", reasons[value.data[0].index]));
+            }
+            return value.data[0];
+        }
+
+        // && and || only evaluate the right side if needed
+        ShaderValue logical(const GlslExpression& e)
+        {
+            bool and_op = e.op == "&&";
+            ShaderScalar a = evaluate_condition(*e.operands[0]);
+            if (a.kind == ShaderScalar::CONSTANT && (a.value != 0.0) != and_op)
+            {
+                return make_scalar(BOOL_TYPE, a);
+            }
+            ShaderScalar b = evaluate_condition(*e.operands[1]);
+            return make_scalar(BOOL_TYPE, binary(and_op ? OP_MIN : OP_MAX, a, b, BOOL_TYPE));
+        }
+
+        ShaderValue bitwise(const std::string& op, const ShaderValue& a, const ShaderValue& b)
+        {
+            if ((a.type.base != INT_TYPE && a.type.base != UINT_TYPE) || a.type != b.type)
+            {
+                error(compose("%0 needs integers of the same type.", op));
+            }
+            ShaderValue result = a;
+            for (size_t i = 0; i < a.data.size(); i++)
+            {
+                if (a.data[i].kind != ShaderScalar::CONSTANT || b.data[i].kind != ShaderScalar::CONSTANT)
+                {
+                    error(compose("%0 on values that depend on the pixel is not supported.", op));
+                }
+                long long x = (long long)a.data[i].value;
+                long long y = (long long)b.data[i].value;
+                long long r = op == "~" ? ~x : op == "&" ? (x & y) : op == "|" ? (x | y) : op == "^" ? (x ^ y) : op == "<<" ? (x << y) : (x >> y);
+                if (a.type.base == UINT_TYPE)
+                {
+                    r &= 0xffffffffll;
+                }
+                result.data[i] = make_constant((double)r);
+            }
+            return result;
+        }
+
+        // a and b with the same base type, int converted to float
+        void promote(ShaderValue& a, ShaderValue& b)
+        {
+            check_arithmetic(a.type);
+            check_arithmetic(b.type);
+            ShaderBase base = a.type.base == FLOAT_TYPE || b.type.base == FLOAT_TYPE ? FLOAT_TYPE : a.type.base == UINT_TYPE || b.type.base == UINT_TYPE ? UINT_TYPE : INT_TYPE;
+            a = convert(a, base);
+            b = convert(b, base);
+        }
+
+        // component by component, a scalar goes with every component
+        ShaderValue componentwise(CpuOp op, const ShaderValue& a, const ShaderValue& b, ShaderBase result_base)
+        {
+            ShaderValue result;
+            if (a.type.is_scalar())
+            {
+                result = b;
+            }
+            else if (b.type.is_scalar() || (a.type.rows == b.type.rows && a.type.columns == b.type.columns))
+            {
+                result = a;
+            }
+            else
+            {
+                error(compose("Can not combine %0 and %1.", get_type_name(a.type), get_type_name(b.type)));
+            }
+            result.type.base = result_base;
+            for (size_t i = 0; i < result.data.size(); i++)
+            {
+                result.data[i] = binary(op, a.data[a.type.is_scalar() ? 0 : i], b.data[b.type.is_scalar() ? 0 : i], a.type.base);
+            }
+            return result;
+        }
+
+        ShaderScalar sum_of_products(const std::vector<ShaderScalar>& a, const std::vector<ShaderScalar>& b, ShaderBase base)
+        {
+            ShaderScalar sum = binary(OP_MULTIPLY, a[0], b[0], base);
+            for (size_t k = 1; k < a.size(); k++)
+            {
+                sum = binary(OP_ADD, sum, binary(OP_MULTIPLY, a[k], b[k], base), base);
+            }
+            return sum;
+        }
+
+        ShaderValue multiply(const ShaderValue& a, const ShaderValue& b)
+        {
+            const ShaderType& ta = a.type;
+            const ShaderType& tb = b.type;
+            ShaderValue result;
+            if (ta.is_matrix() && (tb.is_matrix() || tb.is_vector()))
+            {
+                // a has ta.columns columns of ta.rows, b as many rows
+                if (tb.rows != ta.columns)
+                {
+                    error(compose("Can not multiply %0 and %1.", get_type_name(ta), get_type_name(tb)));
+                }
+                result = make_value(make_type(FLOAT_TYPE, ta.rows, tb.columns));
+                for (unsigned int j = 0; j < tb.columns; j++)
+                {
+                    for (unsigned int i = 0; i < ta.rows; i++)
+                    {
+                        std::vector<ShaderScalar> row, column;
+                        for (unsigned int k = 0; k < ta.columns; k++)
+                        {
+                            row.push_back(a.data[k * ta.rows + i]);
+                            column.push_back(b.data[j * tb.rows + k]);
+                        }
+                        result.data[j * ta.rows + i] = sum_of_products(row, column, FLOAT_TYPE);
+                    }
+                }
+                return result;
+            }
+            if (ta.is_vector() && tb.is_matrix())
+            {
+                if (ta.rows != tb.rows)
+                {
+                    error(compose("Can not multiply %0 and %1.", get_type_name(ta), get_type_name(tb)));
+                }
+                result = make_value(make_type(FLOAT_TYPE, tb.columns));
+                for (unsigned int j = 0; j < tb.columns; j++)
+                {
+                    std::vector<ShaderScalar> column(b.data.begin() + j * tb.rows, b.data.begin() + (j + 1) * tb.rows);
+                    result.data[j] = sum_of_products(a.data, column, FLOAT_TYPE);
+                }
+                return result;
+            }
+            return componentwise(OP_MULTIPLY, a, b, a.type.base);
+        }
+
+        ShaderValue operate(const std::string& op, ShaderValue a, ShaderValue b)
+        {
+            if (op == "&" || op == "|" || op == "^" || op == "<<" || op == ">>")
+            {
+                return bitwise(op, a, b);
+            }
+
+            if (op == "==" || op == "!=")
+            {
+                if (a.type != b.type)
+                {
+                    promote(a, b);
+                }
+                if (a.type != b.type)
+                {
+                    error(compose("Can not compare %0 and %1.", get_type_name(a.type), get_type_name(b.type)));
+                }
+                ShaderScalar equal = make_constant(1.0);
+                for (size_t i = 0; i < a.data.size(); i++)
+                {
+                    equal = binary(OP_MIN, equal, binary(OP_EQUAL, a.data[i], b.data[i], a.type.base), BOOL_TYPE);
+                }
+                if (op == "!=")
+                {
+                    equal = binary(OP_EQUAL, equal, make_constant(0.0), BOOL_TYPE);
+                }
+                return make_scalar(BOOL_TYPE, equal);
+            }
+
+            if (op == "^^")
+            {
+                if (a.type != make_type(BOOL_TYPE) || b.type != make_type(BOOL_TYPE))
+                {
+                    error("^^ needs bools.");
+                }
+                return make_scalar(BOOL_TYPE, binary(OP_NOT_EQUAL, a.data[0], b.data[0], BOOL_TYPE));
+            }
+
+            promote(a, b);
+            if (op == "<" || op == ">" || op == "<=" || op == ">=")
+            {
+                if (!a.type.is_scalar() || !b.type.is_scalar())
+                {
+                    error(compose("%0 compares scalars only.", op));
+                }
+                bool swap = op == ">" || op == ">=";
+                CpuOp o   = op == "<" || op == ">" ? OP_LESS : OP_LESS_EQUAL;
+                return make_scalar(BOOL_TYPE, binary(o, swap ? b.data[0] : a.data[0], swap ? a.data[0] : b.data[0], a.type.base));
+            }
+
+            if (op == "*")
+            {
+                return multiply(a, b);
+            }
+            if (op == "%")
+            {
+                if (a.type.base == FLOAT_TYPE)
+                {
+                    error("% needs integers.");
+                }
+                return componentwise(OP_MOD, a, b, a.type.base);
+            }
+            if (op == "+" || op == "-" || op == "/")
+            {
+                return componentwise(op == "+" ? OP_ADD : op == "-" ? OP_SUBTRACT : OP_DIVIDE, a, b, a.type.base);
+            }
+
+            error(compose("Unknown operator %0.", op));
+            return a;
+        }
+
+        // Calls
+
+        std::vector<ShaderScalar> flatten(const std::vector<ShaderValue>& args)
+        {
+            std::vector<ShaderScalar> components;
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                if (args[i].type.array >= 0 || args[i].type.base == SAMPLER_TYPE)
+                {
+                    error("Invalid constructor argument.");
+                }
+                for (size_t j = 0; j < args[i].data.size(); j++)
+                {
+                    components.push_back(convert(args[i].data[j], args[i].type.base, FLOAT_TYPE));
+                }
+            }
+            return components;
+        }
+
+        ShaderValue construct(const GlslExpression& e, const std::vector<ShaderValue>& args)
+        {
+            ShaderType type = get_type(e.name);
+            if (type.base == VOID_TYPE || type.base == SAMPLER_TYPE || args.empty())
+            {
+                error(compose("Invalid constructor %0.", e.name));
+            }
+
+            if (e.array)
+            {
+                ShaderValue result;
+                result.type       = type;
+                result.type.array = e.array_size ? (int)evaluate_integer(e.array_size) : (int)args.size();
+                if (result.type.array != (int)args.size())
+                {
+                    error(compose("%0[%1] needs as many elements.", e.name, result.type.array));
+                }
+                for (size_t i = 0; i < args.size(); i++)
+                {
+                    ShaderValue element = convert(args[i], type);
+                    result.data.insert(result.data.end(), element.data.begin(), element.data.end());
+                }
+                return result;
+            }
+
+            ShaderValue result = make_value(type);
+            // converted from the argument's base, not via float
+            ShaderBase from = args[0].type.base;
+
+            if (type.is_matrix() && args.size() == 1 && args[0].type.is_matrix())
+            {
+                const ShaderType& t = args[0].type;
+                for (unsigned int j = 0; j < type.columns; j++)
+                {
+                    for (unsigned int i = 0; i < type.rows; i++)
+                    {
+                        bool inside = j < t.columns && i < t.rows;
+                        result.data[j * type.rows + i] = inside ? args[0].data[j * t.rows + i] : make_constant(i == j ? 1.0 : 0.0);
+                    }
+                }
+                return result;
+            }
+
+            if (args.size() == 1 && args[0].type.is_scalar())
+            {
+                ShaderScalar value = convert(args[0].data[0], from, type.base);
+                for (unsigned int j = 0; j < type.columns; j++)
+                {
+                    for (unsigned int i = 0; i < type.rows; i++)
+                    {
+                        // a matrix gets its diagonal
+                        bool set = !type.is_matrix() || i == j;
+                        result.data[j * type.rows + i] = set ? value : make_constant(0.0);
+                    }
+                }
+                return result;
+            }
+
+            std::vector<ShaderScalar> components;
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                if (args[i].type.array >= 0 || args[i].type.base == SAMPLER_TYPE || args[i].type.base == VOID_TYPE)
+                {
+                    error(compose("Invalid argument of %0.", e.name));
+                }
+                for (size_t j = 0; j < args[i].data.size(); j++)
+                {
+                    components.push_back(convert(args[i].data[j], args[i].type.base, type.base));
+                }
+            }
+            if (components.size() < result.data.size())
+            {
+                error(compose("Not enough components for %0.", e.name));
+            }
+            std::copy(components.begin(), components.begin() + result.data.size(), result.data.begin());
+            return result;
+        }
+
+        const GlslFunction* find_function(const std::string& name, const std::vector<ShaderValue>& args)
+        {
+            auto f = functions.find(name);
+            if (f == functions.end())
+            {
+                return NULL;
+            }
+
+            // an exact match, or one with int to float conversions
+            const GlslFunction* convertible = NULL;
+            for (size_t i = 0; i < f->second.size(); i++)
+            {
+                const GlslFunction* function = f->second[i];
+                if (function->parameters.size() != args.size())
+                {
+                    continue;
+                }
+                bool exact = true;
+                bool match = true;
+                for (size_t j = 0; j < args.size(); j++)
+                {
+                    ShaderType type  = get_type(function->parameters[j].type);
+                    ShaderType shape = args[j].type;
+                    shape.base = type.base;
+                    exact = exact && type == args[j].type;
+                    match = match && shape == type && (type.base == args[j].type.base || (type.base == FLOAT_TYPE && (args[j].type.base == INT_TYPE || args[j].type.base == UINT_TYPE)));
+                }
+                if (exact)
+                {
+                    return function;
+                }
+                if (match && convertible == NULL)
+                {
+                    convertible = function;
+                }
+            }
+            return convertible;
+        }
+
+        ShaderValue call(const GlslExpression& e)
+        {
+            std::vector<ShaderValue> args;
+            for (size_t i = 0; i < e.operands.size(); i++)
+            {
+                args.push_back(evaluate(*e.operands[i]));
+            }
+            line = e.line;
+
+            if (e.array || is_type_name(e.name))
+            {
+                return construct(e, args);
+            }
+
+            if (functions.count(e.name))
+            {
+                const GlslFunction* function = find_function(e.name, args);
+                if (function == NULL)
+                {
+                    error(compose("No %0 takes these arguments.", e.name));
+                }
+                return invoke(*function, args, &e);
+            }
+
+            return builtin(e.name, args);
+        }
+
+        ShaderValue invoke(const GlslFunction& function, const std::vector<ShaderValue>& args, const GlslExpression* e)
+        {
+            if (frames.size() > 64)
+            {
+                error(compose("%0 calls itself.", function.name));
+            }
+
+            Frame frame;
+            frame.type = get_type(function.type);
+            frame.scopes.push_back(std::map<std::string, ShaderValue>());
+            for (size_t i = 0; i < function.parameters.size(); i++)
+            {
+                const GlslParameter& parameter = function.parameters[i];
+                ShaderType type = get_type(parameter.type);
+                frame.scopes[0][parameter.name] = parameter.direction == "out" ? make_value(type) : convert(args[i], type);
+            }
+
+            frames.push_back(frame);
+            execute(*function.body);
+            Frame done = frames.back();
+            frames.pop_back();
+
+            for (size_t i = 0; i < function.parameters.size(); i++)
+            {
+                const GlslParameter& parameter = function.parameters[i];
+                if (parameter.direction != "in" && e != NULL)
+                {
+                    write(resolve(*e->operands[i]), done.scopes[0][parameter.name]);
+                }
+            }
+
+            if (frame.type.base != VOID_TYPE && done.result.data.empty())
+            {
+                error(compose("%0 does not return a value.", function.name));
+            }
+            return frame.type.base == VOID_TYPE ? make_value(frame.type) : done.result;
+        }
+
+        ShaderValue map_unary(CpuOp op, ShaderValue x, bool keep_integers = false)
+        {
+            check_arithmetic(x.type);
+            if (!keep_integers)
+            {
+                x = convert(x, FLOAT_TYPE);
+            }
+            for (size_t i = 0; i < x.data.size(); i++)
+            {
+                x.data[i] = unary(op, x.data[i], x.type.base);
+            }
+            return x;
+        }
+
+        ShaderValue map_binary(CpuOp op, ShaderValue x, ShaderValue y, bool keep_integers = false)
+        {
+            promote(x, y);
+            if (!keep_integers)
+            {
+                x = convert(x, FLOAT_TYPE);
+                y = convert(y, FLOAT_TYPE);
+            }
+            return componentwise(op, x, y, x.type.base);
+        }
+
+        ShaderValue compare(CpuOp op, ShaderValue x, ShaderValue y, bool swap)
+        {
+            promote(x, y);
+            if (!x.type.is_vector() || x.type != y.type)
+            {
+                error("Component comparisons need two vectors of the same size.");
+            }
+            ShaderValue result = swap ? componentwise(op, y, x, BOOL_TYPE) : componentwise(op, x, y, BOOL_TYPE);
+            return result;
+        }
+
+        ShaderValue dot(const ShaderValue& a, const ShaderValue& b)
+        {
+            if (a.type.rows != b.type.rows || a.type.columns != 1 || b.type.columns != 1)
+            {
+                error("dot needs two vectors of the same size.");
+            }
+            return make_scalar(FLOAT_TYPE, sum_of_products(a.data, b.data, FLOAT_TYPE));
+        }
+
+        ShaderValue length(const ShaderValue& x)
+        {
+            return map_unary(OP_SQRT, dot(x, x));
+        }
+
+        ShaderValue texel_fetch(const ShaderValue& sampler, ShaderValue coord, const ShaderValue& lod)
+        {
+            if (sampler.type.base != SAMPLER_TYPE || coord.type.rows != 2 || coord.type.columns != 1 || coord.type.base == FLOAT_TYPE)
+            {
+                error("texelFetch needs a sampler2D and an ivec2.");
+            }
+            if (lod.data.empty() || lod.data[0].kind != ShaderScalar::CONSTANT || lod.data[0].value != 0.0)
+            {
+                error("texelFetch is supported for level 0 only.");
+            }
+            if (sampler.data[0].kind == ShaderScalar::UNKNOWN)
+            {
+                error(compose("A texelFetch reads %0.", reasons[sampler.data[0].index]));
+            }
+
+            unsigned int input = (unsigned int)sampler.data[0].value;
+            inputs = std::max(inputs, input + 1);
+
+            ShaderScalar x = coord.data[0];
+            ShaderScalar y = coord.data[1];
+            for (int i = 0; i < 2; i++)
+            {
+                if (coord.data[i].kind == ShaderScalar::UNKNOWN)
+                {
+                    error(compose("A texelFetch depends on %0.", reasons[coord.data[i].index]));
+                }
+            }
+
+            ShaderValue result = make_value(make_type(FLOAT_TYPE, 4));
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                unsigned int plane = get_plane(input, c);
+                if (x.kind == ShaderScalar::COORD && x.index == 0 && y.kind == ShaderScalar::COORD && y.index == 1)
+                {
+                    int dx = (int)x.value;
+                    int dy = (int)y.value;
+                    reach = std::max(reach, (unsigned int)std::max(std::abs(dx), std::abs(dy)));
+                    Node node = {true, CpuProgram::Instruction::OPERATION, OP_ADD, constant_ref(0.0f), constant_ref(0.0f), constant_ref(0.0f), plane, dx, dy};
+                    result.data[c] = make_node(emit(node));
+                }
+                else
+                {
+                    // anywhere in the image
+                    result.data[c] = make_node(emit(CpuProgram::Instruction::FETCH, OP_ADD, get_ref(x), get_ref(y), constant_ref(0.0f), plane));
+                }
+            }
+            return result;
+        }
+
+        ShaderValue builtin(const std::string& name, std::vector<ShaderValue>& args)
+        {
+            struct UnaryFunction
+            {
+                const char* name;
+                CpuOp       op;
+                bool        integers;
+            };
+            static const UnaryFunction unary_functions[] = {
+                {"sin", OP_SIN, false}, {"cos", OP_COS, false}, {"tan", OP_TAN, false},
+                {"asin", OP_ASIN, false}, {"acos", OP_ACOS, false},
+                {"exp", OP_EXP, false}, {"log", OP_LOG, false}, {"exp2", OP_EXP2, false}, {"log2", OP_LOG2, false},
+                {"sqrt", OP_SQRT, false}, {"inversesqrt", OP_INVERSE_SQRT, false},
+                {"abs", OP_ABS, true}, {"sign", OP_SIGN, true}, {"floor", OP_FLOOR, false}, {"ceil", OP_CEIL, false},
+                {"trunc", OP_TRUNC, false}, {"round", OP_ROUND, false}, {"roundEven", OP_ROUND, false}, {"fract", OP_FRACT, false}
+            };
+
+            size_t n = args.size();
+            for (size_t i = 0; i < sizeof(unary_functions) / sizeof(unary_functions[0]); i++)
+            {
+                if (name == unary_functions[i].name && n == 1)
+                {
+                    return map_unary(unary_functions[i].op, args[0], unary_functions[i].integers);
+                }
+            }
+
+            if (name == "atan" && n == 1)
+            {
+                return map_unary(OP_ATAN, args[0]);
+            }
+            if (name == "atan" && n == 2)
+            {
+                return map_binary(OP_ATAN2, args[0], args[1]);
+            }
+            if (name == "radians" && n == 1)
+            {
+                return map_binary(OP_MULTIPLY, args[0], make_scalar(FLOAT_TYPE, make_constant(round_float(3.14159265358979323846 / 180.0))));
+            }
+            if (name == "degrees" && n == 1)
+            {
+                return map_binary(OP_MULTIPLY, args[0], make_scalar(FLOAT_TYPE, make_constant(round_float(180.0 / 3.14159265358979323846))));
+            }
+            if (name == "pow" && n == 2)
+            {
+                return map_binary(OP_POW, args[0], args[1]);
+            }
+            if (name == "mod" && n == 2)
+            {
+                return map_binary(OP_MOD, args[0], args[1]);
+            }
+            if ((name == "min" || name == "max") && n == 2)
+            {
+                return map_binary(name == "min" ? OP_MIN : OP_MAX, args[0], args[1], true);
+            }
+            if (name == "clamp" && n == 3)
+            {
+                return map_binary(OP_MIN, map_binary(OP_MAX, args[0], args[1], true), args[2], true);
+            }
+            if (name == "mix" && n == 3)
+            {
+                if (args[2].type.base == BOOL_TYPE)
+                {
+                    ShaderValue x = convert(args[0], FLOAT_TYPE);
+                    ShaderValue y = convert(args[1], FLOAT_TYPE);
+                    for (size_t i = 0; i < x.data.size(); i++)
+                    {
+                        x.data[i] = select(args[2].data[args[2].type.is_scalar() ? 0 : i], y.data[i], x.data[i]);
+                    }
+                    return x;
+                }
+                // x * (1 - a) + y * a
+                ShaderValue one = make_scalar(FLOAT_TYPE, make_constant(1.0));
+                ShaderValue x   = map_binary(OP_MULTIPLY, args[0], map_binary(OP_SUBTRACT, one, args[2]));
+                return map_binary(OP_ADD, x, map_binary(OP_MULTIPLY, args[1], args[2]));
+            }
+            if (name == "step" && n == 2)
+            {
+                // edge <= x
+                ShaderValue edge = convert(args[0], FLOAT_TYPE);
+                ShaderValue x    = convert(args[1], FLOAT_TYPE);
+                return componentwise(OP_LESS_EQUAL, edge, x, FLOAT_TYPE);
+            }
+            if (name == "smoothstep" && n == 3)
+            {
+                ShaderValue zero = make_scalar(FLOAT_TYPE, make_constant(0.0));
+                ShaderValue one  = make_scalar(FLOAT_TYPE, make_constant(1.0));
+                ShaderValue t    = map_binary(OP_DIVIDE, map_binary(OP_SUBTRACT, args[2], args[0]), map_binary(OP_SUBTRACT, args[1], args[0]));
+                t = map_binary(OP_MIN, map_binary(OP_MAX, t, zero), one);
+                ShaderValue s = map_binary(OP_SUBTRACT, make_scalar(FLOAT_TYPE, make_constant(3.0)), map_binary(OP_MULTIPLY, make_scalar(FLOAT_TYPE, make_constant(2.0)), t));
+                return map_binary(OP_MULTIPLY, map_binary(OP_MULTIPLY, t, t), s);
+            }
+            if (name == "dot" && n == 2)
+            {
+                return dot(convert(args[0], FLOAT_TYPE), convert(args[1], FLOAT_TYPE));
+            }
+            if (name == "length" && n == 1)
+            {
+                return length(convert(args[0], FLOAT_TYPE));
+            }
+            if (name == "distance" && n == 2)
+            {
+                return length(map_binary(OP_SUBTRACT, args[0], args[1]));
+            }
+            if (name == "normalize" && n == 1)
+            {
+                ShaderValue x = convert(args[0], FLOAT_TYPE);
+                return map_binary(OP_DIVIDE, x, length(x));
+            }
+            if (name == "cross" && n == 2)
+            {
+                ShaderValue a = convert(args[0], FLOAT_TYPE);
+                ShaderValue b = convert(args[1], FLOAT_TYPE);
+                if (a.type != make_type(FLOAT_TYPE, 3) || b.type != a.type)
+                {
+                    error("cross needs two vec3.");
+                }
+                ShaderValue result = a;
+                for (int i = 0; i < 3; i++)
+                {
+                    int j = (i + 1) % 3;
+                    int k = (i + 2) % 3;
+                    result.data[i] = binary(OP_SUBTRACT, binary(OP_MULTIPLY, a.data[j], b.data[k], FLOAT_TYPE), binary(OP_MULTIPLY, b.data[j], a.data[k], FLOAT_TYPE), FLOAT_TYPE);
+                }
+                return result;
+            }
+            if (name == "reflect" && n == 2)
+            {
+                // I - 2 * dot(N, I) * N
+                ShaderValue d = map_binary(OP_MULTIPLY, make_scalar(FLOAT_TYPE, make_constant(2.0)), dot(convert(args[1], FLOAT_TYPE), convert(args[0], FLOAT_TYPE)));
+                return map_binary(OP_SUBTRACT, args[0], map_binary(OP_MULTIPLY, d, args[1]));
+            }
+            if (name == "lessThan" && n == 2)
+            {
+                return compare(OP_LESS, args[0], args[1], false);
+            }
+            if (name == "lessThanEqual" && n == 2)
+            {
+                return compare(OP_LESS_EQUAL, args[0], args[1], false);
+            }
+            if (name == "greaterThan" && n == 2)
+            {
+                return compare(OP_LESS, args[0], args[1], true);
+            }
+            if (name == "greaterThanEqual" && n == 2)
+            {
+                return compare(OP_LESS_EQUAL, args[0], args[1], true);
+            }
+            if ((name == "equal" || name == "notEqual") && n == 2)
+            {
+                return compare(name == "equal" ? OP_EQUAL : OP_NOT_EQUAL, args[0], args[1], false);
+            }
+            if ((name == "any" || name == "all" || name == "not") && n == 1)
+            {
+                if (args[0].type.base != BOOL_TYPE || !args[0].type.is_vector())
+                {
+                    error(compose("%0 needs a bvec.", name));
+                }
+                ShaderValue x = args[0];
+                if (name == "not")
+                {
+                    for (size_t i = 0; i < x.data.size(); i++)
+                    {
+                        x.data[i] = binary(OP_EQUAL, x.data[i], make_constant(0.0), BOOL_TYPE);
+                    }
+                    return x;
+                }
+                ShaderScalar r = x.data[0];
+                for (size_t i = 1; i < x.data.size(); i++)
+                {
+                    r = binary(name == "any" ? OP_MAX : OP_MIN, r, x.data[i], BOOL_TYPE);
+                }
+                return make_scalar(BOOL_TYPE, r);
+            }
+            if (name == "matrixCompMult" && n == 2)
+            {
+                if (!args[0].type.is_matrix() || args[0].type != args[1].type)
+                {
+                    error("matrixCompMult needs two matrices of the same size.");
+                }
+                return componentwise(OP_MULTIPLY, args[0], args[1], FLOAT_TYPE);
+            }
+            if (name == "transpose" && n == 1)
+            {
+                const ShaderType& t = args[0].type;
+                if (!t.is_matrix())
+                {
+                    error("transpose needs a matrix.");
+                }
+                ShaderValue result = make_value(make_type(FLOAT_TYPE, t.columns, t.rows));
+                for (unsigned int j = 0; j < t.columns; j++)
+                {
+                    for (unsigned int i = 0; i < t.rows; i++)
+                    {
+                        result.data[i * t.columns + j] = args[0].data[j * t.rows + i];
+                    }
+                }
+                return result;
+            }
+            if (name == "texelFetch" && n == 3)
+            {
+                return texel_fetch(args[0], args[1], args[2]);
+            }
+            if (name == "texelFetchOffset" && n == 4)
+            {
+                return texel_fetch(args[0], operate("+", args[1], args[3]), args[2]);
+            }
+            if (name == "textureSize" && n == 2)
+            {
+                ShaderValue size = make_value(make_type(INT_TYPE, 2));
+                size.data[0] = make_node(emit_special(CpuProgram::Instruction::WIDTH));
+                size.data[1] = make_node(emit_special(CpuProgram::Instruction::HEIGHT));
+                return size;
+            }
+            if (name.compare(0, 7, "texture") == 0)
+            {
+                error(compose("%0 is not supported on the CPU, use texelFetch.", name));
+            }
+
+            error(compose("Unknown function %0 with %1 arguments.", name, n));
+            return ShaderValue();
+        }
+
+        // Statements
+
+        Flow execute(const GlslStatement& s)
+        {
+            line = s.line;
+            switch (s.kind)
+            {
+                case GlslStatement::EXPRESSION:
+                    evaluate(*s.expression);
+                    return NEXT;
+
+                case GlslStatement::DECLARATION:
+                    for (size_t i = 0; i < s.declarators.size(); i++)
+                    {
+                        declare(s.declarators[i].name, initialize(s.declarators[i]));
+                    }
+                    return NEXT;
+
+                case GlslStatement::BLOCK:
+                {
+                    frames.back().scopes.push_back(std::map<std::string, ShaderValue>());
+                    Flow flow = NEXT;
+                    for (size_t i = 0; i < s.statements.size() && flow == NEXT; i++)
+                    {
+                        flow = execute(*s.statements[i]);
+                    }
+                    frames.back().scopes.pop_back();
+                    return flow;
+                }
+
+                case GlslStatement::IF:
+                {
+                    ShaderScalar condition = evaluate_condition(*s.expression);
+                    if (condition.kind == ShaderScalar::CONSTANT)
+                    {
+                        const GlslStatementPtr& branch = s.statements[condition.value != 0.0 ? 0 : 1];
+                        return branch ? execute(*branch) : NEXT;
+                    }
+                    return execute_both(s, condition);
+                }
+
+                case GlslStatement::FOR:
+                case GlslStatement::WHILE:
+                case GlslStatement::DO:
+                    return execute_loop(s);
+
+                case GlslStatement::RETURN:
+                    if (s.expression)
+                    {
+                        ShaderValue value = evaluate(*s.expression);
+                        frames.back().result = convert(value, frames.back().type);
+                    }
+                    return RETURN;
+
+                case GlslStatement::BREAK:
+                    return BREAK;
+
+                case GlslStatement::CONTINUE:
+                    return CONTINUE;
+
+                case GlslStatement::DISCARD:
+                    error("discard is not supported on the CPU.");
+                    return NEXT;
+
+                default:
+                    return NEXT;
+            }
+        }
+
+        // An if on pixel values: run both branches and select each variable
+        // that they leave different.
+        Flow execute_both(const GlslStatement& s, const ShaderScalar& condition)
+        {
+            Frame                              before_frame   = frames.back();
+            std::map<std::string, ShaderValue> before_globals = globals;
+
+            Flow then_flow = execute(*s.statements[0]);
+            Frame                              then_frame   = frames.back();
+            std::map<std::string, ShaderValue> then_globals = globals;
+
+            frames.back() = before_frame;
+            globals       = before_globals;
+            Flow else_flow = s.statements[1] ? execute(*s.statements[1]) : NEXT;
+
+            line = s.line;
+            if (then_flow != NEXT || else_flow != NEXT)
+            {
+                error("return, break and continue under an if on pixel values are not supported on the CPU.");
+            }
+
+            std::vector<std::map<std::string, ShaderValue>>& scopes = frames.back().scopes;
+            for (size_t i = 0; i < scopes.size(); i++)
+            {
+                merge(condition, then_frame.scopes[i], scopes[i]);
+            }
+            merge(condition, then_globals, globals);
+            return NEXT;
+        }
+
+        void merge(const ShaderScalar& condition, std::map<std::string, ShaderValue>& then_values, std::map<std::string, ShaderValue>& values)
+        {
+            for (auto v = values.begin(); v != values.end(); ++v)
+            {
+                const ShaderValue& then_value = then_values[v->first];
+                for (size_t i = 0; i < v->second.data.size(); i++)
+                {
+                    v->second.data[i] = select(condition, then_value.data[i], v->second.data[i]);
+                }
+            }
+        }
+
+        Flow execute_loop(const GlslStatement& s)
+        {
+            frames.back().scopes.push_back(std::map<std::string, ShaderValue>());
+            if (s.kind == GlslStatement::FOR && s.statements[0])
+            {
+                execute(*s.statements[0]);
+            }
+            const GlslStatement& body = *s.statements.back();
+
+            Flow result = NEXT;
+            bool first  = true;
+            while (true)
+            {
+                if (s.expression && !(s.kind == GlslStatement::DO && first))
+                {
+                    ShaderScalar condition = evaluate_condition(*s.expression);
+                    if (condition.kind != ShaderScalar::CONSTANT)
+                    {
+                        error("A loop must not depend on the pixel.");
+                    }
+                    if (condition.value == 0.0)
+                    {
+                        break;
+                    }
+                }
+                first = false;
+
+                if (++iterations > (1u << 24))
+                {
+                    error("A loop does not end.");
+                }
+
+                Flow flow = execute(body);
+                if (flow == BREAK)
+                {
+                    break;
+                }
+                if (flow == RETURN)
+                {
+                    result = RETURN;
+                    break;
+                }
+                if (s.step)
+                {
+                    evaluate(*s.step);
+                }
+            }
+            frames.back().scopes.pop_back();
+            return result;
+        }
+
+        // Shaders
+
+        ShaderValue get_uniform(const GlslGlobal& global, const ShaderType& type)
+        {
+            const std::string& name = global.declarator.name;
+            if (type.base == SAMPLER_TYPE && type.array < 0)
+            {
+                if (name == "uTexture")
+                {
+                    return make_scalar(SAMPLER_TYPE, make_constant(0.0));
+                }
+                if (name.compare(0, 8, "uTexture") == 0 && name.size() > 8 && name.find_first_not_of("0123456789", 8) == std::string::npos)
+                {
+                    return make_scalar(SAMPLER_TYPE, make_constant(std::atoi(name.c_str() + 8)));
+                }
+            }
+
+            if (name.compare(0, 12, "uTextureSize") == 0 && type.rows == 2 && type.columns == 1 && type.array < 0)
+            {
+                ShaderValue size = make_value(type);
+                size.data[0] = make_node(emit_special(CpuProgram::Instruction::WIDTH));
+                size.data[1] = make_node(emit_special(CpuProgram::Instruction::HEIGHT));
+                return size;
+            }
+
+            return make_value(type, make_unknown(add_reason(compose("the uniform %0, which is not set on the CPU", name))));
+        }
+
+        // Run main and return the value of the first output.
+        ShaderValue run_shader(const GlslShader& shader, bool is_fragment, std::map<std::string, ShaderValue>& varyings)
+        {
+            fragment = is_fragment;
+            functions.clear();
+            globals.clear();
+            for (size_t i = 0; i < shader.functions.size(); i++)
+            {
+                functions[shader.functions[i].name].push_back(&shader.functions[i]);
+            }
+
+            ShaderValue frag_coord = make_value(make_type(FLOAT_TYPE, 4));
+            frag_coord.data[0] = make_coord(0, 0.5);
+            frag_coord.data[1] = make_coord(1, 0.5);
+            frag_coord.data[2] = make_constant(0.5);
+            frag_coord.data[3] = make_constant(1.0);
+            globals[fragment ? "gl_FragCoord" : "gl_Position"] = frag_coord;
+
+            std::vector<std::string> outputs;
+            for (size_t i = 0; i < shader.globals.size(); i++)
+            {
+                const GlslGlobal& global = shader.globals[i];
+                const std::string& name  = global.declarator.name;
+                line = global.line;
+
+                ShaderType type = get_type(global.declarator.type);
+                if (global.qualifier == "uniform")
+                {
+                    globals[name] = get_uniform(global, type);
+                }
+                else if (global.qualifier == "in" && !fragment)
+                {
+                    globals[name] = make_value(type, make_unknown(add_reason(compose("the vertex attribute %0", name))));
+                }
+                else if (global.qualifier == "in" && name == "vTexCoord" && type == make_type(FLOAT_TYPE, 2))
+                {
+                    ShaderValue coord = make_value(type);
+                    coord.data[0] = make_coord(0, 0.5);
+                    coord.data[1] = make_coord(1, 0.5);
+                    globals[name] = coord;
+                }
+                else if (global.qualifier == "in")
+                {
+                    auto v = varyings.find(name);
+                    if (v != varyings.end() && v->second.type == type)
+                    {
+                        globals[name] = v->second;
+                    }
+                    else
+                    {
+                        globals[name] = make_value(type, make_unknown(add_reason(compose("the input %0, which the vertex shader does not pass", name))));
+                    }
+                }
+                else if (global.qualifier == "out")
+                {
+                    globals[name] = make_value(type);
+                    outputs.push_back(name);
+                }
+                else
+                {
+                    globals[name] = initialize(global.declarator);
+                }
+            }
+
+            const GlslFunction* main = find_function("main", std::vector<ShaderValue>());
+            if (main == NULL)
+            {
+                throw std::runtime_error("The shader has no main.");
+            }
+            invoke(*main, std::vector<ShaderValue>(), NULL);
+
+            if (!fragment)
+            {
+                // only what is the same for all vertices is of use
+                for (size_t i = 0; i < outputs.size(); i++)
+                {
+                    const ShaderValue& value = globals[outputs[i]];
+                    bool known = true;
+                    for (size_t j = 0; j < value.data.size(); j++)
+                    {
+                        known = known && value.data[j].kind == ShaderScalar::CONSTANT;
+                    }
+                    if (known)
+                    {
+                        varyings[outputs[i]] = value;
+                    }
+                }
+                return ShaderValue();
+            }
+
+            for (size_t i = 0; i < outputs.size(); i++)
+            {
+                const ShaderValue& value = globals[outputs[i]];
+                if (value.type.base != FLOAT_TYPE || value.type.array >= 0 || value.type.columns != 1)
+                {
+                    continue;
+                }
+                return value;
+            }
+            throw std::runtime_error("The shader has no vec4 output.");
+        }
+
+        // Scheduling
+
+        std::vector<int> operands(const Node& node) const
+        {
+            std::vector<int> result;
+            if (node.a.node >= 0)
+            {
+                result.push_back(node.a.node);
+            }
+            if (node.b.node >= 0)
+            {
+                result.push_back(node.b.node);
+            }
+            if (node.c.node >= 0)
+            {
+                result.push_back(node.c.node);
+            }
+            return result;
+        }
+
+        // how often each node is used by live nodes and the outputs
+        std::vector<int> count_uses(const Ref outputs[4]) const
+        {
+            std::vector<int>  uses(nodes.size(), 0);
+            std::vector<bool> live(nodes.size(), false);
+            for (int c = 0; c < 4; c++)
+            {
+                if (outputs[c].node >= 0)
+                {
+                    live[outputs[c].node] = true;
+                    uses[outputs[c].node]++;
+                }
+            }
+            // operands come before their users
+            for (size_t n = nodes.size(); n > 0; n--)
+            {
+                if (live[n - 1])
+                {
+                    std::vector<int> o = operands(nodes[n - 1]);
+                    for (size_t i = 0; i < o.size(); i++)
+                    {
+                        live[o[i]] = true;
+                        uses[o[i]]++;
+                    }
+                }
+            }
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                if (!live[n])
+                {
+                    uses[n] = -1;
+                }
+            }
+            return uses;
+        }
+
+        void finish(const Ref outputs[4], unsigned int footprint)
+        {
+            // a + b * c in one go, where the product is not used otherwise
+            std::vector<int> uses = count_uses(outputs);
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                Node& node = nodes[n];
+                if (uses[n] < 0 || node.load || node.kind != CpuProgram::Instruction::OPERATION || node.op != OP_ADD)
+                {
+                    continue;
+                }
+                Ref sides[2] = {node.a, node.b};
+                for (int s = 0; s < 2; s++)
+                {
+                    int p = sides[s].node;
+                    if (p >= 0 && uses[p] == 1 && !nodes[p].load && nodes[p].kind == CpuProgram::Instruction::OPERATION && nodes[p].op == OP_MULTIPLY)
+                    {
+                        node.op = OP_MULTIPLY_ADD;
+                        node.c  = sides[1 - s];
+                        node.a  = nodes[p].a;
+                        node.b  = nodes[p].b;
+                        uses[p] = 0;
+                        break;
+                    }
+                }
+            }
+            uses = count_uses(outputs);
+
+            // the loads are slots of their own, the rest gets registers
+            std::vector<int> slot(nodes.size(), -1);
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                if (uses[n] > 0 && nodes[n].load)
+                {
+                    CpuProgram::Load load = {nodes[n].plane, nodes[n].x, nodes[n].y};
+                    slot[n] = (int)program.loads.size();
+                    program.loads.push_back(load);
+                }
+            }
+            int first_register = (int)program.loads.size();
+
+            // the last node to use each node, the outputs are used at the end
+            std::vector<size_t> last_use(nodes.size(), 0);
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                if (uses[n] > 0)
+                {
+                    std::vector<int> o = operands(nodes[n]);
+                    for (size_t i = 0; i < o.size(); i++)
+                    {
+                        last_use[o[i]] = n;
+                    }
+                }
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                if (outputs[c].node >= 0)
+                {
+                    last_use[outputs[c].node] = nodes.size();
+                }
+            }
+
+            std::vector<int> free_registers;
+            unsigned int     registers = 0;
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                const Node& node = nodes[n];
+                if (uses[n] <= 0 || node.load)
+                {
+                    continue;
+                }
+
+                // registers of operands that end here can be written right away
+                std::vector<int> o = operands(node);
+                int reuse = -1;
+                for (size_t i = 0; i < o.size(); i++)
+                {
+                    int r = slot[o[i]];
+                    if (r >= first_register && last_use[o[i]] == n && std::find(free_registers.begin(), free_registers.end(), r) == free_registers.end())
+                    {
+                        // the sum of a multiply add, so that it can accumulate
+                        if (node.op == OP_MULTIPLY_ADD && node.kind == CpuProgram::Instruction::OPERATION && o[i] == node.c.node && reuse < 0)
+                        {
+                            reuse = r;
+                        }
+                        else
+                        {
+                            free_registers.push_back(r);
+                        }
+                    }
+                }
+                if (reuse >= 0)
+                {
+                    slot[n] = reuse;
+                }
+                else if (!free_registers.empty())
+                {
+                    slot[n] = free_registers.back();
+                    free_registers.pop_back();
+                }
+                else
+                {
+                    slot[n] = first_register + registers++;
+                }
+
+                CpuProgram::Instruction instruction;
+                instruction.kind  = node.kind;
+                instruction.op    = node.op;
+                instruction.out   = slot[n];
+                instruction.a     = get_operand(node.a, slot);
+                instruction.b     = get_operand(node.b, slot);
+                instruction.c     = get_operand(node.c, slot);
+                instruction.plane = node.plane;
+                program.instructions.push_back(instruction);
+            }
+
+            for (int c = 0; c < 4; c++)
+            {
+                program.outputs[c] = get_operand(outputs[c], slot);
+            }
+            program.registers = registers;
+            program.footprint = footprint;
+            program.inputs    = inputs;
+        }
+
+        static CpuProgram::Operand get_operand(const Ref& ref, const std::vector<int>& slot)
+        {
+            CpuProgram::Operand operand = {ref.node >= 0 ? slot[ref.node] : -1, ref.value};
+            return operand;
+        }
+    };
+
+    CpuProgram::CpuProgram(const std::string& vertex_code, const std::string& fragment_code)
+    : registers(0), footprint(0), inputs(0)
+    {
+        GlslTranslator translator(*this);
+        translator.translate(vertex_code, fragment_code);
+    }
+
+    CpuProgram::~CpuProgram() {}
+
+    unsigned int CpuProgram::get_footprint() const
+    {
+        return footprint;
+    }
+
+    unsigned int CpuProgram::get_input_count() const
+    {
+        return inputs;
+    }
+
+    size_t CpuProgram::get_operation_count() const
+    {
+        return instructions.size();
+    }
+
+    CpuImage CpuProgram::run(const std::vector<const CpuImage*>& images) const
+    {
+        if (images.empty() || images.size() < inputs)
+        {
+            throw std::invalid_argument(compose("The shader reads %0 inputs, but got %1.", std::max(inputs, 1u), images.size()));
+        }
+        rgm::uvec2 size = images[0]->get_size();
+        for (size_t i = 1; i < images.size(); i++)
+        {
+            if (images[i]->get_size() != size)
+            {
+                throw std::invalid_argument("All inputs must have the same size.");
+            }
+        }
+        CpuImage output(size);
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return output;
+        }
+
+        TileScheduler&    scheduler = get_cpu_scheduler();
+        const CpuKernels& kernels   = get_cpu_kernels();
+
+        // the channels read, with a border of zeros for the loads
+        std::vector<std::unique_ptr<Plane>> copies;
+        unsigned int border = 0;
+        for (size_t i = 0; i < loads.size(); i++)
+        {
+            border = std::max(border, (unsigned int)std::max(std::abs(loads[i].x), std::abs(loads[i].y)));
+        }
+        for (size_t p = 0; p < planes.size(); p++)
+        {
+            copies.push_back(std::unique_ptr<Plane>(new Plane(size, border)));
+        }
+        scheduler.run_rows(size[1], [&] (unsigned int first, unsigned int count) {
+            for (size_t p = 0; p < planes.size(); p++)
+            {
+                copies[p]->copy(*images[planes[p].input], planes[p].channel, first, count);
+            }
+        });
+
+        // the registers of a few hundred pixels fit into the L1 cache
+        size_t       first_register = loads.size();
+        unsigned int span           = (unsigned int)std::min<size_t>(256, std::max<size_t>(16, 32768 / ((registers + 3) * sizeof(float)) / 16 * 16));
+
+        scheduler.run(size, footprint, (unsigned int)planes.size() + 4, [&] (const Tile& tile) {
+            std::vector<float>        scratch((registers + 3) * span);
+            std::vector<const float*> at(loads.size());
+            float*                    constants[3];
+            float                     constant_values[3] = {0.0f, 0.0f, 0.0f};
+            bool                      constant_filled[3] = {false, false, false};
+            for (int k = 0; k < 3; k++)
+            {
+                constants[k] = &scratch[(registers + k) * span];
+            }
+
+            // a constant operand is filled into one of three buffers
+            auto get = [&] (const Operand& operand, int k) -> const float* {
+                if (operand.slot < 0)
+                {
+                    if (!constant_filled[k] || float_bits(constant_values[k]) != float_bits(operand.value))
+                    {
+                        std::fill(constants[k], constants[k] + span, operand.value);
+                        constant_values[k] = operand.value;
+                        constant_filled[k] = true;
+                    }
+                    return constants[k];
+                }
+                if ((size_t)operand.slot < first_register)
+                {
+                    return at[operand.slot];
+                }
+                return &scratch[(operand.slot - first_register) * span];
+            };
+
+            unsigned int x1 = tile.origin[0] + tile.size[0];
+            for (unsigned int y = tile.origin[1]; y < tile.origin[1] + tile.size[1]; y++)
+            {
+                for (unsigned int x0 = tile.origin[0]; x0 < x1; x0 += span)
+                {
+                    unsigned int n = std::min(span, x1 - x0);
+                    for (size_t l = 0; l < loads.size(); l++)
+                    {
+                        at[l] = copies[loads[l].plane]->get_row((int)y + loads[l].y) + x0 + loads[l].x;
+                    }
+
+                    for (size_t i = 0; i < instructions.size(); i++)
+                    {
+                        const Instruction& instruction = instructions[i];
+                        float* out = &scratch[(instruction.out - first_register) * span];
+                        switch (instruction.kind)
+                        {
+                            case Instruction::COLUMN:
+                                for (unsigned int j = 0; j < n; j++)
+                                {
+                                    out[j] = (float)(x0 + j);
+                                }
+                                break;
+                            case Instruction::ROW:
+                                std::fill(out, out + n, (float)y);
+                                break;
+                            case Instruction::WIDTH:
+                                std::fill(out, out + n, (float)size[0]);
+                                break;
+                            case Instruction::HEIGHT:
+                                std::fill(out, out + n, (float)size[1]);
+                                break;
+                            case Instruction::FETCH:
+                            {
+                                const float* px    = get(instruction.a, 0);
+                                const float* py    = get(instruction.b, 1);
+                                Plane&       plane = *copies[instruction.plane];
+                                for (unsigned int j = 0; j < n; j++)
+                                {
+                                    bool inside = px[j] >= 0.0f && py[j] >= 0.0f && px[j] < (float)size[0] && py[j] < (float)size[1];
+                                    out[j] = inside ? plane.get_row((int)py[j])[(int)px[j]] : 0.0f;
+                                }
+                                break;
+                            }
+                            case Instruction::OPERATION:
+                                if (instruction.op == OP_MULTIPLY_ADD && instruction.out == instruction.c.slot && (instruction.a.slot < 0 || instruction.b.slot < 0))
+                                {
+                                    // out += weight * src
+                                    const Operand& source = instruction.a.slot < 0 ? instruction.b : instruction.a;
+                                    float          weight = instruction.a.slot < 0 ? instruction.a.value : instruction.b.value;
+                                    kernels.accumulate(out, get(source, 0), weight, n);
+                                }
+                                else if (instruction.op == OP_MULTIPLY_ADD)
+                                {
+                                    kernels.multiply_add(out, get(instruction.a, 0), get(instruction.b, 1), get(instruction.c, 2), n);
+                                }
+                                else if (instruction.op == OP_SELECT)
+                                {
+                                    kernels.select(out, get(instruction.a, 0), get(instruction.b, 1), get(instruction.c, 2), n);
+                                }
+                                else if (instruction.op >= OP_NEGATE)
+                                {
+                                    kernels.unary(out, get(instruction.a, 0), instruction.op, n);
+                                }
+                                else
+                                {
+                                    kernels.binary(out, get(instruction.a, 0), get(instruction.b, 1), instruction.op, n);
+                                }
+                                break;
+                        }
+                    }
+
+                    for (unsigned int c = 0; c < 4; c++)
+                    {
+                        float* row = output.get_row(c, y) + x0;
+                        if (outputs[c].slot < 0)
+                        {
+                            std::fill(row, row + n, outputs[c].value);
+                        }
+                        else
+                        {
+                            memcpy(row, get(outputs[c], 0), n * sizeof(float));
+                        }
+                    }
+                }
+            }
+        });
+        return output;
+    }
+}
@@ -0,0 +1,118 @@
+
+#ifndef _PKZO_CPU_PROGRAM_H_
+#define _PKZO_CPU_PROGRAM_H_
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "CpuImage.h"
+#include "CpuKernels.h"
+
+namespace pkzo
+{
+    // A fragment shader translated to run on the CPU, for the shaders that
+    // have no filter of their own in CpuFilter.h.
+    //
+    // The shader is unrolled when it is translated: loops must run a fixed
+    // number of times and indices must not depend on the pixel, and all
+    // that does not depend on the pixel is computed right there. What is
+    // left is a list of float operations, which runs a few hundred pixels
+    // of a tile's row at a time through the SIMD kernels of CpuKernels.h,
+    // on the tiles of get_cpu_scheduler(). ifs on pixel values compute
+    // both branches and select between them.
+    //
+    // The shader reads its inputs with texelFetch from uTexture or
+    // uTextureN and may use vTexCoord, gl_FragCoord, uTextureSize and
+    // textureSize. The vertex shader may pass other varyings, as long as
+    // they are the same for all vertices, like the weights of gauss.vert.
+    // Anything else, e.g. texture(), other uniforms, discard or a return
+    // under an if on pixel values, throws std::runtime_error when
+    // translating.
+    class PKZO_EXPORT CpuProgram
+    {
+    public:
+
+        // The code as it goes to the driver, see Preprocessor.h. Without
+        // vertex code only vTexCoord is passed.
+        CpuProgram(const std::string& vertex_code, const std::string& fragment_code);
+
+        ~CpuProgram();
+
+        // how far from a pixel it reads, at least its #pragma footprint
+        unsigned int get_footprint() const;
+
+        // uTexture0 .. uTextureN-1 that are read
+        unsigned int get_input_count() const;
+
+        // per pixel, after unrolling
+        size_t get_operation_count() const;
+
+        // All inputs must have the same size, that of the result.
+        CpuImage run(const std::vector<const CpuImage*>& inputs) const;
+
+    private:
+        // Where an instruction takes a value from: a slot, which is a
+        // texel near the pixel or a register, or else a constant.
+        struct Operand
+        {
+            int   slot;
+            float value;
+        };
+
+        struct Instruction
+        {
+            enum Kind
+            {
+                OPERATION,
+                // the texel of plane at a and b, 0 outside the image
+                FETCH,
+                // the pixel's x or y, the image's width or height
+                COLUMN,
+                ROW,
+                WIDTH,
+                HEIGHT
+            };
+
+            Kind         kind;
+            CpuOp        op;
+            int          out;
+            Operand      a;
+            Operand      b;
+            Operand      c;
+            unsigned int plane;
+        };
+
+        // the texel of plane at an offset from the pixel
+        struct Load
+        {
+            unsigned int plane;
+            int          x;
+            int          y;
+        };
+
+        // an input's channel
+        struct PlaneSource
+        {
+            unsigned int input;
+            unsigned int channel;
+        };
+
+        std::vector<PlaneSource> planes;
+        // slots 0 .. loads.size() - 1, the registers follow
+        std::vector<Load>        loads;
+        std::vector<Instruction> instructions;
+        unsigned int             registers;
+        // R, G, B, A
+        Operand                  outputs[4];
+        unsigned int             footprint;
+        unsigned int             inputs;
+
+        friend class GlslTranslator;
+
+        CpuProgram(const CpuProgram&) = delete;
+        const CpuProgram& operator = (const CpuProgram&) = delete;
+    };
+}
+
+#endif
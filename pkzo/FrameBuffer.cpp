@@ -1,17 +1,26 @@
 ﻿
 #include "FrameBuffer.h"
 
+#include <stdexcept>
 #include <GL/glew.h>
 
 namespace pkzo
 {
-    FrameBuffer::FrameBuffer(rgm::uvec2 s)
-    : id(0), size(s), depth(size, DEPTH), color(size, RGBA)
+    FrameBuffer::FrameBuffer(rgm::uvec2 s, ColorFormat format, bool d)
+    : id(0), size(s), color(size, format)
     {
+        if (d)
+        {
+            depth = Texture(size, DEPTH);
+        }
+
         glGenFramebuffers(1, &id);
         glBindFramebuffer(GL_FRAMEBUFFER, id);
                 
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.get_glid(), 0);        
+        if (d)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.get_glid(), 0);        
+        }
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.get_glid(), 0);
         
         glBindFramebuffer(GL_FRAMEBUFFER, 0);    
@@ -23,8 +32,27 @@ namespace pkzo
         glDeleteFramebuffers(1, &id);
     }
 
+    rgm::uvec2 FrameBuffer::get_size() const
+    {
+        return size;
+    }
+
+    ColorFormat FrameBuffer::get_format() const
+    {
+        return color.get_format();
+    }
+
+    bool FrameBuffer::has_depth() const
+    {
+        return depth.get_format() == DEPTH;
+    }
+
     Texture& FrameBuffer::get_depth()
     {
+        if (!has_depth())
+        {
+            throw std::logic_error("The frame buffer has no depth attachment.");
+        }
         return depth;
     }
 
@@ -42,6 +70,6 @@ namespace pkzo
     void FrameBuffer::clear()
     {
         glClearColor(1, 0, 0, 1);
-        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+        glClear(has_depth() ? GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT);
     }
 }
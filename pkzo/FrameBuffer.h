@@ -13,7 +13,9 @@ namespace pkzo
     {
     public:
         
-        FrameBuffer(rgm::uvec2 size);
+        // Image filters have no use for a depth buffer; without one the 
+        // frame buffer is just the color texture.
+        FrameBuffer(rgm::uvec2 size, ColorFormat format = RGBA, bool depth = true);
 
         FrameBuffer(const FrameBuffer&) = delete;
 
@@ -21,6 +23,12 @@ namespace pkzo
 
         const FrameBuffer& operator = (const FrameBuffer&) = delete;
 
+        rgm::uvec2 get_size() const;
+
+        ColorFormat get_format() const;
+
+        bool has_depth() const;
+
         Texture& get_depth();
 
         Texture& get_color();        
@@ -0,0 +1,1254 @@
+
+#include "GlslParser.h"
+
+#include <set>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "compose.h"
+
+namespace pkzo
+{
+    struct GlslToken
+    {
+        enum Kind
+        {
+            IDENTIFIER,
+            INTEGER,
+            FLOAT,
+            PUNCTUATOR,
+            END
+        };
+
+        Kind         kind;
+        std::string  text;
+        double       value;
+        bool         unsigned_integer;
+        unsigned int line;
+    };
+
+    struct GlslMacro
+    {
+        bool                     function;
+        std::vector<std::string> parameters;
+        std::vector<GlslToken>   body;
+    };
+
+    // longest first
+    const char* punctuators[] = {
+        "<<=", ">>=",
+        "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "^^",
+        "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+        "(", ")", "{", "}", "[", "]", ";", ",", ".", "+", "-", "*", "/", "%",
+        "<", ">", "=", "!", "~", "&", "|", "^", "?", ":", "#"
+    };
+
+    const char* type_names[] = {
+        "void", "bool", "int", "uint", "float",
+        "vec2", "vec3", "vec4", "ivec2", "ivec3", "ivec4",
+        "uvec2", "uvec3", "uvec4", "bvec2", "bvec3", "bvec4",
+        "mat2", "mat3", "mat4", "mat2x2", "mat2x3", "mat2x4",
+        "mat3x2", "mat3x3", "mat3x4", "mat4x2", "mat4x3", "mat4x4",
+        "sampler2D", "isampler2D", "usampler2D"
+    };
+
+    bool is_type_name(const std::string& name)
+    {
+        for (size_t i = 0; i < sizeof(type_names) / sizeof(type_names[0]); i++)
+        {
+            if (name == type_names[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_qualifier(const std::string& name)
+    {
+        static const std::set<std::string> qualifiers = {
+            "uniform", "in", "out", "inout", "const", "attribute", "varying",
+            "flat", "smooth", "noperspective", "centroid", "invariant",
+            "highp", "mediump", "lowp"
+        };
+        return qualifiers.count(name) != 0;
+    }
+
+    void syntax_error(unsigned int line, const std::string& message)
+    {
+        throw std::runtime_error(compose("line %0: %1", line, message));
+    }
+
+    class GlslParser
+    {
+    public:
+
+        GlslParser(const std::string& code)
+        : position(0)
+        {
+            preprocess(code);
+        }
+
+        GlslShader parse()
+        {
+            while (peek().kind != GlslToken::END)
+            {
+                parse_external();
+            }
+            return shader;
+        }
+
+    private:
+        GlslShader                       shader;
+        std::map<std::string, GlslMacro> macros;
+        std::vector<GlslToken>           tokens;
+        size_t                           position;
+
+        // Preprocessor
+
+        // Comments become a space, or the line breaks they span.
+        static std::string strip(const std::string& code)
+        {
+            std::string out;
+            for (size_t i = 0; i < code.size(); i++)
+            {
+                if (code.compare(i, 2, "//") == 0)
+                {
+                    while (i < code.size() && code[i] != '\n')
+                    {
+                        i++;
+                    }
+                    out += '\n';
+                }
+                else if (code.compare(i, 2, "/*") == 0)
+                {
+                    out += ' ';
+                    for (i += 2; i < code.size() && code.compare(i, 2, "*/") != 0; i++)
+                    {
+                        if (code[i] == '\n')
+                        {
+                            out += '\n';
+                        }
+                    }
+                    i++;
+                }
+                else
+                {
+                    out += code[i];
+                }
+            }
+            return out;
+        }
+
+        static void lex(const std::string& text, unsigned int line, std::vector<GlslToken>& out)
+        {
+            size_t i = 0;
+            while (i < text.size())
+            {
+                char c = text[i];
+                if (isspace((unsigned char)c))
+                {
+                    i++;
+                    continue;
+                }
+
+                GlslToken token = {GlslToken::PUNCTUATOR, "", 0.0, false, line};
+                if (isalpha((unsigned char)c) || c == '_')
+                {
+                    size_t start = i;
+                    while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_'))
+                    {
+                        i++;
+                    }
+                    token.kind = GlslToken::IDENTIFIER;
+                    token.text = text.substr(start, i - start);
+                }
+                else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < text.size() && isdigit((unsigned char)text[i + 1])))
+                {
+                    size_t start = i;
+                    bool   real  = false;
+                    if (text.compare(i, 2, "0x") == 0 || text.compare(i, 2, "0X") == 0)
+                    {
+                        i += 2;
+                        while (i < text.size() && isxdigit((unsigned char)text[i]))
+                        {
+                            i++;
+                        }
+                    }
+                    else
+                    {
+                        while (i < text.size() && (isdigit((unsigned char)text[i]) || text[i] == '.'))
+                        {
+                            real = real || text[i] == '.';
+                            i++;
+                        }
+                        if (i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+                        {
+                            real = true;
+                            i++;
+                            if (i < text.size() && (text[i] == '+' || text[i] == '-'))
+                            {
+                                i++;
+                            }
+                            while (i < text.size() && isdigit((unsigned char)text[i]))
+                            {
+                                i++;
+                            }
+                        }
+                    }
+                    token.text = text.substr(start, i - start);
+
+                    if (i < text.size() && (text[i] == 'f' || text[i] == 'F'))
+                    {
+                        real = true;
+                        i++;
+                    }
+                    else if (text.compare(i, 2, "lf") == 0 || text.compare(i, 2, "LF") == 0)
+                    {
+                        real = true;
+                        i += 2;
+                    }
+                    else if (i < text.size() && (text[i] == 'u' || text[i] == 'U'))
+                    {
+                        token.unsigned_integer = true;
+                        i++;
+                    }
+
+                    if (real)
+                    {
+                        token.kind  = GlslToken::FLOAT;
+                        token.value = std::strtod(token.text.c_str(), NULL);
+                    }
+                    else
+                    {
+                        // a leading 0 is octal
+                        token.kind  = GlslToken::INTEGER;
+                        token.value = (double)std::strtoul(token.text.c_str(), NULL, 0);
+                    }
+                }
+                else
+                {
+                    for (size_t p = 0; p < sizeof(punctuators) / sizeof(punctuators[0]); p++)
+                    {
+                        if (text.compare(i, strlen(punctuators[p]), punctuators[p]) == 0)
+                        {
+                            token.text = punctuators[p];
+                            break;
+                        }
+                    }
+                    if (token.text.empty())
+                    {
+                        syntax_error(line, compose("Unexpected character '%0'.", c));
+                    }
+                    i += token.text.size();
+                }
+                out.push_back(token);
+            }
+        }
+
+        // Replace the macros in tokens, except those being expanded.
+        void expand(const std::vector<GlslToken>& in, std::vector<GlslToken>& out, std::set<std::string>& active)
+        {
+            for (size_t i = 0; i < in.size(); i++)
+            {
+                const GlslToken& token = in[i];
+                auto macro = macros.find(token.text);
+                if (token.kind != GlslToken::IDENTIFIER || macro == macros.end() || active.count(token.text))
+                {
+                    out.push_back(token);
+                    continue;
+                }
+
+                const GlslMacro& m = macro->second;
+                std::vector<GlslToken> body;
+                if (m.function)
+                {
+                    if (i + 1 >= in.size() || in[i + 1].text != "(")
+                    {
+                        out.push_back(token);
+                        continue;
+                    }
+
+                    // the arguments, split at commas outside parentheses
+                    std::vector<std::vector<GlslToken>> arguments(1);
+                    int depth = 0;
+                    for (i += 2; ; i++)
+                    {
+                        if (i >= in.size())
+                        {
+                            syntax_error(token.line, compose("Unterminated call of macro %0.", token.text));
+                        }
+                        if (in[i].text == ")" && depth == 0)
+                        {
+                            break;
+                        }
+                        if (in[i].text == "," && depth == 0)
+                        {
+                            arguments.push_back(std::vector<GlslToken>());
+                            continue;
+                        }
+                        depth += in[i].text == "(" ? 1 : in[i].text == ")" ? -1 : 0;
+                        arguments.back().push_back(in[i]);
+                    }
+                    if (m.parameters.empty() && arguments.size() == 1 && arguments[0].empty())
+                    {
+                        arguments.clear();
+                    }
+                    if (arguments.size() != m.parameters.size())
+                    {
+                        syntax_error(token.line, compose("Macro %0 takes %1 arguments.", token.text, m.parameters.size()));
+                    }
+
+                    for (size_t b = 0; b < m.body.size(); b++)
+                    {
+                        size_t p = 0;
+                        while (p < m.parameters.size() && (m.body[b].kind != GlslToken::IDENTIFIER || m.body[b].text != m.parameters[p]))
+                        {
+                            p++;
+                        }
+                        if (p < m.parameters.size())
+                        {
+                            expand(arguments[p], body, active);
+                        }
+                        else
+                        {
+                            body.push_back(m.body[b]);
+                        }
+                    }
+                }
+                else
+                {
+                    body = m.body;
+                }
+
+                for (size_t b = 0; b < body.size(); b++)
+                {
+                    body[b].line = token.line;
+                }
+                active.insert(token.text);
+                expand(body, out, active);
+                active.erase(token.text);
+            }
+        }
+
+        void expand(const std::vector<GlslToken>& in, std::vector<GlslToken>& out)
+        {
+            std::set<std::string> active;
+            expand(in, out, active);
+        }
+
+        // The value of #if and #pragma footprint, integers only.
+        long long evaluate(const std::vector<GlslToken>& in, unsigned int line)
+        {
+            // defined must be resolved before macros are expanded
+            std::vector<GlslToken> resolved;
+            for (size_t i = 0; i < in.size(); i++)
+            {
+                if (in[i].text == "defined")
+                {
+                    bool   parenthesis = i + 1 < in.size() && in[i + 1].text == "(";
+                    size_t name        = i + (parenthesis ? 2 : 1);
+                    if (name >= in.size() || in[name].kind != GlslToken::IDENTIFIER)
+                    {
+                        syntax_error(line, "defined needs a name.");
+                    }
+                    GlslToken value = {GlslToken::INTEGER, "", macros.count(in[name].text) ? 1.0 : 0.0, false, line};
+                    resolved.push_back(value);
+                    i = name + (parenthesis ? 1 : 0);
+                }
+                else
+                {
+                    resolved.push_back(in[i]);
+                }
+            }
+
+            std::vector<GlslToken> expanded;
+            expand(resolved, expanded);
+
+            size_t    p      = 0;
+            long long result = evaluate(expanded, p, 0, line);
+            if (p != expanded.size())
+            {
+                syntax_error(line, "Invalid preprocessor expression.");
+            }
+            return result;
+        }
+
+        static int precedence(const std::string& op)
+        {
+            static const char* levels[][4] = {
+                {"||"}, {"&&"}, {"|"}, {"^"}, {"&"}, {"==", "!="},
+                {"<", ">", "<=", ">="}, {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"}
+            };
+            for (int l = 0; l < 10; l++)
+            {
+                for (int o = 0; o < 4 && levels[l][o] != NULL; o++)
+                {
+                    if (op == levels[l][o])
+                    {
+                        return l + 1;
+                    }
+                }
+            }
+            return 0;
+        }
+
+        static long long evaluate(const std::vector<GlslToken>& in, size_t& p, int level, unsigned int line)
+        {
+            if (p >= in.size())
+            {
+                syntax_error(line, "Invalid preprocessor expression.");
+            }
+
+            long long left = 0;
+            const GlslToken& token = in[p++];
+            if (token.text == "(")
+            {
+                left = evaluate(in, p, 0, line);
+                if (p >= in.size() || in[p++].text != ")")
+                {
+                    syntax_error(line, "Missing ) in preprocessor expression.");
+                }
+            }
+            else if (token.text == "-" || token.text == "+" || token.text == "!" || token.text == "~")
+            {
+                long long value = evaluate(in, p, 11, line);
+                left = token.text == "-" ? -value : token.text == "+" ? value : token.text == "!" ? !value : ~value;
+            }
+            else if (token.kind == GlslToken::INTEGER)
+            {
+                left = (long long)token.value;
+            }
+            else if (token.kind != GlslToken::IDENTIFIER)
+            {
+                syntax_error(line, compose("Unexpected %0 in preprocessor expression.", token.text));
+            }
+
+            while (p < in.size())
+            {
+                const std::string& op = in[p].text;
+                int l = precedence(op);
+                if (l == 0 || l <= level)
+                {
+                    break;
+                }
+                p++;
+                long long right = evaluate(in, p, l, line);
+                if ((op == "/" || op == "%") && right == 0)
+                {
+                    syntax_error(line, "Division by zero in preprocessor expression.");
+                }
+                left = op == "||" ? (left || right) : op == "&&" ? (left && right) :
+                       op == "|" ? (left | right) : op == "^" ? (left ^ right) : op == "&" ? (left & right) :
+                       op == "==" ? (left == right) : op == "!=" ? (left != right) :
+                       op == "<" ? (left < right) : op == ">" ? (left > right) :
+                       op == "<=" ? (left <= right) : op == ">=" ? (left >= right) :
+                       op == "<<" ? (left << right) : op == ">>" ? (left >> right) :
+                       op == "+" ? (left + right) : op == "-" ? (left - right) :
+                       op == "*" ? (left * right) : op == "/" ? (left / right) : (left % right);
+            }
+            return left;
+        }
+
+        struct Condition
+        {
+            // this branch is taken, one before was, the one outside is
+            bool active;
+            bool taken;
+            bool outer;
+        };
+
+        void preprocess(const std::string& code)
+        {
+            std::istringstream     in(strip(code));
+            std::string            text;
+            unsigned int           line = 0;
+            std::vector<Condition> conditions;
+
+            while (std::getline(in, text))
+            {
+                line++;
+                unsigned int first = line;
+                while (!text.empty() && text[text.size() - 1] == '\\')
+                {
+                    std::string more;
+                    if (!std::getline(in, more))
+                    {
+                        break;
+                    }
+                    text = text.substr(0, text.size() - 1) + more;
+                    line++;
+                }
+
+                bool active = conditions.empty() || conditions.back().active;
+
+                size_t hash = text.find_first_not_of(" \t\r");
+                if (hash == std::string::npos || text[hash] != '#')
+                {
+                    if (active)
+                    {
+                        std::vector<GlslToken> raw;
+                        lex(text, first, raw);
+                        expand(raw, tokens);
+                    }
+                    continue;
+                }
+
+                std::vector<GlslToken> directive;
+                lex(text.substr(hash + 1), first, directive);
+                if (directive.empty())
+                {
+                    continue;
+                }
+                std::string name = directive[0].text;
+                std::vector<GlslToken> rest(directive.begin() + 1, directive.end());
+
+                if (name == "ifdef" || name == "ifndef" || name == "if")
+                {
+                    bool value = false;
+                    if (active)
+                    {
+                        if (name == "if")
+                        {
+                            value = evaluate(rest, first) != 0;
+                        }
+                        else
+                        {
+                            if (rest.empty())
+                            {
+                                syntax_error(first, compose("#%0 needs a name.", name));
+                            }
+                            value = macros.count(rest[0].text) != 0;
+                            value = name == "ifdef" ? value : !value;
+                        }
+                    }
+                    Condition c = {active && value, active && value, active};
+                    conditions.push_back(c);
+                }
+                else if (name == "elif" || name == "else")
+                {
+                    if (conditions.empty())
+                    {
+                        syntax_error(first, compose("#%0 without #if.", name));
+                    }
+                    Condition& c = conditions.back();
+                    bool value = !c.taken && c.outer && (name == "else" || evaluate(rest, first) != 0);
+                    c.active = value;
+                    c.taken  = c.taken || value;
+                }
+                else if (name == "endif")
+                {
+                    if (conditions.empty())
+                    {
+                        syntax_error(first, "#endif without #if.");
+                    }
+                    conditions.pop_back();
+                }
+                else if (!active)
+                {
+                    continue;
+                }
+                else if (name == "define")
+                {
+                    if (rest.empty() || rest[0].kind != GlslToken::IDENTIFIER)
+                    {
+                        syntax_error(first, "#define needs a name.");
+                    }
+
+                    // a function like macro has its ( right after the name
+                    GlslMacro macro;
+                    macro.function = false;
+                    size_t body  = 1;
+                    size_t after = text.find(rest[0].text, text.find("define", hash) + 6) + rest[0].text.size();
+                    if (rest.size() > 1 && rest[1].text == "(" && after < text.size() && text[after] == '(')
+                    {
+                        macro.function = true;
+                        for (body = 2; body < rest.size() && rest[body].text != ")"; body++)
+                        {
+                            if (rest[body].kind == GlslToken::IDENTIFIER)
+                            {
+                                macro.parameters.push_back(rest[body].text);
+                            }
+                        }
+                        body++;
+                    }
+                    if (body < rest.size())
+                    {
+                        macro.body.assign(rest.begin() + body, rest.end());
+                    }
+                    macros[rest[0].text] = macro;
+                }
+                else if (name == "undef")
+                {
+                    if (!rest.empty())
+                    {
+                        macros.erase(rest[0].text);
+                    }
+                }
+                else if (name == "error")
+                {
+                    size_t start = text.find("error", hash) + 5;
+                    std::string message = text.substr(start);
+                    message.erase(0, message.find_first_not_of(" \t"));
+                    syntax_error(first, message);
+                }
+                else if (name == "line")
+                {
+                    // the next line has that number
+                    if (!rest.empty() && rest[0].kind == GlslToken::INTEGER)
+                    {
+                        line = (unsigned int)rest[0].value - 1;
+                    }
+                }
+                else if (name == "pragma")
+                {
+                    if (rest.size() >= 3 && rest[0].text == "footprint" && rest[1].text == "(" && rest.back().text == ")")
+                    {
+                        std::vector<GlslToken> value(rest.begin() + 2, rest.end() - 1);
+                        long long footprint = evaluate(value, first);
+                        shader.footprints.push_back((unsigned int)std::max(footprint, 0ll));
+                    }
+                }
+                else if (name != "version" && name != "extension")
+                {
+                    syntax_error(first, compose("Unknown directive #%0.", name));
+                }
+            }
+
+            if (!conditions.empty())
+            {
+                syntax_error(line, "Missing #endif.");
+            }
+
+            GlslToken end = {GlslToken::END, "end of file", 0.0, false, line};
+            tokens.push_back(end);
+        }
+
+        // Parser
+
+        const GlslToken& peek(size_t ahead = 0) const
+        {
+            return tokens[std::min(position + ahead, tokens.size() - 1)];
+        }
+
+        const GlslToken& next()
+        {
+            const GlslToken& token = peek();
+            if (position < tokens.size() - 1)
+            {
+                position++;
+            }
+            return token;
+        }
+
+        bool accept(const std::string& text)
+        {
+            if (peek().kind != GlslToken::END && peek().text == text)
+            {
+                next();
+                return true;
+            }
+            return false;
+        }
+
+        void expect(const std::string& text)
+        {
+            if (!accept(text))
+            {
+                syntax_error(peek().line, compose("Expected %0 but got %1.", text, peek().text));
+            }
+        }
+
+        std::string parse_identifier()
+        {
+            if (peek().kind != GlslToken::IDENTIFIER)
+            {
+                syntax_error(peek().line, compose("Expected a name but got %0.", peek().text));
+            }
+            return next().text;
+        }
+
+        // layout(...) and the qualifiers before a type; returns the storage
+        void parse_qualifiers(std::string& storage)
+        {
+            while (true)
+            {
+                if (peek().text == "layout")
+                {
+                    next();
+                    expect("(");
+                    int depth = 1;
+                    while (depth > 0 && peek().kind != GlslToken::END)
+                    {
+                        const GlslToken& token = next();
+                        depth += token.text == "(" ? 1 : token.text == ")" ? -1 : 0;
+                    }
+                }
+                else if (peek().kind == GlslToken::IDENTIFIER && is_qualifier(peek().text))
+                {
+                    std::string q = next().text;
+                    if (q == "uniform" || q == "in" || q == "out" || q == "inout" || q == "const" || q == "attribute" || q == "varying")
+                    {
+                        storage = q == "attribute" ? "in" : q;
+                    }
+                }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        GlslType parse_type()
+        {
+            if (peek().text == "struct")
+            {
+                syntax_error(peek().line, "Structs are not supported.");
+            }
+            GlslType type;
+            type.name  = parse_identifier();
+            type.array = false;
+            if (!is_type_name(type.name))
+            {
+                syntax_error(peek().line, compose("Unknown type %0.", type.name));
+            }
+            parse_array(type);
+            return type;
+        }
+
+        void parse_array(GlslType& type)
+        {
+            if (accept("["))
+            {
+                type.array = true;
+                if (!accept("]"))
+                {
+                    type.array_size = parse_expression();
+                    expect("]");
+                }
+            }
+        }
+
+        void parse_external()
+        {
+            unsigned int line = peek().line;
+            if (accept(";"))
+            {
+                return;
+            }
+            if (accept("precision"))
+            {
+                while (!accept(";"))
+                {
+                    next();
+                }
+                return;
+            }
+
+            std::string storage;
+            parse_qualifiers(storage);
+            // e.g. layout(local_size_x = 16) in;
+            if (accept(";"))
+            {
+                return;
+            }
+
+            if (peek().kind == GlslToken::IDENTIFIER && !is_type_name(peek().text) && peek(1).text == "{")
+            {
+                syntax_error(line, "Interface blocks are not supported.");
+            }
+
+            GlslType type = parse_type();
+            std::string name = parse_identifier();
+
+            if (peek().text == "(")
+            {
+                parse_function(type, name, line);
+                return;
+            }
+
+            std::vector<GlslDeclarator> declarators;
+            parse_declarators(type, name, declarators);
+            for (size_t i = 0; i < declarators.size(); i++)
+            {
+                GlslGlobal global = {storage, declarators[i], line};
+                shader.globals.push_back(global);
+            }
+        }
+
+        void parse_function(const GlslType& type, const std::string& name, unsigned int line)
+        {
+            GlslFunction function;
+            function.name = name;
+            function.type = type;
+            function.line = line;
+
+            expect("(");
+            if (peek().text == "void" && peek(1).text == ")")
+            {
+                next();
+            }
+            while (!accept(")"))
+            {
+                if (!function.parameters.empty())
+                {
+                    expect(",");
+                }
+
+                std::string direction = "in";
+                parse_qualifiers(direction);
+                if (direction == "const")
+                {
+                    direction = "in";
+                }
+
+                GlslParameter parameter;
+                parameter.type      = parse_type();
+                parameter.direction = direction;
+                if (peek().kind == GlslToken::IDENTIFIER)
+                {
+                    parameter.name = next().text;
+                }
+                parse_array(parameter.type);
+                function.parameters.push_back(parameter);
+            }
+
+            // a prototype has no body
+            if (!accept(";"))
+            {
+                function.body = parse_block();
+                shader.functions.push_back(function);
+            }
+        }
+
+        void parse_declarators(const GlslType& type, std::string name, std::vector<GlslDeclarator>& declarators)
+        {
+            while (true)
+            {
+                GlslDeclarator declarator;
+                declarator.name = name;
+                declarator.type = type;
+                if (!type.array)
+                {
+                    parse_array(declarator.type);
+                }
+                if (accept("="))
+                {
+                    declarator.initializer = parse_assignment();
+                }
+                declarators.push_back(declarator);
+
+                if (!accept(","))
+                {
+                    break;
+                }
+                name = parse_identifier();
+            }
+            expect(";");
+        }
+
+        GlslStatementPtr make_statement(GlslStatement::Kind kind, unsigned int line)
+        {
+            GlslStatementPtr statement = std::make_shared<GlslStatement>();
+            statement->kind = kind;
+            statement->line = line;
+            return statement;
+        }
+
+        GlslStatementPtr parse_block()
+        {
+            GlslStatementPtr block = make_statement(GlslStatement::BLOCK, peek().line);
+            expect("{");
+            while (!accept("}"))
+            {
+                if (peek().kind == GlslToken::END)
+                {
+                    syntax_error(peek().line, "Missing }.");
+                }
+                block->statements.push_back(parse_statement());
+            }
+            return block;
+        }
+
+        bool is_declaration() const
+        {
+            const GlslToken& token = peek();
+            if (token.kind != GlslToken::IDENTIFIER)
+            {
+                return false;
+            }
+            if (token.text == "const" || token.text == "highp" || token.text == "mediump" || token.text == "lowp" || token.text == "struct")
+            {
+                return true;
+            }
+            // float x or float[3] x, not float(x) or float[3](x)
+            if (!is_type_name(token.text))
+            {
+                return false;
+            }
+            if (peek(1).kind == GlslToken::IDENTIFIER)
+            {
+                return true;
+            }
+            if (peek(1).text == "[")
+            {
+                size_t i = 2;
+                while (peek(i).text != "]" && peek(i).kind != GlslToken::END)
+                {
+                    i++;
+                }
+                return peek(i + 1).kind == GlslToken::IDENTIFIER;
+            }
+            return false;
+        }
+
+        GlslStatementPtr parse_declaration()
+        {
+            GlslStatementPtr statement = make_statement(GlslStatement::DECLARATION, peek().line);
+            std::string storage;
+            parse_qualifiers(storage);
+            GlslType type = parse_type();
+            parse_declarators(type, parse_identifier(), statement->declarators);
+            return statement;
+        }
+
+        GlslStatementPtr parse_statement()
+        {
+            unsigned int line = peek().line;
+            if (peek().text == "{")
+            {
+                return parse_block();
+            }
+            if (accept(";"))
+            {
+                return make_statement(GlslStatement::EMPTY, line);
+            }
+            if (accept("if"))
+            {
+                GlslStatementPtr statement = make_statement(GlslStatement::IF, line);
+                expect("(");
+                statement->expression = parse_expression();
+                expect(")");
+                statement->statements.push_back(parse_statement());
+                statement->statements.push_back(accept("else") ? parse_statement() : GlslStatementPtr());
+                return statement;
+            }
+            if (accept("for"))
+            {
+                GlslStatementPtr statement = make_statement(GlslStatement::FOR, line);
+                expect("(");
+                if (accept(";"))
+                {
+                    statement->statements.push_back(GlslStatementPtr());
+                }
+                else if (is_declaration())
+                {
+                    statement->statements.push_back(parse_declaration());
+                }
+                else
+                {
+                    GlslStatementPtr init = make_statement(GlslStatement::EXPRESSION, line);
+                    init->expression = parse_expression();
+                    expect(";");
+                    statement->statements.push_back(init);
+                }
+                if (peek().text != ";")
+                {
+                    statement->expression = parse_expression();
+                }
+                expect(";");
+                if (peek().text != ")")
+                {
+                    statement->step = parse_expression();
+                }
+                expect(")");
+                statement->statements.push_back(parse_statement());
+                return statement;
+            }
+            if (accept("while"))
+            {
+                GlslStatementPtr statement = make_statement(GlslStatement::WHILE, line);
+                expect("(");
+                statement->expression = parse_expression();
+                expect(")");
+                statement->statements.push_back(parse_statement());
+                return statement;
+            }
+            if (accept("do"))
+            {
+                GlslStatementPtr statement = make_statement(GlslStatement::DO, line);
+                statement->statements.push_back(parse_statement());
+                expect("while");
+                expect("(");
+                statement->expression = parse_expression();
+                expect(")");
+                expect(";");
+                return statement;
+            }
+            if (accept("return"))
+            {
+                GlslStatementPtr statement = make_statement(GlslStatement::RETURN, line);
+                if (!accept(";"))
+                {
+                    statement->expression = parse_expression();
+                    expect(";");
+                }
+                return statement;
+            }
+            if (accept("break") || accept("continue") || accept("discard"))
+            {
+                const std::string& keyword = tokens[position - 1].text;
+                GlslStatementPtr statement = make_statement(keyword == "break" ? GlslStatement::BREAK : keyword == "continue" ? GlslStatement::CONTINUE : GlslStatement::DISCARD, line);
+                expect(";");
+                return statement;
+            }
+            if (peek().text == "switch")
+            {
+                syntax_error(line, "switch is not supported.");
+            }
+            if (is_declaration())
+            {
+                return parse_declaration();
+            }
+
+            GlslStatementPtr statement = make_statement(GlslStatement::EXPRESSION, line);
+            statement->expression = parse_expression();
+            expect(";");
+            return statement;
+        }
+
+        GlslExpressionPtr make_expression(GlslExpression::Kind kind, unsigned int line)
+        {
+            GlslExpressionPtr expression = std::make_shared<GlslExpression>();
+            expression->kind             = kind;
+            expression->value            = 0.0;
+            expression->integer          = false;
+            expression->unsigned_integer = false;
+            expression->boolean          = false;
+            expression->array            = false;
+            expression->line             = line;
+            return expression;
+        }
+
+        GlslExpressionPtr make_binary(GlslExpression::Kind kind, const std::string& op, GlslExpressionPtr left, GlslExpressionPtr right)
+        {
+            GlslExpressionPtr expression = make_expression(kind, left->line);
+            expression->op = op;
+            expression->operands.push_back(left);
+            expression->operands.push_back(right);
+            return expression;
+        }
+
+        GlslExpressionPtr parse_expression()
+        {
+            GlslExpressionPtr left = parse_assignment();
+            while (peek().text == ",")
+            {
+                next();
+                left = make_binary(GlslExpression::BINARY, ",", left, parse_assignment());
+            }
+            return left;
+        }
+
+        GlslExpressionPtr parse_assignment()
+        {
+            GlslExpressionPtr left = parse_conditional();
+            static const std::set<std::string> assignments = {"=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|="};
+            if (peek().kind == GlslToken::PUNCTUATOR && assignments.count(peek().text))
+            {
+                std::string op = next().text;
+                return make_binary(GlslExpression::ASSIGN, op, left, parse_assignment());
+            }
+            return left;
+        }
+
+        GlslExpressionPtr parse_conditional()
+        {
+            GlslExpressionPtr condition = parse_binary(0);
+            if (!accept("?"))
+            {
+                return condition;
+            }
+            GlslExpressionPtr expression = make_expression(GlslExpression::CONDITIONAL, condition->line);
+            expression->operands.push_back(condition);
+            expression->operands.push_back(parse_expression());
+            expect(":");
+            expression->operands.push_back(parse_assignment());
+            return expression;
+        }
+
+        static int binary_precedence(const GlslToken& token)
+        {
+            if (token.kind != GlslToken::PUNCTUATOR)
+            {
+                return 0;
+            }
+            static const char* levels[][4] = {
+                {"||"}, {"^^"}, {"&&"}, {"|"}, {"^"}, {"&"}, {"==", "!="},
+                {"<", ">", "<=", ">="}, {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"}
+            };
+            for (int l = 0; l < 11; l++)
+            {
+                for (int o = 0; o < 4 && levels[l][o] != NULL; o++)
+                {
+                    if (token.text == levels[l][o])
+                    {
+                        return l + 1;
+                    }
+                }
+            }
+            return 0;
+        }
+
+        GlslExpressionPtr parse_binary(int level)
+        {
+            GlslExpressionPtr left = parse_unary();
+            while (true)
+            {
+                int l = binary_precedence(peek());
+                if (l == 0 || l <= level)
+                {
+                    return left;
+                }
+                std::string op = next().text;
+                left = make_binary(GlslExpression::BINARY, op, left, parse_binary(l));
+            }
+        }
+
+        GlslExpressionPtr parse_unary()
+        {
+            const GlslToken& token = peek();
+            if (token.kind == GlslToken::PUNCTUATOR && (token.text == "++" || token.text == "--" || token.text == "+" || token.text == "-" || token.text == "!" || token.text == "~"))
+            {
+                GlslExpressionPtr expression = make_expression(GlslExpression::UNARY, token.line);
+                expression->op = next().text;
+                expression->operands.push_back(parse_unary());
+                return expression;
+            }
+            return parse_postfix(parse_primary());
+        }
+
+        GlslExpressionPtr parse_postfix(GlslExpressionPtr expression)
+        {
+            while (true)
+            {
+                unsigned int line = peek().line;
+                if (accept("["))
+                {
+                    expression = make_binary(GlslExpression::INDEX, "[]", expression, parse_expression());
+                    expect("]");
+                }
+                else if (accept("."))
+                {
+                    GlslExpressionPtr member = make_expression(GlslExpression::MEMBER, line);
+                    member->name = parse_identifier();
+                    member->operands.push_back(expression);
+                    // only .length()
+                    if (accept("("))
+                    {
+                        expect(")");
+                        member->name += "()";
+                    }
+                    expression = member;
+                }
+                else if (peek().text == "++" || peek().text == "--")
+                {
+                    GlslExpressionPtr postfix = make_expression(GlslExpression::POSTFIX, line);
+                    postfix->op = next().text;
+                    postfix->operands.push_back(expression);
+                    expression = postfix;
+                }
+                else
+                {
+                    return expression;
+                }
+            }
+        }
+
+        GlslExpressionPtr parse_primary()
+        {
+            const GlslToken& token = next();
+            switch (token.kind)
+            {
+                case GlslToken::INTEGER:
+                case GlslToken::FLOAT:
+                {
+                    GlslExpressionPtr literal = make_expression(GlslExpression::LITERAL, token.line);
+                    literal->value            = token.value;
+                    literal->integer          = token.kind == GlslToken::INTEGER;
+                    literal->unsigned_integer = token.unsigned_integer;
+                    return literal;
+                }
+                case GlslToken::IDENTIFIER:
+                {
+                    if (token.text == "true" || token.text == "false")
+                    {
+                        GlslExpressionPtr literal = make_expression(GlslExpression::LITERAL, token.line);
+                        literal->value   = token.text == "true" ? 1.0 : 0.0;
+                        literal->boolean = true;
+                        return literal;
+                    }
+
+                    GlslExpressionPtr expression = make_expression(GlslExpression::NAME, token.line);
+                    expression->name = token.text;
+
+                    // mat3[](...) or float[2](...)
+                    if (is_type_name(token.text) && peek().text == "[")
+                    {
+                        next();
+                        expression->array = true;
+                        if (!accept("]"))
+                        {
+                            expression->array_size = parse_expression();
+                            expect("]");
+                        }
+                        if (peek().text != "(")
+                        {
+                            syntax_error(token.line, "Expected ( after an array type.");
+                        }
+                    }
+
+                    if (accept("("))
+                    {
+                        expression->kind = GlslExpression::CALL;
+                        if (peek().text == "void" && peek(1).text == ")")
+                        {
+                            next();
+                        }
+                        while (!accept(")"))
+                        {
+                            if (!expression->operands.empty())
+                            {
+                                expect(",");
+                            }
+                            expression->operands.push_back(parse_assignment());
+                        }
+                    }
+                    return expression;
+                }
+                case GlslToken::PUNCTUATOR:
+                    if (token.text == "(")
+                    {
+                        GlslExpressionPtr expression = parse_expression();
+                        expect(")");
+                        return expression;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            syntax_error(token.line, compose("Unexpected %0.", token.text));
+            return GlslExpressionPtr();
+        }
+    };
+
+    GlslShader parse_glsl(const std::string& code)
+    {
+        GlslParser parser(code);
+        return parser.parse();
+    }
+}
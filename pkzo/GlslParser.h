@@ -0,0 +1,154 @@
+
+#ifndef _PKZO_GLSL_PARSER_H_
+#define _PKZO_GLSL_PARSER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pkzo
+{
+    // The syntax tree of a shader, as far as CpuProgram understands GLSL:
+    // expressions, declarations, if, loops and functions, but no structs,
+    // interface blocks or preprocessor left.
+
+    struct GlslExpression;
+    struct GlslStatement;
+
+    typedef std::shared_ptr<GlslExpression> GlslExpressionPtr;
+    typedef std::shared_ptr<GlslStatement>  GlslStatementPtr;
+
+    struct GlslExpression
+    {
+        enum Kind
+        {
+            // value, integer and unsigned tell the type
+            LITERAL,
+            // name
+            NAME,
+            // name(operands), a function or a constructor; array for
+            // constructors like float[3](...) or mat3[](...)
+            CALL,
+            // operands[0].name, swizzles and .length()
+            MEMBER,
+            // operands[0][operands[1]]
+            INDEX,
+            // op operands[0], including prefix ++ and --
+            UNARY,
+            // operands[0]++ or --
+            POSTFIX,
+            // operands[0] op operands[1], including the comma
+            BINARY,
+            // operands[0] op operands[1] with op = or +=, -= ...
+            ASSIGN,
+            // operands[0] ? operands[1] : operands[2]
+            CONDITIONAL
+        };
+
+        Kind                           kind;
+        std::string                    name;
+        std::string                    op;
+        double                         value;
+        bool                           integer;
+        bool                           unsigned_integer;
+        bool                           boolean;
+        bool                           array;
+        // the size of an array constructor, null if not given
+        GlslExpressionPtr              array_size;
+        std::vector<GlslExpressionPtr> operands;
+        unsigned int                   line;
+    };
+
+    struct GlslType
+    {
+        // float, vec3, mat3, sampler2D, void ...
+        std::string       name;
+        bool              array;
+        // null for [] or if not an array
+        GlslExpressionPtr array_size;
+    };
+
+    struct GlslDeclarator
+    {
+        std::string       name;
+        GlslType          type;
+        // null if not initialized
+        GlslExpressionPtr initializer;
+    };
+
+    struct GlslStatement
+    {
+        enum Kind
+        {
+            EXPRESSION,
+            DECLARATION,
+            BLOCK,
+            IF,
+            FOR,
+            WHILE,
+            DO,
+            RETURN,
+            BREAK,
+            CONTINUE,
+            DISCARD,
+            EMPTY
+        };
+
+        Kind                          kind;
+        // EXPRESSION, RETURN (may be null), the condition of IF and loops
+        GlslExpressionPtr             expression;
+        // the step of FOR, may be null
+        GlslExpressionPtr             step;
+        std::vector<GlslDeclarator>   declarators;
+        // BLOCK: the statements; IF: then and else (may be null); FOR: the
+        // initializer (may be null) and the body; WHILE and DO: the body
+        std::vector<GlslStatementPtr> statements;
+        unsigned int                  line;
+    };
+
+    struct GlslParameter
+    {
+        std::string name;
+        GlslType    type;
+        // in, out or inout
+        std::string direction;
+    };
+
+    struct GlslFunction
+    {
+        std::string                name;
+        GlslType                   type;
+        std::vector<GlslParameter> parameters;
+        GlslStatementPtr           body;
+        unsigned int               line;
+    };
+
+    // A global declaration with its storage qualifier: uniform, in, out,
+    // const or "" for plain globals.
+    struct GlslGlobal
+    {
+        std::string    qualifier;
+        GlslDeclarator declarator;
+        unsigned int   line;
+    };
+
+    struct GlslShader
+    {
+        std::vector<GlslGlobal>   globals;
+        // in order, overloads have the same name
+        std::vector<GlslFunction> functions;
+        // the values of #pragma footprint(...)
+        std::vector<unsigned int> footprints;
+    };
+
+    // Parse a shader as it goes to the driver: #include resolved and the
+    // defines injected (see Preprocessor.h). The preprocessor directives
+    // are carried out here, errors are reported with the #line numbers.
+    GlslShader parse_glsl(const std::string& code);
+
+    // void, float, vec3, mat3, sampler2D ...
+    bool is_type_name(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,96 @@
+
+#include "Kernel.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace pkzo
+{
+    Kernel gaussian_kernel(float sigma, unsigned int radius)
+    {
+        if (sigma <= 0.0f)
+        {
+            throw std::invalid_argument("The sigma of a gaussian must be positive.");
+        }
+        if (radius == 0)
+        {
+            radius = (unsigned int)std::ceil(3.0f * sigma);
+        }
+
+        Kernel kernel;
+        double sum = 0.0;
+        std::vector<double> weights(radius + 1);
+        for (unsigned int i = 0; i <= radius; i++)
+        {
+            weights[i] = std::exp(-0.5 * (i * i) / ((double)sigma * sigma));
+            sum += i == 0 ? weights[i] : 2.0 * weights[i];
+        }
+
+        for (unsigned int i = 0; i <= radius; i++)
+        {
+            kernel.offsets.push_back((float)i);
+            kernel.weights.push_back((float)(weights[i] / sum));
+        }
+
+        return kernel;
+    }
+
+    Kernel linear_sampling(const Kernel& kernel)
+    {
+        Kernel result;
+        if (kernel.weights.empty())
+        {
+            return result;
+        }
+
+        result.offsets.push_back(kernel.offsets[0]);
+        result.weights.push_back(kernel.weights[0]);
+
+        for (size_t i = 1; i < kernel.weights.size(); i += 2)
+        {
+            float w1 = kernel.weights[i];
+            float o1 = kernel.offsets[i];
+            if (i + 1 == kernel.weights.size())
+            {
+                result.offsets.push_back(o1);
+                result.weights.push_back(w1);
+                break;
+            }
+
+            float w2 = kernel.weights[i + 1];
+            float o2 = kernel.offsets[i + 1];
+            float w  = w1 + w2;
+            result.offsets.push_back(w > 0.0f ? (o1 * w1 + o2 * w2) / w : o1);
+            result.weights.push_back(w);
+        }
+
+        return result;
+    }
+
+    std::vector<unsigned int> box_radii(float sigma, unsigned int count)
+    {
+        if (sigma <= 0.0f || count == 0)
+        {
+            throw std::invalid_argument("Boxes need a positive sigma.");
+        }
+
+        // the two odd widths next to the ideal one and how many of the 
+        // narrower one make the variance come out right
+        double n     = count;
+        double s2    = (double)sigma * sigma;
+        int    lower = (int)std::floor(std::sqrt(12.0 * s2 / n + 1.0));
+        if (lower % 2 == 0)
+        {
+            lower--;
+        }
+        int    upper = lower + 2;
+        double m     = std::floor((12.0 * s2 - n * lower * lower - 4.0 * n * lower - 3.0 * n) / (-4.0 * lower - 4.0) + 0.5);
+
+        std::vector<unsigned int> radii;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            radii.push_back((unsigned int)(((double)i < m ? lower : upper) - 1) / 2);
+        }
+        return radii;
+    }
+}
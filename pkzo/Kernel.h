@@ -0,0 +1,34 @@
+
+#ifndef _PKZO_KERNEL_H_
+#define _PKZO_KERNEL_H_
+
+#include <vector>
+
+#include "config.h"
+
+namespace pkzo
+{
+    // One side of a symmetric 1D kernel: weights[0] is the center, 
+    // weights[i] applies at +i and -i. 
+    struct Kernel
+    {
+        std::vector<float> offsets;
+        std::vector<float> weights;
+    };
+
+    // Sampled gaussian with radius + 1 taps, normalized so that both sides
+    // together sum to one. A radius of 0 picks ceil(3 sigma).
+    PKZO_EXPORT Kernel gaussian_kernel(float sigma, unsigned int radius = 0);
+
+    // Merge each pair of neighboring taps into one tap between them, so a 
+    // bilinear lookup there fetches both texels with the right weights. 
+    // The center stays on its own; about half the lookups remain.
+    PKZO_EXPORT Kernel linear_sampling(const Kernel& kernel);
+
+    // The radii of count box filters that one after the other come close to
+    // a gaussian of sigma, the boxes as wide as possible (Kovesi, "Fast 
+    // Almost-Gaussian Filtering"). Smaller boxes come first.
+    PKZO_EXPORT std::vector<unsigned int> box_radii(float sigma, unsigned int count = 3);
+}
+
+#endif
@@ -336,7 +336,7 @@ namespace pkzo
             glDisableVertexAttribArray(texcoord_location);
         }
         
-        if (texcoord_location != -1)
+        if (tangent_location != -1)
         {
             glDisableVertexAttribArray(tangent_location);
         }
@@ -406,7 +406,7 @@ namespace pkzo
             glDisableVertexAttribArray(texcoord_location);
         }
         
-        if (texcoord_location != -1)
+        if (tangent_location != -1)
         {
             glDisableVertexAttribArray(tangent_location);
         }
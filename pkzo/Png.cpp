@@ -0,0 +1,319 @@
+
+#include "Png.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <png.h>
+
+#include "compose.h"
+
+namespace pkzo
+{
+    // PNG stores 16 bit samples big endian
+    bool is_little_endian()
+    {
+        unsigned short one = 1;
+        return *reinterpret_cast<unsigned char*>(&one) == 1;
+    }
+
+    ColorFormat get_png_format(int color_type, int bit_depth)
+    {
+        switch (color_type)
+        {
+            case PNG_COLOR_TYPE_GRAY:
+                return bit_depth == 16 ? R16 : R8;
+            case PNG_COLOR_TYPE_GRAY_ALPHA:
+                return bit_depth == 16 ? RG16 : RG8;
+            case PNG_COLOR_TYPE_RGB:
+                return bit_depth == 16 ? RGB16 : RGB;
+            case PNG_COLOR_TYPE_RGB_ALPHA:
+                return bit_depth == 16 ? RGBA16 : RGBA;
+            default:
+                return NOCF;
+        }
+    }
+
+    PngReader::PngReader(const std::string& f)
+    : file(f), fp(NULL), png(NULL), info(NULL), format(NOCF), row(0)
+    {
+        fp = fopen(file.c_str(), "rb");
+        if (fp == NULL)
+        {
+            throw std::runtime_error(compose("Failed to open %0 for reading.", file));
+        }
+
+        unsigned char header[8];
+        if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8))
+        {
+            fclose(fp);
+            throw std::runtime_error(compose("%0 is not a PNG.", file));
+        }
+
+        png_structp png_ptr  = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+        png_infop   info_ptr = png_create_info_struct(png_ptr);
+        png  = png_ptr;
+        info = info_ptr;
+
+        // the destructor does not run if the constructor throws
+        const char* error = NULL;
+        if (setjmp(png_jmpbuf(png_ptr)))
+        {
+            error = "Error while reading %0.";
+        }
+        else
+        {
+            png_init_io(png_ptr, fp);
+            png_set_sig_bytes(png_ptr, 8);
+
+            png_read_info(png_ptr, info_ptr);
+
+            size[0] = png_get_image_width(png_ptr, info_ptr);
+            size[1] = png_get_image_height(png_ptr, info_ptr);
+
+            // Palettes and bits below 8 are expanded, everything else is 
+            // uploaded as it is: gray stays one channel and 16 bit stays
+            // 16 bit.
+            png_byte color_type = png_get_color_type(png_ptr, info_ptr);
+            png_byte bit_depth  = png_get_bit_depth(png_ptr, info_ptr);
+            if (color_type == PNG_COLOR_TYPE_PALETTE)
+            {
+                png_set_palette_to_rgb(png_ptr);
+            }
+            if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+            {
+                png_set_expand_gray_1_2_4_to_8(png_ptr);
+            }
+            if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+            {
+                png_set_tRNS_to_alpha(png_ptr);
+            }
+            if (bit_depth == 16 && is_little_endian())
+            {
+                png_set_swap(png_ptr);
+            }
+
+            png_set_interlace_handling(png_ptr);
+            png_read_update_info(png_ptr, info_ptr);
+
+            format = get_png_format(png_get_color_type(png_ptr, info_ptr), png_get_bit_depth(png_ptr, info_ptr));
+            if (format == NOCF)
+            {
+                error = "%0: Unsupported color type.";
+            }
+        }
+
+        if (error != NULL)
+        {
+            png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+            fclose(fp);
+            throw std::runtime_error(compose(error, file));
+        }
+    }
+
+    PngReader::~PngReader()
+    {
+        png_structp png_ptr  = static_cast<png_structp>(png);
+        png_infop   info_ptr = static_cast<png_infop>(info);
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        fclose(fp);
+    }
+
+    rgm::uvec2 PngReader::get_size() const
+    {
+        return size;
+    }
+
+    ColorFormat PngReader::get_format() const
+    {
+        return format;
+    }
+
+    size_t PngReader::get_stride() const
+    {
+        return size[0] * get_pixel_size(format);
+    }
+
+    unsigned int PngReader::get_row() const
+    {
+        return row;
+    }
+
+    unsigned int PngReader::read(unsigned char* rows, unsigned int count, size_t stride)
+    {
+        png_structp png_ptr  = static_cast<png_structp>(png);
+        png_infop   info_ptr = static_cast<png_infop>(info);
+
+        count = std::min(count, size[1] - row);
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        if (setjmp(png_jmpbuf(png_ptr)))
+        {
+            throw std::runtime_error(compose("Error while reading %0.", file));
+        }
+
+        if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)
+        {
+            if (interlaced.empty())
+            {
+                interlaced.resize(size[1] * get_stride());
+                std::vector<png_bytep> ptrs(size[1]);
+                for (unsigned int y = 0; y < size[1]; y++)
+                {
+                    ptrs[y] = &interlaced[y * get_stride()];
+                }
+                png_read_image(png_ptr, &ptrs[0]);
+            }
+
+            for (unsigned int y = 0; y < count; y++)
+            {
+                memcpy(rows + y * stride, &interlaced[(row + y) * get_stride()], get_stride());
+            }
+        }
+        else
+        {
+            for (unsigned int y = 0; y < count; y++)
+            {
+                png_read_row(png_ptr, rows + y * stride, NULL);
+            }
+        }
+
+        row += count;
+        return count;
+    }
+
+    PngWriter::PngWriter(const std::string& f, rgm::uvec2 s, ColorFormat format)
+    : file(f), fp(NULL), png(NULL), info(NULL), size(s), row(0)
+    {
+        int color_type = 0;
+        switch (format)
+        {
+            case R8:
+            case R16:
+                color_type = PNG_COLOR_TYPE_GRAY;
+                break;
+            case RG8:
+            case RG16:
+                color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+                break;
+            case RGB:
+            case RGB16:
+                color_type = PNG_COLOR_TYPE_RGB;
+                break;
+            case RGBA:
+            case RGBA16:
+                color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+                break;
+            default:
+                throw std::invalid_argument("PNGs hold 8 or 16 bit gray, gray alpha, RGB or RGBA.");
+        }
+
+        // still read after setjmp, the compiler must not keep it in a register
+        volatile int bit_depth = get_pixel_size(format) == 2 * get_channel_count(format) ? 16 : 8;
+
+        fp = fopen(file.c_str(), "wb");
+        if (fp == NULL)
+        {
+            throw std::runtime_error(compose("Failed to open %0 for writing.", file));
+        }
+
+        png_structp png_ptr  = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+        png_infop   info_ptr = png_create_info_struct(png_ptr);
+        png  = png_ptr;
+        info = info_ptr;
+
+        if (setjmp(png_jmpbuf(png_ptr)))
+        {
+            close();
+            throw std::runtime_error(compose("Error while writing %0.", file));
+        }
+
+        png_init_io(png_ptr, fp);
+
+        png_set_IHDR(png_ptr, info_ptr, size[0], size[1],
+                     bit_depth, color_type, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+        png_write_info(png_ptr, info_ptr);
+
+        if (bit_depth == 16 && is_little_endian())
+        {
+            png_set_swap(png_ptr);
+        }
+    }
+
+    PngWriter::~PngWriter()
+    {
+        close();
+    }
+
+    unsigned int PngWriter::get_row() const
+    {
+        return row;
+    }
+
+    void PngWriter::write(const unsigned char* rows, unsigned int count, size_t stride)
+    {
+        if (fp == NULL)
+        {
+            throw std::logic_error("PngWriter is already finished.");
+        }
+        if (row + count > size[1])
+        {
+            throw std::logic_error(compose("%0 has only %1 rows.", file, size[1]));
+        }
+
+        png_structp png_ptr = static_cast<png_structp>(png);
+        if (setjmp(png_jmpbuf(png_ptr)))
+        {
+            throw std::runtime_error(compose("Error while writing %0.", file));
+        }
+
+        for (unsigned int y = 0; y < count; y++)
+        {
+            png_write_row(png_ptr, const_cast<png_bytep>(rows + y * stride));
+        }
+        row += count;
+    }
+
+    void PngWriter::finish()
+    {
+        if (fp == NULL)
+        {
+            return;
+        }
+        if (row != size[1])
+        {
+            throw std::logic_error(compose("%0: Only %1 of %2 rows were written.", file, row, size[1]));
+        }
+
+        png_structp png_ptr = static_cast<png_structp>(png);
+        if (setjmp(png_jmpbuf(png_ptr)))
+        {
+            throw std::runtime_error(compose("Error while writing %0.", file));
+        }
+        png_write_end(png_ptr, NULL);
+
+        close();
+    }
+
+    void PngWriter::close()
+    {
+        if (png != NULL)
+        {
+            png_structp png_ptr  = static_cast<png_structp>(png);
+            png_infop   info_ptr = static_cast<png_infop>(info);
+            png_destroy_write_struct(&png_ptr, &info_ptr);
+            png  = NULL;
+            info = NULL;
+        }
+        if (fp != NULL)
+        {
+            fclose(fp);
+            fp = NULL;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+
+#ifndef _PKZO_PNG_H_
+#define _PKZO_PNG_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <rgm/rgm.h>
+
+#include "config.h"
+#include "Texture.h"
+
+namespace pkzo
+{
+    // Decodes a PNG a few rows at a time, so that only the rows asked for
+    // need to be in memory. Interlaced images cannot be decoded row by row;
+    // they are decoded whole on the first read. Gray, gray alpha, RGB and
+    // RGBA keep their channels and 8 or 16 bits; palettes become RGB or 
+    // RGBA.
+    class PKZO_EXPORT PngReader
+    {
+    public:
+
+        PngReader(const std::string& file);
+
+        ~PngReader();
+
+        rgm::uvec2 get_size() const;
+
+        ColorFormat get_format() const;
+
+        // bytes per row
+        size_t get_stride() const;
+
+        // number of rows read so far
+        unsigned int get_row() const;
+
+        // Read up to count rows into rows, stride bytes apart; returns the
+        // number of rows read, 0 at the end of the image.
+        unsigned int read(unsigned char* rows, unsigned int count, size_t stride);
+
+    private:
+        std::string                file;
+        FILE*                      fp;
+        void*                      png;
+        void*                      info;
+        rgm::uvec2                 size;
+        ColorFormat                format;
+        unsigned int               row;
+        std::vector<unsigned char> interlaced;
+
+        PngReader(const PngReader&) = delete;
+        const PngReader& operator = (const PngReader&) = delete;
+    };
+
+    // Encodes a PNG as rows come in, top to bottom. Any 8 or 16 bit format
+    // with one to four channels can be written.
+    class PKZO_EXPORT PngWriter
+    {
+    public:
+
+        PngWriter(const std::string& file, rgm::uvec2 size, ColorFormat format);
+
+        // closes the file, which is incomplete unless finish was called
+        ~PngWriter();
+
+        unsigned int get_row() const;
+
+        // write count rows, stride bytes apart
+        void write(const unsigned char* rows, unsigned int count, size_t stride);
+
+        // Write the end of the file; all rows must have been written.
+        void finish();
+
+    private:
+        std::string  file;
+        FILE*        fp;
+        void*        png;
+        void*        info;
+        rgm::uvec2   size;
+        unsigned int row;
+
+        void close();
+
+        PngWriter(const PngWriter&) = delete;
+        const PngWriter& operator = (const PngWriter&) = delete;
+    };
+}
+
+#endif
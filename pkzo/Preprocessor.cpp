@@ -0,0 +1,214 @@
+
+#include "Preprocessor.h"
+
+#include <regex>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "fs.h"
+#include "path.h"
+#include "compose.h"
+
+namespace pkzo
+{
+    std::regex include_directive("^\\s*#\\s*include\\s+[\"<]([^\">]+)[\">]\\s*$");
+    std::regex version_directive("^\\s*#\\s*version\\b.*$");
+    std::regex glsl_comments("//[^\\n]*|/\\*[\\s\\S]*?\\*/");
+    std::regex pointwise_pragma("#[ \\t]*pragma[ \\t]+pointwise\\b");
+    std::regex version_number("#[ \\t]*version[ \\t]+(\\d+)");
+    std::regex define_directive("#[ \\t]*define[ \\t]+(\\w+)");
+
+    void preprocess(const std::string& file, std::vector<std::string>& stack, unsigned int& sources, std::stringstream& out)
+    {
+        if (std::find(stack.begin(), stack.end(), file) != stack.end())
+        {
+            throw std::runtime_error(compose("Recursive include of %0.", file));
+        }
+
+        std::string code = fs::read(file);
+
+        unsigned int source = sources++;
+        stack.push_back(file);
+
+        std::istringstream in(code);
+        std::string        line;
+        unsigned int       number = 0;
+        while (std::getline(in, line))
+        {
+            number++;
+
+            std::smatch match;
+            if (std::regex_match(line, match, include_directive))
+            {
+                std::string include = path::join(path::dirname(file), match[1]);
+                out << "#line 1 " << sources << "\n";
+                preprocess(include, stack, sources, out);
+                out << "#line " << number + 1 << " " << source << "\n";
+            }
+            else if (stack.size() > 1 && std::regex_match(line, version_directive))
+            {
+                // only the top file decides the version
+                out << "\n";
+            }
+            else
+            {
+                out << line << "\n";
+            }
+        }
+
+        stack.pop_back();
+    }
+
+    std::string preprocess(const std::string& file)
+    {
+        std::vector<std::string> stack;
+        unsigned int             sources = 0;
+        std::stringstream        out;
+        preprocess(file, stack, sources, out);
+        return out.str();
+    }
+
+    std::string inject_defines(const std::string& code, const Defines& defines)
+    {
+        if (defines.empty())
+        {
+            return code;
+        }
+
+        std::stringstream block;
+        for (auto i = defines.begin(); i != defines.end(); ++i)
+        {
+            block << "#define " << i->first << " " << i->second << "\n";
+        }
+
+        std::istringstream in(code);
+        std::string        line;
+        unsigned int       number = 0;
+        size_t             offset = 0;
+        while (std::getline(in, line))
+        {
+            number++;
+            offset += line.size() + 1;
+            if (std::regex_match(line, version_directive))
+            {
+                block << "#line " << number + 1 << " 0\n";
+
+                offset = std::min(offset, code.size());
+                std::string head = code.substr(0, offset);
+                if (head[head.size() - 1] != '\n')
+                {
+                    head += "\n";
+                }
+                return head + block.str() + code.substr(offset);
+            }
+        }
+
+        // no #version, defines go first
+        block << "#line 1 0\n";
+        return block.str() + code;
+    }
+
+    void parse_define(const std::string& value, Defines& defines)
+    {
+        size_t i = value.find('=');
+        std::string name = value.substr(0, i);
+        if (name.empty())
+        {
+            throw std::invalid_argument(compose("Invalid define \"%0\".", value));
+        }
+        defines[name] = i != std::string::npos ? value.substr(i + 1) : "1";
+    }
+
+    std::string strip_comments(const std::string& code)
+    {
+        return std::regex_replace(code, glsl_comments, " ");
+    }
+
+    bool is_pointwise(const std::string& code)
+    {
+        return std::regex_search(strip_comments(code), pointwise_pragma);
+    }
+
+    std::string get_pragma(const std::string& code, const std::string& name)
+    {
+        std::string stripped = strip_comments(code);
+        std::smatch match;
+        std::regex  pragma("#[ \\t]*pragma[ \\t]+" + name + "[ \\t]*\\([ \\t]*(\\w+)[ \\t]*\\)");
+        return std::regex_search(stripped, match, pragma) ? match[1].str() : "";
+    }
+
+    std::string fuse_pointwise(const std::vector<std::string>& codes, const std::vector<Defines>& defines)
+    {
+        if (codes.empty() || codes.size() != defines.size())
+        {
+            throw std::invalid_argument("Need one define set per shader to fuse.");
+        }
+
+        // the newest version of any stage, so that all of them compile, but
+        // at least one with texelFetch and out
+        unsigned int version = 330;
+        for (size_t i = 0; i < codes.size(); i++)
+        {
+            std::smatch match;
+            std::string code = strip_comments(codes[i]);
+            if (std::regex_search(code, match, version_number))
+            {
+                version = std::max(version, (unsigned int)std::atoi(match[1].str().c_str()));
+            }
+        }
+
+        std::stringstream out;
+        out << "#version " << version << "\n"
+            << "uniform sampler2D uTexture;\n"
+            << "uniform uvec2     uTextureSize;\n"
+            << "in vec2           vTexCoord;\n"
+            << "out vec4          oFragColor;\n";
+
+        for (size_t i = 0; i < codes.size(); i++)
+        {
+            // the stage's apply and defines must not leak into the next one
+            std::set<std::string> names;
+            out << "#define apply apply" << i << "\n";
+            for (auto d = defines[i].begin(); d != defines[i].end(); ++d)
+            {
+                out << "#define " << d->first << " " << d->second << "\n";
+                names.insert(d->first);
+            }
+            std::string code = strip_comments(codes[i]);
+            for (std::sregex_iterator m(code.begin(), code.end(), define_directive), end; m != end; ++m)
+            {
+                names.insert((*m)[1]);
+            }
+
+            out << "#line 1 " << i << "\n";
+            std::istringstream in(codes[i]);
+            std::string        line;
+            while (std::getline(in, line))
+            {
+                out << (std::regex_match(line, version_directive) ? "" : line) << "\n";
+            }
+
+            out << "#undef apply\n";
+            for (auto n = names.begin(); n != names.end(); ++n)
+            {
+                out << "#undef " << *n << "\n";
+            }
+        }
+
+        out << "void main()\n"
+            << "{\n"
+            << "    vec4 color = texelFetch(uTexture, ivec2(vTexCoord), 0);\n";
+        for (size_t i = 0; i < codes.size(); i++)
+        {
+            out << "    color = apply" << i << "(color);\n";
+        }
+        out << "    oFragColor = color;\n"
+            << "}\n";
+
+        return out.str();
+    }
+}
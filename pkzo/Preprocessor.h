@@ -0,0 +1,52 @@
+
+#ifndef _PKZO_PREPROCESSOR_H_
+#define _PKZO_PREPROCESSOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace pkzo
+{
+    // Compile time defines, NAME -> VALUE. Ordered, so that equal sets
+    // compare equal and can key the shader variants.
+    typedef std::map<std::string, std::string> Defines;
+
+    // Read a shader file and resolve #include "file" directives, relative to
+    // the including file. Every included file gets its own source string
+    // number in #line, so compiler errors can be traced back.
+    PKZO_EXPORT std::string preprocess(const std::string& file);
+
+    // Insert a #define for each entry right after the #version line.
+    PKZO_EXPORT std::string inject_defines(const std::string& code, const Defines& defines);
+
+    // Parse "NAME=VALUE" or "NAME" (which is defined as 1) into defines.
+    PKZO_EXPORT void parse_define(const std::string& value, Defines& defines);
+
+    // Replace comments with a space, for scanning the code.
+    PKZO_EXPORT std::string strip_comments(const std::string& code);
+
+    // Does the code declare #pragma pointwise? A pointwise fragment shader
+    // has no main, only 
+    //
+    //   vec4 apply(vec4 color)
+    //
+    // which maps one input texel to the output, and nothing but its own 
+    // defines and functions around it.
+    PKZO_EXPORT bool is_pointwise(const std::string& code);
+
+    // The argument of the first #pragma name(argument) in the code, or an
+    // empty string if there is none.
+    PKZO_EXPORT std::string get_pragma(const std::string& code, const std::string& name);
+
+    // Generate one fragment shader that fetches the texel of uTexture and 
+    // runs it through the apply of each pointwise shader in order, with 
+    // defines[i] in effect for codes[i]. Each shader is its own #line source
+    // string, numbered in order. The same shader should not appear twice,
+    // its helper functions would be defined twice.
+    PKZO_EXPORT std::string fuse_pointwise(const std::vector<std::string>& codes, const std::vector<Defines>& defines);
+}
+
+#endif
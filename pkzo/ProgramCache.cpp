@@ -0,0 +1,207 @@
+
+#include "ProgramCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <GL/glew.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "compose.h"
+#include "fs.h"
+#include "path.h"
+
+namespace pkzo
+{
+    const char         program_magic[8] = {'P', 'K', 'Z', 'O', 'P', 'R', 'G', '1'};
+    const size_t       program_header   = sizeof(program_magic) + sizeof(GLenum);
+
+    // 64 bit FNV-1a
+    unsigned long long fnv1a(unsigned long long hash, const std::string& value)
+    {
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            hash ^= (unsigned char)value[i];
+            hash *= 1099511628211ull;
+        }
+        // separator, so that "ab" + "c" and "a" + "bc" differ
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+        return hash;
+    }
+
+    int get_pid()
+    {
+    #ifdef _WIN32
+        return _getpid();
+    #else
+        return getpid();
+    #endif
+    }
+
+    // a temporary file name no other thread or process writes at the same time
+    std::string get_temp_file(const std::string& file)
+    {
+        static std::atomic<unsigned int> counter(0);
+        return compose("%0.%1.%2.tmp", file, get_pid(), counter++);
+    }
+
+    std::string gl_string(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value != NULL ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    ProgramCache::ProgramCache()
+    : dir(path::join(path::confdir("pkzo"), "programs")), hits(0), misses(0), rejects(0) {}
+
+    ProgramCache::ProgramCache(const std::string& d)
+    : dir(d), hits(0), misses(0), rejects(0) {}
+
+    ProgramCache::~ProgramCache() {}
+
+    const std::string& ProgramCache::get_directory() const
+    {
+        return dir;
+    }
+
+    bool ProgramCache::is_supported() const
+    {
+        if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1)
+        {
+            return false;
+        }
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    std::string ProgramCache::get_key(const std::string& vertex_code, const std::string& fragment_code) const
+    {
+        unsigned long long hash = 14695981039346656037ull;
+        hash = fnv1a(hash, gl_string(GL_VENDOR));
+        hash = fnv1a(hash, gl_string(GL_RENDERER));
+        hash = fnv1a(hash, gl_string(GL_VERSION));
+        hash = fnv1a(hash, vertex_code);
+        hash = fnv1a(hash, fragment_code);
+
+        char key[17];
+        std::sprintf(key, "%016llx", hash);
+        return key;
+    }
+
+    unsigned int ProgramCache::load(const std::string& key)
+    {
+        std::string file = get_file(key);
+        if (!is_supported() || !fs::exists(file))
+        {
+            misses++;
+            return 0;
+        }
+
+        std::string data;
+        try
+        {
+            data = fs::read(file);
+        }
+        catch (...)
+        {
+            misses++;
+            return 0;
+        }
+
+        GLenum format = 0;
+        if (data.size() <= program_header || std::memcmp(data.data(), program_magic, sizeof(program_magic)) != 0)
+        {
+            std::remove(file.c_str());
+            rejects++;
+            misses++;
+            return 0;
+        }
+        std::memcpy(&format, data.data() + sizeof(program_magic), sizeof(format));
+
+        unsigned int program_id = glCreateProgram();
+        glProgramBinary(program_id, format, data.data() + program_header, (GLsizei)(data.size() - program_header));
+
+        int status = 0;
+        glGetProgramiv(program_id, GL_LINK_STATUS, &status);
+        if (!status)
+        {
+            // driver changed in a way the key does not see; drop the entry
+            glDeleteProgram(program_id);
+            std::remove(file.c_str());
+            rejects++;
+            misses++;
+            return 0;
+        }
+
+        hits++;
+        return program_id;
+    }
+
+    void ProgramCache::store(const std::string& key, unsigned int program_id)
+    {
+        if (!is_supported())
+        {
+            return;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+
+        std::string data(program_header + length, '\0');
+        GLenum format = 0;
+        glGetProgramBinary(program_id, length, NULL, &format, &data[program_header]);
+        std::memcpy(&data[0], program_magic, sizeof(program_magic));
+        std::memcpy(&data[sizeof(program_magic)], &format, sizeof(format));
+
+        // write and rename, so that a concurrent run never sees half a file
+        std::string file = get_file(key);
+        std::string temp = get_temp_file(file);
+        try
+        {
+            fs::mkdir(dir);
+            fs::write(temp, data);
+            std::remove(file.c_str());
+            if (std::rename(temp.c_str(), file.c_str()) != 0)
+            {
+                std::remove(temp.c_str());
+            }
+        }
+        catch (...)
+        {
+            std::remove(temp.c_str());
+        }
+    }
+
+    unsigned int ProgramCache::get_hits() const
+    {
+        return hits;
+    }
+
+    unsigned int ProgramCache::get_misses() const
+    {
+        return misses;
+    }
+
+    unsigned int ProgramCache::get_rejects() const
+    {
+        return rejects;
+    }
+
+    std::string ProgramCache::get_file(const std::string& key) const
+    {
+        return path::join(dir, key + ".bin");
+    }
+}
@@ -0,0 +1,61 @@
+
+#ifndef _PKZO_PROGRAM_CACHE_H_
+#define _PKZO_PROGRAM_CACHE_H_
+
+#include <string>
+
+#include "config.h"
+
+namespace pkzo
+{
+    // On-disk cache of linked program binaries (GL_ARB_get_program_binary).
+    // Entries are keyed by the shader sources and the driver strings, so a
+    // driver update simply misses and recompiles.
+    class PKZO_EXPORT ProgramCache
+    {
+    public:
+
+        // Use the default location, path::confdir("pkzo")/programs.
+        ProgramCache();
+
+        ProgramCache(const std::string& dir);
+
+        ~ProgramCache();
+
+        const std::string& get_directory() const;
+
+        // Does the current context support binaries at all?
+        bool is_supported() const;
+
+        std::string get_key(const std::string& vertex_code, const std::string& fragment_code) const;
+
+        // Try to create a program from the cached binary; returns 0 on a
+        // miss or if the driver rejects the binary.
+        unsigned int load(const std::string& key);
+
+        // Store the binary of a linked program. The program must have been
+        // linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Failing to
+        // write the cache is not an error, the next run will just miss.
+        void store(const std::string& key, unsigned int program_id);
+
+        unsigned int get_hits() const;
+
+        unsigned int get_misses() const;
+
+        // binaries that were found but rejected by the driver
+        unsigned int get_rejects() const;
+
+    private:
+        std::string  dir;
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int rejects;
+
+        std::string get_file(const std::string& key) const;
+
+        ProgramCache(const ProgramCache&) = delete;
+        const ProgramCache& operator = (const ProgramCache&) = delete;
+    };
+}
+
+#endif
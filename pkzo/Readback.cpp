@@ -0,0 +1,260 @@
+
+#include "Readback.h"
+
+#include <stdexcept>
+#include <GL/glew.h>
+
+#include "FrameBuffer.h"
+
+namespace pkzo
+{
+    Readback::Readback()
+    : ring(NULL), slot(0), size(0, 0), format(NOCF) {}
+
+    Readback::Readback(ReadbackRing* r, unsigned int s, rgm::uvec2 z, ColorFormat f)
+    : ring(r), slot(s), size(z), format(f) {}
+
+    Readback::Readback(Readback&& other)
+    : ring(other.ring), slot(other.slot), size(other.size), format(other.format)
+    {
+        other.ring = NULL;
+    }
+
+    Readback::~Readback()
+    {
+        if (ring != NULL)
+        {
+            ring->release(slot);
+        }
+    }
+
+    const Readback& Readback::operator = (Readback&& other)
+    {
+        if (this != &other)
+        {
+            if (ring != NULL)
+            {
+                ring->release(slot);
+            }
+
+            ring   = other.ring;
+            slot   = other.slot;
+            size   = other.size;
+            format = other.format;
+
+            other.ring = NULL;
+        }
+        return *this;
+    }
+
+    bool Readback::is_valid() const
+    {
+        return ring != NULL;
+    }
+
+    bool Readback::is_ready() const
+    {
+        if (ring == NULL)
+        {
+            throw std::logic_error("Readback::is_ready: invalid readback");
+        }
+        return ring->is_ready(slot);
+    }
+
+    PixelView Readback::view()
+    {
+        if (ring == NULL)
+        {
+            throw std::logic_error("Readback::view: invalid readback");
+        }
+
+        size_t    pixel = get_pixel_size(format);
+        PixelView v     = {ring->map(slot, size[0] * size[1] * pixel), size, format, size[0] * pixel};
+        return v;
+    }
+
+    Texture Readback::get()
+    {
+        PixelView v     = view();
+        size_t    bytes = v.size[1] * v.stride;
+
+        std::vector<unsigned char> data(v.data, v.data + bytes);
+        ring->release(slot);
+        ring = NULL;
+
+        return Texture(size, format, std::move(data));
+    }
+
+    ReadbackRing::ReadbackRing(unsigned int count)
+    : next(0)
+    {
+        if (count == 0)
+        {
+            throw std::invalid_argument("ReadbackRing: count must not be 0");
+        }
+
+        slots.resize(count);
+        for (Slot& slot : slots)
+        {
+            slot.pbo      = 0;
+            slot.capacity = 0;
+            slot.fence    = NULL;
+            slot.mapping  = NULL;
+            slot.busy     = false;
+        }
+    }
+
+    ReadbackRing::~ReadbackRing()
+    {
+        for (unsigned int i = 0; i < slots.size(); i++)
+        {
+            release(i);
+        }
+        for (Slot& slot : slots)
+        {
+            if (slot.pbo != 0)
+            {
+                glDeleteBuffers(1, &slot.pbo);
+            }
+        }
+    }
+
+    unsigned int ReadbackRing::get_count() const
+    {
+        return slots.size();
+    }
+
+    Readback ReadbackRing::read(FrameBuffer& framebuffer, ColorFormat format)
+    {
+        Texture&    color  = framebuffer.get_color();
+        rgm::uvec2  size   = color.get_size();
+        if (format == NOCF)
+        {
+            format = color.get_format();
+        }
+
+        unsigned int i = acquire(size[0] * size[1] * get_pixel_size(format));
+
+        framebuffer.bind();
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+        glReadPixels(0, 0, size[0], size[1], get_gl_format(format), get_gl_type(format), 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slots[i].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        return Readback(this, i, size, format);
+    }
+
+    Readback ReadbackRing::read(Texture& texture, ColorFormat format)
+    {
+        rgm::uvec2  size   = texture.get_size();
+        if (format == NOCF)
+        {
+            format = texture.get_format();
+        }
+
+        unsigned int i = acquire(size[0] * size[1] * get_pixel_size(format));
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+        glBindTexture(GL_TEXTURE_2D, texture.get_glid());
+        glGetTexImage(GL_TEXTURE_2D, 0, get_gl_format(format), get_gl_type(format), 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slots[i].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        return Readback(this, i, size, format);
+    }
+
+    unsigned int ReadbackRing::acquire(size_t bytes)
+    {
+        // If the caller holds on to more readbacks than there are buffers, 
+        // the ring grows instead of stalling on a readback nobody waits for.
+        unsigned int i = next;
+        while (slots[i].busy)
+        {
+            i = (i + 1) % slots.size();
+            if (i == next)
+            {
+                Slot slot = {0, 0, NULL, NULL, false};
+                slots.push_back(slot);
+                i = slots.size() - 1;
+                break;
+            }
+        }
+        next = (i + 1) % slots.size();
+
+        Slot& slot = slots[i];
+        if (slot.pbo == 0)
+        {
+            glGenBuffers(1, &slot.pbo);
+        }
+        if (slot.capacity < bytes)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.capacity = bytes;
+        }
+        slot.busy = true;
+
+        return i;
+    }
+
+    bool ReadbackRing::is_ready(unsigned int i) const
+    {
+        GLint status = GL_UNSIGNALED;
+        glGetSynciv((GLsync)slots[i].fence, GL_SYNC_STATUS, sizeof(status), NULL, &status);
+        return status == GL_SIGNALED;
+    }
+
+    const unsigned char* ReadbackRing::map(unsigned int i, size_t bytes)
+    {
+        Slot& slot = slots[i];
+        if (slot.mapping != NULL || bytes == 0)
+        {
+            return (const unsigned char*)slot.mapping;
+        }
+
+        GLenum r = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (r == GL_TIMEOUT_EXPIRED)
+        {
+            r = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        if (r == GL_WAIT_FAILED)
+        {
+            throw std::runtime_error("Failed to wait for readback.");
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        slot.mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (slot.mapping == NULL)
+        {
+            throw std::runtime_error("Failed to map readback buffer.");
+        }
+
+        return (const unsigned char*)slot.mapping;
+    }
+
+    void ReadbackRing::release(unsigned int i)
+    {
+        Slot& slot = slots[i];
+        if (slot.mapping != NULL)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.mapping = NULL;
+        }
+        if (slot.fence != NULL)
+        {
+            glDeleteSync((GLsync)slot.fence);
+            slot.fence = NULL;
+        }
+        slot.busy = false;
+    }
+}
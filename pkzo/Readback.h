@@ -0,0 +1,98 @@
+
+#ifndef _PKZO_READBACK_H_
+#define _PKZO_READBACK_H_
+
+#include <vector>
+#include <rgm/rgm.h>
+
+#include "config.h"
+#include "Texture.h"
+
+namespace pkzo
+{
+    class FrameBuffer;
+    class ReadbackRing;
+
+    // Handle to a pending asynchronous readback. The pixels are copied into 
+    // a pixel buffer object by the GPU; view() and get() wait for that copy 
+    // to finish and only then map the buffer.
+    class PKZO_EXPORT Readback
+    {
+    public:
+
+        Readback();
+
+        Readback(Readback&& other);
+
+        ~Readback();
+
+        const Readback& operator = (Readback&& other);
+
+        bool is_valid() const;
+
+        bool is_ready() const;
+
+        // The pixels in the mapped buffer, valid until the readback is 
+        // released (destroyed, assigned to or get()).
+        PixelView view();
+
+        // The pixels as a texture of their own; releases the readback.
+        Texture get();
+
+    private:
+        ReadbackRing* ring;
+        unsigned int  slot;
+        rgm::uvec2    size;
+        ColorFormat   format;
+
+        Readback(ReadbackRing* ring, unsigned int slot, rgm::uvec2 size, ColorFormat format);
+
+        Readback(const Readback&) = delete;
+        const Readback& operator = (const Readback&) = delete;
+
+    friend class ReadbackRing;
+    };
+
+    // A ring of pixel pack buffers, each guarded by a fence. 
+    class PKZO_EXPORT ReadbackRing
+    {
+    public:
+
+        ReadbackRing(unsigned int count = 3);
+
+        ~ReadbackRing();
+
+        unsigned int get_count() const;
+
+        // Read the pixels as format, by default the format they are stored
+        // in. The GL converts, e.g. from float to 8 bit with clamping.
+        Readback read(FrameBuffer& framebuffer, ColorFormat format = NOCF);
+
+        Readback read(Texture& texture, ColorFormat format = NOCF);
+
+    private:
+        struct Slot
+        {
+            unsigned int pbo;
+            size_t       capacity;
+            void*        fence;
+            const void*  mapping;
+            bool         busy;
+        };
+
+        std::vector<Slot> slots;
+        unsigned int      next;
+
+        unsigned int acquire(size_t bytes);
+        bool is_ready(unsigned int slot) const;
+        const unsigned char* map(unsigned int slot, size_t bytes);
+        void release(unsigned int slot);
+
+        ReadbackRing(const ReadbackRing&) = delete;
+        const ReadbackRing& operator = (const ReadbackRing&) = delete;
+
+    friend class Readback;
+    };
+}
+
+#endif
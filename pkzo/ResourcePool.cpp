@@ -0,0 +1,97 @@
+
+#include "ResourcePool.h"
+
+namespace pkzo
+{
+    ResourcePool::ResourcePool(size_t c)
+    : capacity(c), allocations(0), reuses(0) {}
+
+    ResourcePool::~ResourcePool() {}
+
+    std::unique_ptr<FrameBuffer> ResourcePool::acquire_frame_buffer(rgm::uvec2 size, ColorFormat format, bool depth)
+    {
+        Key key(size[0], size[1], format, depth);
+        for (auto i = frame_buffers.rbegin(); i != frame_buffers.rend(); ++i)
+        {
+            if (i->first == key)
+            {
+                std::unique_ptr<FrameBuffer> result = std::move(i->second);
+                frame_buffers.erase(std::next(i).base());
+                reuses++;
+                return result;
+            }
+        }
+
+        allocations++;
+        return std::unique_ptr<FrameBuffer>(new FrameBuffer(size, format, depth));
+    }
+
+    Texture ResourcePool::acquire_texture(rgm::uvec2 size, ColorFormat format, bool mipmaps)
+    {
+        Key key(size[0], size[1], format, mipmaps);
+        for (auto i = textures.rbegin(); i != textures.rend(); ++i)
+        {
+            if (i->first == key)
+            {
+                Texture result = std::move(i->second);
+                textures.erase(std::next(i).base());
+                reuses++;
+                return result;
+            }
+        }
+
+        allocations++;
+        Texture result(size, format);
+        result.set_mipmaps(mipmaps);
+        result.upload();
+        return result;
+    }
+
+    void ResourcePool::release(std::unique_ptr<FrameBuffer> frame_buffer)
+    {
+        if (!frame_buffer)
+        {
+            return;
+        }
+
+        rgm::uvec2 size = frame_buffer->get_size();
+        Key key(size[0], size[1], frame_buffer->get_format(), frame_buffer->has_depth());
+        frame_buffers.push_back(std::make_pair(key, std::move(frame_buffer)));
+        while (frame_buffers.size() > capacity)
+        {
+            frame_buffers.pop_front();
+        }
+    }
+
+    void ResourcePool::release(Texture&& texture)
+    {
+        rgm::uvec2 size = texture.get_size();
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return;
+        }
+
+        Key key(size[0], size[1], texture.get_format(), texture.get_mipmaps());
+        textures.push_back(std::make_pair(key, std::move(texture)));
+        while (textures.size() > capacity)
+        {
+            textures.pop_front();
+        }
+    }
+
+    void ResourcePool::clear()
+    {
+        frame_buffers.clear();
+        textures.clear();
+    }
+
+    unsigned int ResourcePool::get_allocations() const
+    {
+        return allocations;
+    }
+
+    unsigned int ResourcePool::get_reuses() const
+    {
+        return reuses;
+    }
+}
@@ -0,0 +1,65 @@
+
+#ifndef _PKZO_RESOURCE_POOL_H_
+#define _PKZO_RESOURCE_POOL_H_
+
+#include <list>
+#include <memory>
+#include <tuple>
+#include <rgm/rgm.h>
+
+#include "config.h"
+#include "Texture.h"
+#include "FrameBuffer.h"
+
+namespace pkzo
+{
+    // Keeps frame buffers and textures that are no longer needed, to hand 
+    // them out again instead of asking the driver for new ones. Objects of
+    // the same size, format and attachments are interchangeable; what they 
+    // contain when handed out is undefined.
+    class PKZO_EXPORT ResourcePool
+    {
+    public:
+
+        // At most capacity unused frame buffers and as many textures are 
+        // kept; beyond that the ones released longest ago are destroyed.
+        ResourcePool(size_t capacity = 16);
+
+        ~ResourcePool();
+
+        std::unique_ptr<FrameBuffer> acquire_frame_buffer(rgm::uvec2 size, ColorFormat format = RGBA, bool depth = false);
+
+        // allocated on the GPU, with or without mipmap levels
+        Texture acquire_texture(rgm::uvec2 size, ColorFormat format, bool mipmaps = false);
+
+        void release(std::unique_ptr<FrameBuffer> frame_buffer);
+
+        void release(Texture&& texture);
+
+        // destroy all unused objects
+        void clear();
+
+        // objects that had to be created
+        unsigned int get_allocations() const;
+
+        // objects that came from the pool
+        unsigned int get_reuses() const;
+
+    private:
+        // width, height, format and depth or mipmaps
+        typedef std::tuple<unsigned int, unsigned int, ColorFormat, bool> Key;
+
+        size_t       capacity;
+        unsigned int allocations;
+        unsigned int reuses;
+
+        // least recently released first
+        std::list<std::pair<Key, std::unique_ptr<FrameBuffer>>> frame_buffers;
+        std::list<std::pair<Key, Texture>>                      textures;
+
+        ResourcePool(const ResourcePool&) = delete;
+        const ResourcePool& operator = (const ResourcePool&) = delete;
+    };
+}
+
+#endif
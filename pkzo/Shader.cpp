@@ -1,15 +1,21 @@
 
 #include "Shader.h"
 
+#include <regex>
+#include <cstdlib>
+#include <algorithm>
 #include <stdexcept>
 #include <GL/glew.h>
 
 #include "fs.h"
+#include "compose.h"
+#include "ProgramCache.h"
+#include "Preprocessor.h"
 
 namespace pkzo
 {
     Shader::Shader()
-    : program_id(0) {}
+    : cache(NULL), current(NULL) {}
 
     Shader::~Shader()
     {
@@ -18,6 +24,7 @@ namespace pkzo
 
     void Shader::set_vertex_code(const std::string& value)
     {
+        release();
         vertex_code = value;
     }
 
@@ -28,6 +35,7 @@ namespace pkzo
 
     void Shader::set_fragment_code(const std::string& value)
     {
+        release();
         fragment_code = value;
     }
 
@@ -36,80 +44,326 @@ namespace pkzo
         return fragment_code;
     }
 
+    void Shader::set_compute_code(const std::string& value)
+    {
+        release();
+        compute_code = value;
+    }
+
+    const std::string& Shader::get_compute_code() const
+    {
+        return compute_code;
+    }
+
+    bool Shader::is_compute() const
+    {
+        return !compute_code.empty();
+    }
+
     void Shader::load(const std::string vertex_file, const std::string& fragment_file)
     {
-        set_vertex_code(fs::read(vertex_file));
-        set_fragment_code(fs::read(fragment_file));
+        set_vertex_code(preprocess(vertex_file));
+        set_fragment_code(preprocess(fragment_file));
+    }
+
+    void Shader::load_compute(const std::string& file)
+    {
+        set_compute_code(preprocess(file));
+    }
+
+    void Shader::set_defines(const Defines& value)
+    {
+        defines = value;
+        current = NULL;
+    }
+
+    void Shader::set_define(const std::string& name, const std::string& value)
+    {
+        defines[name] = value;
+        current = NULL;
+    }
+
+    const Defines& Shader::get_defines() const
+    {
+        return defines;
+    }
+
+    size_t Shader::get_variant_count() const
+    {
+        return variants.size();
+    }
+
+    // Every texture* lookup goes through the sampler state, except the size
+    // and level queries. textureGather only ever reads level 0, and so does
+    // textureLod (or a variant of it) with a literal LOD of 0.
+    std::regex texture_call("\\btexture(\\w*)\\s*\\(");
+    std::regex unfiltered_lookup("Size|QueryLevels|QueryLod|Samples|Gather.*");
+    std::regex zero_literal("\\s*(0+\\.?0*|\\.0+)[fF]?\\s*");
+
+    // the arguments of the call whose parenthesis opens before start
+    std::vector<std::string> get_arguments(const std::string& code, size_t start)
+    {
+        std::vector<std::string> arguments(1);
+        int depth = 0;
+        for (size_t i = start; i < code.size(); i++)
+        {
+            char c = code[i];
+            if (c == ')' && depth == 0)
+            {
+                break;
+            }
+            if (c == ',' && depth == 0)
+            {
+                arguments.push_back("");
+                continue;
+            }
+            if (c == '(' || c == '[')
+            {
+                depth++;
+            }
+            if (c == ')' || c == ']')
+            {
+                depth--;
+            }
+            arguments.back() += c;
+        }
+        return arguments;
+    }
+
+    bool uses_filtered_sampling(const std::string& code)
+    {
+        std::string stripped = strip_comments(code);
+        std::sregex_iterator end;
+        for (std::sregex_iterator i(stripped.begin(), stripped.end(), texture_call); i != end; ++i)
+        {
+            std::string name = (*i)[1];
+            if (std::regex_match(name, unfiltered_lookup))
+            {
+                continue;
+            }
+            if (name.find("Lod") != std::string::npos)
+            {
+                // textureLod(sampler, P, lod, ...) and the Proj and Offset variants
+                std::vector<std::string> arguments = get_arguments(stripped, i->position() + i->length());
+                if (arguments.size() > 2 && std::regex_match(arguments[2], zero_literal))
+                {
+                    continue;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool Shader::needs_mipmaps() const
+    {
+        return uses_filtered_sampling(vertex_code) || uses_filtered_sampling(fragment_code) || uses_filtered_sampling(compute_code);
+    }
+
+    std::regex footprint_pragma("#[ \\t]*pragma[ \\t]+footprint[ \\t]*\\([ \\t]*(\\w+)[ \\t]*\\)");
+
+    // resolve a pragma argument through the defines and #defines in code
+    unsigned int resolve_constant(const std::string& value, const Defines& defines, const std::string& code, unsigned int depth = 0)
+    {
+        if (value.find_first_not_of("0123456789") == std::string::npos)
+        {
+            return std::atoi(value.c_str());
+        }
+
+        if (depth < 8)
+        {
+            auto i = defines.find(value);
+            if (i != defines.end())
+            {
+                return resolve_constant(i->second, defines, code, depth + 1);
+            }
+
+            std::smatch match;
+            std::regex  define("#[ \\t]*define[ \\t]+" + value + "[ \\t]+(\\w+)");
+            if (std::regex_search(code, match, define))
+            {
+                return resolve_constant(match[1], defines, code, depth + 1);
+            }
+        }
+
+        throw std::runtime_error(compose("Footprint %0 is not a number.", value));
+    }
+
+    unsigned int Shader::get_footprint() const
+    {
+        std::string  code      = strip_comments(vertex_code) + "\n" + strip_comments(fragment_code) + "\n" + strip_comments(compute_code);
+        unsigned int footprint = 0;
+        for (std::sregex_iterator i(code.begin(), code.end(), footprint_pragma), end; i != end; ++i)
+        {
+            footprint = std::max(footprint, resolve_constant((*i)[1], defines, code));
+        }
+        return footprint;
+    }
+
+    void Shader::set_cache(ProgramCache* value)
+    {
+        cache = value;
+    }
+
+    ProgramCache* Shader::get_cache() const
+    {
+        return cache;
     }
 
     void Shader::compile() const
     {
-        if (program_id != 0)
+        if (current != NULL)
         {
             return;
         }
 
-        int status = 0;
-        char logstr[256];
-        
-        const GLchar* vbuff[1] = {vertex_code.c_str()};
+        auto i = variants.find(defines);
+        if (i != variants.end())
+        {
+            current = &i->second;
+            return;
+        }
 
-        unsigned int vertex_id = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex_id, 1, vbuff, NULL);
-        glCompileShader(vertex_id);
-        
-        glGetShaderInfoLog(vertex_id, 256, NULL, logstr);
+        // each define set is its own program, where the defines are real 
+        // compile time constants
+        bool        compute = is_compute();
+        std::string vcode   = inject_defines(compute ? compute_code : vertex_code, defines);
+        std::string fcode   = compute ? std::string("compute") : inject_defines(fragment_code, defines);
 
-        glGetShaderiv(vertex_id, GL_COMPILE_STATUS, &status);
-        if(! status)
+        if (compute && !GLEW_VERSION_4_3 && !GLEW_ARB_compute_shader)
         {
-            glDeleteShader(vertex_id);    
-            throw std::runtime_error(logstr);
+            throw std::runtime_error("Compute shaders need OpenGL 4.3.");
         }
 
-        const GLchar* fbuff[1] = {fragment_code.c_str()};
+        Variant variant;
+        variant.program_id = 0;
+
+        std::string key;
+        if (cache != NULL)
+        {
+            key                = cache->get_key(vcode, fcode);
+            variant.program_id = cache->load(key);
+            if (variant.program_id != 0)
+            {
+                reflect(variant);
+                current = &(variants[defines] = variant);
+                return;
+            }
+        }
+
+        std::vector<unsigned int> stages;
+        try
+        {
+            if (compute)
+            {
+                stages.push_back(compile_stage(GL_COMPUTE_SHADER, vcode));
+            }
+            else
+            {
+                stages.push_back(compile_stage(GL_VERTEX_SHADER, vcode));
+                stages.push_back(compile_stage(GL_FRAGMENT_SHADER, fcode));
+            }
+        }
+        catch (...)
+        {
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                glDeleteShader(stages[i]);
+            }
+            throw;
+        }
+
+        int status = 0;
+        char logstr[256];
+
+        unsigned int program_id = glCreateProgram();
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            glAttachShader(program_id, stages[i]);
+        }
+        if (cache != NULL && cache->is_supported())
+        {
+            glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program_id);
 
-        unsigned int fragment_id = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment_id, 1, fbuff, NULL);
-        glCompileShader(fragment_id);
+        glGetProgramInfoLog(program_id, 256, NULL, logstr);
 
-        glGetShaderInfoLog(fragment_id, 256, NULL, logstr);
+        // NOTE: glDeleteShader() actually does not delete the shader, it only
+        // flags the shader for deletion. The shaders will be deleted when
+        // the program gets deleted.
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            glDeleteShader(stages[i]);
+        }
 
-        glGetShaderiv(fragment_id, GL_COMPILE_STATUS, &status);
+        glGetProgramiv(program_id, GL_LINK_STATUS, &status);
         if(! status)
         {            
-            glDeleteShader(vertex_id);
-            glDeleteShader(fragment_id);
+            glDeleteProgram(program_id);
             throw std::runtime_error(logstr);
         }
 
-        program_id = glCreateProgram();
-        glAttachShader(program_id, vertex_id);
-        glAttachShader(program_id, fragment_id);
-        glLinkProgram(program_id);
+        if (cache != NULL)
+        {
+            cache->store(key, program_id);
+        }
+
+        variant.program_id = program_id;
+        reflect(variant);
+        current = &(variants[defines] = variant);
+    }
 
-        glGetShaderInfoLog(program_id, 256, NULL, logstr);
+    unsigned int Shader::compile_stage(unsigned int type, const std::string& code) const
+    {
+        int status = 0;
+        char logstr[256];
 
-        glGetShaderiv(program_id, GL_LINK_STATUS, &status);
+        const GLchar* buff[1] = {code.c_str()};
+
+        unsigned int id = glCreateShader(type);
+        glShaderSource(id, 1, buff, NULL);
+        glCompileShader(id);
+
+        glGetShaderInfoLog(id, 256, NULL, logstr);
+
+        glGetShaderiv(id, GL_COMPILE_STATUS, &status);
         if(! status)
-        {            
-            glDeleteShader(vertex_id);
-            glDeleteShader(fragment_id);
-            glDeleteProgram(program_id);
+        {
+            glDeleteShader(id);
             throw std::runtime_error(logstr);
         }
 
-        // NOTE: glDeleteShader() actually does not delete the shader, it only
-        // flags the shader for deletion. The shaders will be deleted when
-        // the program gets deleted.
-        glDeleteShader(vertex_id);
-        glDeleteShader(fragment_id);
+        return id;
+    }
+
+    rgm::uvec3 Shader::get_work_group_size() const
+    {
+        compile();
+        if (!is_compute())
+        {
+            throw std::logic_error("Only compute shaders have a work group size.");
+        }
+
+        GLint size[3] = {0, 0, 0};
+        glGetProgramiv(current->program_id, GL_COMPUTE_WORK_GROUP_SIZE, size);
+        return rgm::uvec3(size[0], size[1], size[2]);
+    }
+
+    void Shader::dispatch(rgm::uvec2 size) const
+    {
+        rgm::uvec3 local = get_work_group_size();
+        glDispatchCompute((size[0] + local[0] - 1) / local[0], (size[1] + local[1] - 1) / local[1], 1);
+
+        // whoever reads the result next: a texture fetch, a frame buffer 
+        // read or a copy
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
     }
 
     void Shader::bind() const
     {
         compile();
-        glUseProgram(program_id);
+        glUseProgram(current->program_id);
     }
 
     void Shader::unbind() const
@@ -119,141 +373,271 @@ namespace pkzo
         
     void Shader::release() const
     {
-        if (program_id != 0)
+        for (auto i = variants.begin(); i != variants.end(); ++i)
         {
-            glDeleteProgram(program_id);
-            program_id = 0;
+            glDeleteProgram(i->second.program_id);
         }
+        variants.clear();
+        current = NULL;
     }
 
     int Shader::get_attribute_location(const std::string& name) const
     {
-        return glGetAttribLocation(program_id, name.c_str());
+        compile();
+        auto i = current->attributes.find(name);
+        return i != current->attributes.end() ? i->second : -1;
     }
 
-    void Shader::set_uniform(const std::string& name, int value) const
+    UniformHandle Shader::uniform(const std::string& name) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
+        compile();
+        auto i = current->uniforms.find(name);
+        UniformHandle handle = {i != current->uniforms.end() ? i->second : -1};
+        return handle;
+    }
+
+    bool Shader::has_uniform(const std::string& name) const
+    {
+        return uniform(name).location != -1;
+    }
+
+    void Shader::reflect(Variant& variant) const
+    {
+        unsigned int program_id = variant.program_id;
+
+        char name[256];
+        int  count = 0;
+
+        glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &count);
+        for (int i = 0; i < count; i++)
         {
-            glUniform1i(location, value);
-        }        
+            GLsizei length = 0;
+            GLint   size   = 0;
+            GLenum  type   = 0;
+            glGetActiveUniform(program_id, i, sizeof(name), &length, &size, &type, name);
+
+            std::string n(name, length);
+            int location = glGetUniformLocation(program_id, n.c_str());
+            if (location == -1)
+            {
+                // uniform block members have no location
+                continue;
+            }
+            variant.uniforms[n] = location;
+
+            // arrays are reported as "name[0]", make "name" work too
+            size_t p = n.find("[0]");
+            if (p != std::string::npos && p + 3 == n.size())
+            {
+                variant.uniforms[n.substr(0, p)] = location;
+            }
+        }
+
+        glGetProgramiv(program_id, GL_ACTIVE_ATTRIBUTES, &count);
+        for (int i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint   size   = 0;
+            GLenum  type   = 0;
+            glGetActiveAttrib(program_id, i, sizeof(name), &length, &size, &type, name);
+
+            std::string n(name, length);
+            variant.attributes[n] = glGetAttribLocation(program_id, n.c_str());
+        }
+    }
+
+    void Shader::set_uniform(const std::string& name, int value) const
+    {
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, float value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform1f(location, value);
-        } 
+        set_uniform(uniform(name), value);
     }
-    
+
     void Shader::set_uniform(const std::string& name, unsigned int value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform1ui(location, value);
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::vec2 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform2fv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::vec3 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform3fv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::vec4 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform4fv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::ivec2 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform2iv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::ivec3 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform3iv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::ivec4 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform4iv(location, 1, value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::uvec2 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform2iv(location, 1, (const GLint*)value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::uvec3 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform3iv(location, 1, (const GLint*)value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, rgm::uvec4 value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
-        {
-            glUniform4iv(location, 1, (const GLint*)value.c_array());
-        }  
+        set_uniform(uniform(name), value);
     }
 
     void Shader::set_uniform(const std::string& name, const rgm::mat3& value) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
+        set_uniform(uniform(name), value);
+    }
+
+    void Shader::set_uniform(const std::string& name, const rgm::mat4& value) const
+    {
+        set_uniform(uniform(name), value);
+    }
+
+    void Shader::set_uniform(const std::string& name, const std::vector<float>& values) const
+    {
+        set_uniform(uniform(name), values);
+    }
+
+    void Shader::set_uniform(UniformHandle handle, int value) const
+    {
+        if (handle.location != -1)
         {
-            glUniformMatrix3fv(location, 1, GL_FALSE, value.c_array());
+            glUniform1i(handle.location, value);
         }
     }
 
-    void Shader::set_uniform(const std::string& name, const rgm::mat4& value) const
+    void Shader::set_uniform(UniformHandle handle, float value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform1f(handle.location, value);
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, unsigned int value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform1ui(handle.location, value);
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::vec2 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform2fv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::vec3 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform3fv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::vec4 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform4fv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::ivec2 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform2iv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::ivec3 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform3iv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::ivec4 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform4iv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::uvec2 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform2uiv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::uvec3 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform3uiv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, rgm::uvec4 value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniform4uiv(handle.location, 1, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, const rgm::mat3& value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniformMatrix3fv(handle.location, 1, GL_FALSE, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, const rgm::mat4& value) const
+    {
+        if (handle.location != -1)
+        {
+            glUniformMatrix4fv(handle.location, 1, GL_FALSE, value.c_array());
+        }
+    }
+
+    void Shader::set_uniform(UniformHandle handle, const std::vector<float>& values) const
     {
-        int location = glGetUniformLocation(program_id, name.c_str());
-        if (location != -1)
+        if (handle.location != -1 && !values.empty())
         {
-            glUniformMatrix4fv(location, 1, GL_FALSE, value.c_array());
+            glUniform1fv(handle.location, (GLsizei)values.size(), &values[0]);
         }
     }
 }
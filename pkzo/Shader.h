@@ -2,14 +2,27 @@
 #ifndef _PKZO_SHADER_H_
 #define _PKZO_SHADER_H_
 
+#include <map>
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 #include <rgm/rgm.h>
 
 #include "config.h"
+#include "Preprocessor.h"
 
 namespace pkzo
 {
+    class ProgramCache;
+
+    // Resolved uniform location; get it once with Shader::uniform and skip
+    // the name lookup on every set_uniform.
+    struct UniformHandle
+    {
+        int location;
+    };
+
     class PKZO_EXPORT Shader
     {
     public:
@@ -26,18 +39,69 @@ namespace pkzo
 
         const std::string& get_fragment_code() const;
 
+        // A shader with compute code is a compute program; the vertex and 
+        // fragment code are not used then.
+        void set_compute_code(const std::string& value);
+
+        const std::string& get_compute_code() const;
+
+        bool is_compute() const;
+
+        // Load and preprocess the files, see preprocess.
         void load(const std::string vertex_file, const std::string& fragment_file);
 
+        void load_compute(const std::string& file);
+
+        // The defines are injected after #version. Each define set compiles
+        // to its own program variant; switching back to a set that was 
+        // already used does not compile again. Uniform handles are only 
+        // valid for the variant they were taken from.
+        void set_defines(const Defines& value);
+
+        void set_define(const std::string& name, const std::string& value);
+
+        const Defines& get_defines() const;
+
+        size_t get_variant_count() const;
+
+        // Does any stage sample a texture with filtering, i.e. through 
+        // texture, textureGrad, ... and not only texelFetch or textureLod at
+        // a literal LOD of 0? Only then is it worth to build mipmaps for the
+        // input.
+        bool needs_mipmaps() const;
+
+        // How many pixels around the output pixel the shader reads, as 
+        // declared with #pragma footprint(N). N may also name a define. 
+        // Without the pragma the footprint is 0.
+        unsigned int get_footprint() const;
+
+        // Look up and store linked programs in cache; the cache must outlive
+        // the shader. NULL disables caching.
+        void set_cache(ProgramCache* value);
+
+        ProgramCache* get_cache() const;
+
         void compile() const;
 
         void bind() const;
 
+        rgm::uvec3 get_work_group_size() const;
+
+        // Run the bound compute program on enough work groups to cover 
+        // size, then make its writes visible to texture fetches, frame 
+        // buffer reads and copies.
+        void dispatch(rgm::uvec2 size) const;
+
         void unbind() const;
         
         void release() const;
         
         int get_attribute_location(const std::string& name) const;
 
+        UniformHandle uniform(const std::string& name) const;
+
+        bool has_uniform(const std::string& name) const;
+
         void set_uniform(const std::string& name, int value) const;
 
         void set_uniform(const std::string& name, unsigned int value) const;
@@ -66,10 +130,57 @@ namespace pkzo
 
         void set_uniform(const std::string& name, const rgm::mat4& value) const;
 
+        void set_uniform(const std::string& name, const std::vector<float>& values) const;
+
+        void set_uniform(UniformHandle handle, int value) const;
+
+        void set_uniform(UniformHandle handle, unsigned int value) const;
+
+        void set_uniform(UniformHandle handle, float value) const;
+
+        void set_uniform(UniformHandle handle, rgm::vec2 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::vec3 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::vec4 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::ivec2 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::ivec3 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::ivec4 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::uvec2 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::uvec3 value) const;
+
+        void set_uniform(UniformHandle handle, rgm::uvec4 value) const;
+
+        void set_uniform(UniformHandle handle, const rgm::mat3& value) const;
+
+        void set_uniform(UniformHandle handle, const rgm::mat4& value) const;
+
+        // float[] uniform, starting at the handle's element
+        void set_uniform(UniformHandle handle, const std::vector<float>& values) const;
+
     private:
         std::string vertex_code;
         std::string fragment_code;
-        mutable unsigned int program_id;
+        std::string compute_code;
+        Defines       defines;
+        ProgramCache* cache;
+
+        struct Variant
+        {
+            unsigned int                         program_id;
+            std::unordered_map<std::string, int> uniforms;
+            std::unordered_map<std::string, int> attributes;
+        };
+        mutable std::map<Defines, Variant> variants;
+        mutable Variant*                   current;
+
+        void reflect(Variant& variant) const;
+        unsigned int compile_stage(unsigned int type, const std::string& code) const;
 
         Shader(const Shader&) = delete;
         const Shader& operator = (const Shader&) = delete;
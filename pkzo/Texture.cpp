@@ -1,53 +1,226 @@
 
 #include "Texture.h"
+#include "Png.h"
 
 #include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
 #include <GL/glew.h>
-#include <png.h>
 
 #include "path.h"
 #include "compose.h"
 
 namespace pkzo
 {
+    size_t get_pixel_size(ColorFormat format)
+    {
+        switch (format)
+        {
+            case R8:
+                return 1;
+            case RG8:
+            case R16:
+                return 2;
+            case RGB:
+                return 3;
+            case RGBA:
+            case RG16:
+            case R32F:
+            case DEPTH:
+                return 4;
+            case RGB16:
+                return 6;
+            case RGBA16:
+            case RGBA16F:
+                return 8;
+            case RGBA32F:
+                return 16;
+            default:
+                throw std::logic_error("Unknown pixel format.");
+        }
+    }
+
+    size_t get_channel_count(ColorFormat format)
+    {
+        switch (format)
+        {
+            case DEPTH:
+            case R8:
+            case R16:
+            case R32F:
+                return 1;
+            case RG8:
+            case RG16:
+                return 2;
+            case RGB:
+            case RGB16:
+                return 3;
+            case RGBA:
+            case RGBA16:
+            case RGBA16F:
+            case RGBA32F:
+                return 4;
+            default:
+                throw std::logic_error("Unknown pixel format.");
+        }
+    }
+
+    int get_gl_format(ColorFormat format)
+    {
+        if (format == DEPTH)
+        {
+            return GL_DEPTH_COMPONENT;
+        }
+
+        switch (get_channel_count(format))
+        {
+            case 1:
+                return GL_RED;
+            case 2:
+                return GL_RG;
+            case 3:
+                return GL_RGB;
+            default:
+                return GL_RGBA;
+        }
+    }
+
+    int get_gl_type(ColorFormat format)
+    {
+        switch (format)
+        {
+            case R8:
+            case RG8:
+            case RGB:
+            case RGBA:
+                return GL_UNSIGNED_BYTE;
+            case R16:
+            case RG16:
+            case RGB16:
+            case RGBA16:
+                return GL_UNSIGNED_SHORT;
+            case RGBA16F:
+                return GL_HALF_FLOAT;
+            case DEPTH:
+            case R32F:
+            case RGBA32F:
+                return GL_FLOAT;
+            default:
+                throw std::logic_error("Unknown pixel format.");
+        }
+    }
+
+    int get_gl_internal_format(ColorFormat format)
+    {
+        switch (format)
+        {
+            case DEPTH:
+                return GL_DEPTH_COMPONENT32F;
+            case R8:
+                return GL_R8;
+            case RG8:
+                return GL_RG8;
+            case RGB:
+                return GL_RGB8;
+            case RGBA:
+                return GL_RGBA8;
+            case R16:
+                return GL_R16;
+            case RG16:
+                return GL_RG16;
+            case RGB16:
+                return GL_RGB16;
+            case RGBA16:
+                return GL_RGBA16;
+            case R32F:
+                return GL_R32F;
+            case RGBA16F:
+                return GL_RGBA16F;
+            case RGBA32F:
+                return GL_RGBA32F;
+            default:
+                throw std::logic_error("Unknown pixel format.");
+        }
+    }
+
+    unsigned int get_max_texture_size()
+    {
+        GLint value = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &value);
+        return value;
+    }
+
     Texture::Texture() 
-    : glid(0), size(0, 0) {}
+    : glid(0), size(0, 0), format(NOCF), levels(0), filter(LINEAR), mipmaps(false), adopted(NULL) {}
 
     Texture::Texture(rgm::uvec2 s, ColorFormat f)
-    : glid(0), size(s), format(f) {}
+    : glid(0), size(s), format(f), levels(0), filter(LINEAR), mipmaps(false), adopted(NULL) {}
 
     Texture::Texture(rgm::uvec2 s, ColorFormat f, std::vector<unsigned char>&& d)
-    : glid(0), size(s), format(f), data(d) {}
+    : glid(0), size(s), format(f), levels(0), filter(LINEAR), mipmaps(false), data(std::move(d)), adopted(NULL) {}
+
+    Texture::Texture(rgm::uvec2 s, ColorFormat f, const unsigned char* p, std::function<void ()> free)
+    : glid(0), size(s), format(f), levels(0), filter(LINEAR), mipmaps(false), adopted(p), adopted_free(free) {}
 
     Texture::Texture(Texture&& other)
-    : glid(other.glid), size(other.size), format(other.format), data(other.data)
+    : glid(other.glid), size(other.size), format(other.format), levels(other.levels), filter(other.filter), mipmaps(other.mipmaps), data(std::move(other.data)), 
+      adopted(other.adopted), adopted_free(std::move(other.adopted_free))
     {
-        other.glid   = 0;
-        other.size   = rgm::uvec2(0, 0);
-        other.format = NOCF;
+        other.glid    = 0;
+        other.size    = rgm::uvec2(0, 0);
+        other.format  = NOCF;
+        other.adopted = NULL;
+        other.adopted_free = nullptr;
     }
         
 
     Texture::~Texture() 
     {
         release();         
+        free_adopted();
     }
 
     const Texture& Texture::operator = (Texture&& other)
     {
-        glid   = other.glid;
-        size   = other.size;
-        format = other.format;
-        
-        other.glid   = 0;
-        other.size   = rgm::uvec2(0, 0);
-        other.format = NOCF;
+        if (this == &other)
+        {
+            return *this;
+        }
 
-        data   = std::move(other.data);
+        release();
+        free_adopted();
+
+        glid    = other.glid;
+        size    = other.size;
+        format  = other.format;
+        levels  = other.levels;
+        filter  = other.filter;
+        mipmaps = other.mipmaps;
+        data    = std::move(other.data);
+        adopted = other.adopted;
+        adopted_free = std::move(other.adopted_free);
+        
+        other.glid    = 0;
+        other.size    = rgm::uvec2(0, 0);
+        other.format  = NOCF;
+        other.adopted = NULL;
+        other.adopted_free = nullptr;
 
         return *this;
     }
 
+    void Texture::free_adopted()
+    {
+        if (adopted_free)
+        {
+            adopted_free();
+            adopted_free = nullptr;
+        }
+        adopted = NULL;
+    }
+
     unsigned int Texture::get_glid() const
     {
         if (glid == 0)
@@ -67,9 +240,26 @@ namespace pkzo
         return format;
     }
 
-    const unsigned char* Texture::get_data() const
+    PixelView Texture::view() const
     {
-        return &data[0];
+        PixelView v;
+        v.data   = adopted != NULL ? adopted : (!data.empty() ? &data[0] : NULL);
+        v.size   = size;
+        v.format = format;
+        v.stride = v.data != NULL ? size[0] * get_pixel_size(format) : 0;
+        return v;
+    }
+
+    unsigned int get_mip_levels(rgm::uvec2 size)
+    {
+        unsigned int levels = 1;
+        unsigned int s = std::max(size[0], size[1]);
+        while (s > 1)
+        {
+            s = s / 2;
+            levels++;
+        }
+        return levels;
     }
 
     void Texture::upload()
@@ -82,167 +272,182 @@ namespace pkzo
         glGenTextures(1, &glid);                    
         glBindTexture(GL_TEXTURE_2D, glid);
         
-        // TODO filter modes...
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        levels = mipmaps ? get_mip_levels(size) : 1;
+        apply_filter();
+
+        // filtered lookups next to the border must not wrap to the other side
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // gray and gray alpha sample as such, not as red and green
+        if (format != DEPTH && get_channel_count(format) <= 2)
+        {
+            GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, get_channel_count(format) == 2 ? GL_GREEN : GL_ONE};
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
 
         //float aniso = 0.0f;
         //glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
         //glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
         
-        int mode = 0;
-        switch (format)
+        int internal = get_gl_internal_format(format);
+        int mode     = get_gl_format(format);
+        int type     = get_gl_type(format);
+        
+        const void* d = view().data;
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        // Immutable storage lets the driver skip the completeness checks and
+        // the content can later be replaced with glTexSubImage2D (update).
+        if (GLEW_ARB_texture_storage)
         {
-            case DEPTH:
-                mode = GL_DEPTH;
-                break;
-            case RGB:
-                mode = GL_RGB;    
-                break;
-            case RGBA:
-                mode = GL_RGBA;
-                break;
-            default:
-                throw std::logic_error("Unknown pixel format.");
+            glTexStorage2D(GL_TEXTURE_2D, levels, internal, size[0], size[1]);
+            if (d != NULL)
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size[0], size[1], mode, type, d);
+            }
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, internal, size[0], size[1], 0, mode, type, d);
         }
-        
-        void* d = !data.empty() ? &data[0] : NULL;
 
-        // TOOD different format types...
-        glTexImage2D(GL_TEXTURE_2D, 0, mode, size[0], size[1], 0, mode, GL_UNSIGNED_BYTE, d);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if (levels > 1 && d != NULL)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
     }
 
-    void Texture::release()
+    void Texture::apply_filter()
     {
-        if (glid != 0)
+        int min = 0;
+        int mag = 0;
+        switch (filter)
         {
-            glDeleteTextures(1, &glid);
-            glid = 0;
-        } 
+            case NEAREST:
+                min = levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+                mag = GL_NEAREST;
+                break;
+            case LINEAR:
+                min = levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+                mag = GL_LINEAR;
+                break;
+            default:
+                throw std::logic_error("Unknown filter mode.");
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
     }
 
-    void Texture::bind(unsigned int channel)
+    void Texture::update(const unsigned char* pixels)
     {
         upload();
 
-        glActiveTexture(GL_TEXTURE0 + channel);
         glBindTexture(GL_TEXTURE_2D, glid);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size[0], size[1], get_gl_format(format), get_gl_type(format), pixels);
+        if (levels > 1)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    Texture load_png(const std::string& file)
+    unsigned int Texture::get_levels() const
     {
-        unsigned char header[8];
+        return levels;
+    }
 
-        FILE *fp = fopen(file.c_str(), "rb");
-        if (fp == NULL)
-        {
-            throw std::runtime_error(compose("Failed to open %0 for reading.", file));
-        }
-        fread(header, 1, 8, fp);
-               
-        if (png_sig_cmp(header, 0, 8))
-        {
-            throw std::runtime_error(compose("%0 is not a PNG.", file));
-        }
-        
-        png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-        png_infop info_ptr = png_create_info_struct(png_ptr);    
-        
-        if (setjmp(png_jmpbuf(png_ptr)))
+    void Texture::set_filter(FilterMode value)
+    {
+        filter = value;
+        if (glid != 0)
         {
-            throw std::runtime_error(compose("Error while reading %0.", file));
+            glBindTexture(GL_TEXTURE_2D, glid);
+            apply_filter();
+            glBindTexture(GL_TEXTURE_2D, 0);
         }
-        
-        png_init_io(png_ptr, fp);
-        png_set_sig_bytes(png_ptr, 8);
-
-        png_read_info(png_ptr, info_ptr);
+    }
 
-        int      width      = png_get_image_width(png_ptr, info_ptr);
-        int      height     = png_get_image_height(png_ptr, info_ptr);
-        png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-        png_byte bit_depth  = png_get_bit_depth(png_ptr, info_ptr);
+    FilterMode Texture::get_filter() const
+    {
+        return filter;
+    }
 
-        
-        ColorFormat cf;
-        switch (color_type)
+    void Texture::set_mipmaps(bool value)
+    {
+        if (mipmaps != value)
         {
-            case PNG_COLOR_TYPE_RGB:
-                cf = RGB;
-                break;
-            case PNG_COLOR_TYPE_RGB_ALPHA:
-                cf = RGBA;
-                break;
-            default:
-                throw std::runtime_error("Unsupported color type.");
+            mipmaps = value;
+            // the storage is immutable, the level count can not be changed
+            release();
         }
+    }
 
-        if (bit_depth != 8)
+    bool Texture::get_mipmaps() const
+    {
+        return mipmaps;
+    }
+
+    void Texture::release()
+    {
+        if (glid != 0)
         {
-            // yes, yes... 
-            throw std::runtime_error("Unsupported color depth.");
-        }
+            glDeleteTextures(1, &glid);
+            glid = 0;
+        } 
+    }
 
-        int number_of_passes = png_set_interlace_handling(png_ptr);
-        png_read_update_info(png_ptr, info_ptr);                
+    void Texture::bind(unsigned int channel)
+    {
+        upload();
 
-        std::vector<png_byte> buffer(height * png_get_rowbytes(png_ptr, info_ptr));
-        std::vector<png_bytep> ptrs(height);
+        glActiveTexture(GL_TEXTURE0 + channel);
+        glBindTexture(GL_TEXTURE_2D, glid);
+    }
 
-        for (int y = 0; y < height; y++)
-        {
-            ptrs[y] = &buffer[y * png_get_rowbytes(png_ptr, info_ptr)];
-        }                
-        png_read_image(png_ptr, &ptrs[0]);
+    void Texture::bind_image(unsigned int unit)
+    {
+        upload();
 
-        fclose(fp);
-        
-        return Texture(rgm::uvec2(width, height), cf, std::move(buffer));    
+        glBindImageTexture(unit, glid, 0, GL_FALSE, 0, GL_WRITE_ONLY, get_gl_internal_format(format));
     }
 
-    void write_png(Texture& texture, const std::string& file)
+    Texture load_png(const std::string& file)
     {
-        FILE *fp = fopen(file.c_str(), "wb");
-        if (fp == NULL)
+        PngReader reader(file);
+
+        std::vector<unsigned char> buffer(reader.get_size()[1] * reader.get_stride());
+        if (!buffer.empty())
         {
-            throw std::runtime_error(compose("Failed to open %0 for writing.", file));
+            reader.read(&buffer[0], reader.get_size()[1], reader.get_stride());
         }
 
-        png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-        png_infop info_ptr = png_create_info_struct(png_ptr);    
+        return Texture(reader.get_size(), reader.get_format(), std::move(buffer));
+    }
 
-        if (setjmp(png_jmpbuf(png_ptr)))
+    void write_png(Texture& texture, const std::string& file)
+    {
+        PixelView view = texture.view();
+        if (view.data == NULL)
         {
-             throw std::runtime_error(compose("Error while writing %0.", file));        
+            throw std::logic_error("Texture has no pixels to write.");
         }
 
-        png_init_io(png_ptr, fp);
-
-        int      width      = texture.get_size()[0];
-        int      height     = texture.get_size()[0];
-        png_byte color_type = texture.get_format() == RGB ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA;
-        png_byte bit_depth  = 8;
-
-        png_set_IHDR(png_ptr, info_ptr, width, height,
-                     bit_depth, color_type, PNG_INTERLACE_NONE,
-                     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-        
-        png_write_info(png_ptr, info_ptr);
-
-
-        png_byte* buffer = (png_byte*)texture.get_data();
-        std::vector<png_bytep> ptrs(height);
-
-        for (int y = 0; y < height; y++)
+        // floats are kept as well as a PNG can
+        if (view.format == R32F || view.format == RGBA16F || view.format == RGBA32F)
         {
-            ptrs[y] = &buffer[y * png_get_rowbytes(png_ptr, info_ptr)];
+            Texture fixed = convert(texture, view.format == R32F ? R16 : RGBA16);
+            write_png(fixed, file);
+            return;
         }
-        png_write_image(png_ptr, &ptrs[0]);
-
-        png_write_end(png_ptr, NULL);
 
-        fclose(fp);
+        PngWriter writer(file, view.size, view.format);
+        writer.write(view.data, view.size[1], view.stride);
+        writer.finish();
     }
 
     void Texture::load(const std::string& file)
@@ -275,29 +480,184 @@ namespace pkzo
 
     void Texture::readback()
     {
-        int mode = 0;
-        size_t isize = 0;
-        switch (format)
-        {            
-            case RGB:
-                mode = GL_RGB;    
-                isize = 3;
+        int mode = get_gl_format(format);
+        size_t isize = get_pixel_size(format);
+
+        free_adopted();
+        if (data.size() != size[0] * size[1] * isize)
+        {
+            data.resize(size[0] * size[1] * isize);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, glid);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D, 0, mode, get_gl_type(format), &data[0]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    float half_to_float(unsigned short value)
+    {
+        unsigned int sign     = (value >> 15) & 1;
+        unsigned int exponent = (value >> 10) & 0x1f;
+        unsigned int mantissa = value & 0x3ff;
+
+        float result;
+        if (exponent == 0)
+        {
+            result = std::ldexp((float)mantissa, -24);
+        }
+        else if (exponent == 31)
+        {
+            result = mantissa == 0 ? std::numeric_limits<float>::infinity() : std::numeric_limits<float>::quiet_NaN();
+        }
+        else
+        {
+            result = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+        }
+        return sign ? -result : result;
+    }
+
+    unsigned short float_to_half(float value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        unsigned int sign     = (bits >> 16) & 0x8000;
+        int          exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        unsigned int mantissa = bits & 0x7fffff;
+
+        if (((bits >> 23) & 0xff) == 0xff)
+        {
+            return (unsigned short)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+        }
+        if (exponent >= 31)
+        {
+            return (unsigned short)(sign | 0x7c00);
+        }
+        if (exponent <= 0)
+        {
+            if (exponent < -10)
+            {
+                return (unsigned short)sign;
+            }
+            // denormal, round to nearest
+            mantissa |= 0x800000;
+            unsigned int shift = 14 - exponent;
+            return (unsigned short)(sign | ((mantissa + (1 << (shift - 1))) >> shift));
+        }
+
+        // round to nearest even, a carry into the exponent is still right
+        unsigned int half  = sign | (exponent << 10) | (mantissa >> 13);
+        bool         round = (mantissa & 0x1000) != 0 && (mantissa & 0x2fff) != 0;
+        return (unsigned short)(half + (round ? 1 : 0));
+    }
+
+    void decode_pixel(const unsigned char* pixel, ColorFormat format, float* rgba)
+    {
+        float  c[4]     = {0.0f, 0.0f, 0.0f, 1.0f};
+        size_t channels = get_channel_count(format);
+        for (size_t i = 0; i < channels; i++)
+        {
+            switch (get_gl_type(format))
+            {
+                case GL_UNSIGNED_BYTE:
+                    c[i] = pixel[i] / 255.0f;
+                    break;
+                case GL_UNSIGNED_SHORT:
+                {
+                    unsigned short v;
+                    memcpy(&v, pixel + 2 * i, sizeof(v));
+                    c[i] = v / 65535.0f;
+                    break;
+                }
+                case GL_HALF_FLOAT:
+                {
+                    unsigned short h;
+                    memcpy(&h, pixel + 2 * i, sizeof(h));
+                    c[i] = half_to_float(h);
+                    break;
+                }
+                default:
+                    memcpy(&c[i], pixel + 4 * i, sizeof(float));
+                    break;
+            }
+        }
+
+        switch (channels)
+        {
+            case 1:
+                rgba[0] = rgba[1] = rgba[2] = c[0];
+                rgba[3] = 1.0f;
                 break;
-            case RGBA:
-                mode = GL_RGBA;
-                isize = 4;
+            case 2:
+                rgba[0] = rgba[1] = rgba[2] = c[0];
+                rgba[3] = c[1];
                 break;
             default:
-                throw std::logic_error("Unknown pixel format.");
+                memcpy(rgba, c, sizeof(c));
+                break;
         }
+    }
 
-        if (data.empty())
+    void encode_pixel(const float* rgba, ColorFormat format, unsigned char* pixel)
+    {
+        float  c[4];
+        size_t channels = get_channel_count(format);
+        if (channels <= 2)
         {
-            data.resize(size[0] * size[1] * isize);
+            c[0] = 0.2126f * rgba[0] + 0.7152f * rgba[1] + 0.0722f * rgba[2];
+            c[1] = rgba[3];
+        }
+        else
+        {
+            memcpy(c, rgba, sizeof(c));
         }
 
-        glBindTexture(GL_TEXTURE_2D, glid);
-        glGetTexImage(GL_TEXTURE_2D, 0, mode, GL_UNSIGNED_BYTE, &data[0]);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        for (size_t i = 0; i < channels; i++)
+        {
+            switch (get_gl_type(format))
+            {
+                case GL_UNSIGNED_BYTE:
+                    pixel[i] = (unsigned char)(std::min(std::max(c[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+                    break;
+                case GL_UNSIGNED_SHORT:
+                {
+                    unsigned short v = (unsigned short)(std::min(std::max(c[i], 0.0f), 1.0f) * 65535.0f + 0.5f);
+                    memcpy(pixel + 2 * i, &v, sizeof(v));
+                    break;
+                }
+                case GL_HALF_FLOAT:
+                {
+                    unsigned short h = float_to_half(c[i]);
+                    memcpy(pixel + 2 * i, &h, sizeof(h));
+                    break;
+                }
+                default:
+                    memcpy(pixel + 4 * i, &c[i], sizeof(float));
+                    break;
+            }
+        }
+    }
+
+    Texture convert(const Texture& texture, ColorFormat format)
+    {
+        PixelView view = texture.view();
+        if (view.data == NULL)
+        {
+            throw std::logic_error("Texture has no pixels to convert.");
+        }
+
+        size_t                     isize = get_pixel_size(view.format);
+        size_t                     osize = get_pixel_size(format);
+        size_t                     count = view.size[0] * view.size[1];
+        std::vector<unsigned char> data(count * osize);
+        for (size_t i = 0; i < count; i++)
+        {
+            float rgba[4];
+            decode_pixel(view.data + i * isize, view.format, rgba);
+            encode_pixel(rgba, format, &data[i * osize]);
+        }
+
+        return Texture(view.size, format, std::move(data));
     }
 }
@@ -6,16 +6,61 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include <rgm/rgm.h>
 
 namespace pkzo
 {
+    // The 8 and 16 bit formats are normalized to 0..1. The F formats hold
+    // floats that are not clamped, for intermediate results; RGBA16F is 
+    // half floats at half the memory and bandwidth of RGBA32F. One channel
+    // is gray and two are gray and alpha; that is also how they sample.
     enum ColorFormat
     {
         NOCF,
         DEPTH,
         RGB,
-        RGBA
+        RGBA,
+        R8,
+        RG8,
+        R32F,
+        RGBA16F,
+        RGBA32F,
+        R16,
+        RG16,
+        RGB16,
+        RGBA16
+    };
+
+    enum FilterMode
+    {
+        NEAREST,
+        LINEAR
+    };
+
+    // bytes per pixel in CPU memory
+    PKZO_EXPORT size_t get_pixel_size(ColorFormat format);
+
+    PKZO_EXPORT size_t get_channel_count(ColorFormat format);
+
+    // pixel transfer format, type and storage format
+    PKZO_EXPORT int get_gl_format(ColorFormat format);
+
+    PKZO_EXPORT int get_gl_type(ColorFormat format);
+
+    PKZO_EXPORT int get_gl_internal_format(ColorFormat format);
+
+    // largest width or height of a texture in the current context
+    PKZO_EXPORT unsigned int get_max_texture_size();
+
+    // Non-owning view of a texture's pixels; valid as long as the texture
+    // is neither modified nor destroyed.
+    struct PixelView
+    {
+        const unsigned char* data;
+        rgm::uvec2           size;
+        ColorFormat          format;
+        size_t               stride;
     };
 
     class PKZO_EXPORT Texture
@@ -28,6 +73,11 @@ namespace pkzo
 
         Texture(rgm::uvec2 size, ColorFormat format, std::vector<unsigned char>&& data);
 
+        // Adopt pixels owned by someone else (a mapped file, shared memory, 
+        // ...) without copying them. free is called once the texture no 
+        // longer needs them.
+        Texture(rgm::uvec2 size, ColorFormat format, const unsigned char* pixels, std::function<void ()> free);
+
         Texture(const Texture&) = delete;
 
         Texture(Texture&& other);
@@ -44,14 +94,31 @@ namespace pkzo
 
         ColorFormat get_format() const;
 
-        const unsigned char* get_data() const;
+        PixelView view() const;
+
+        unsigned int get_levels() const;
+
+        void set_filter(FilterMode value);
+
+        FilterMode get_filter() const;
+
+        // Mipmaps are only allocated and generated when asked for; image 
+        // filters that use texelFetch never look past level 0.
+        void set_mipmaps(bool value);
+
+        bool get_mipmaps() const;
 
         void upload();
 
+        void update(const unsigned char* pixels);
+
         void release();
 
         void bind(unsigned int channel);
 
+        // bind level 0 to an image unit, for compute shaders to write
+        void bind_image(unsigned int unit);
+
         void load(const std::string& file);
 
         void save(const std::string& file);
@@ -62,9 +129,30 @@ namespace pkzo
         unsigned int               glid;
         rgm::uvec2                 size;
         ColorFormat                format;
+        unsigned int               levels;
+        FilterMode                 filter;
+        bool                       mipmaps;
         std::vector<unsigned char> data;
+        const unsigned char*       adopted;
+        std::function<void ()>     adopted_free;
+
+        void free_adopted();
+        void apply_filter();
     };
 
+    // Convert the pixels on the CPU, clamping when going to 8 or 16 bit. 
+    // Gray is the luminance of the color; a missing alpha is 1.
+    PKZO_EXPORT Texture convert(const Texture& texture, ColorFormat format);
+
+    // IEEE half floats, rounding to nearest even
+    PKZO_EXPORT float half_to_float(unsigned short value);
+
+    PKZO_EXPORT unsigned short float_to_half(float value);
+
+    // One pixel as RGBA floats, the way a shader samples it: gray is RRR1
+    // and gray alpha RRRG.
+    PKZO_EXPORT void decode_pixel(const unsigned char* pixel, ColorFormat format, float* rgba);
+
 }
 
 #endif
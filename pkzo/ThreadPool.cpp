@@ -0,0 +1,198 @@
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace pkzo
+{
+    ThreadPool::ThreadPool(unsigned int count)
+    : stopping(false), generation(0), busy(0), task(NULL), remaining(0), failed(false), steals(0)
+    {
+        if (count == 0)
+        {
+            count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            workers.push_back(std::unique_ptr<Worker>(new Worker));
+        }
+
+        // worker 0 is the thread calling run
+        for (unsigned int i = 1; i < count; i++)
+        {
+            threads.push_back(std::thread([this, i] () {
+                serve(i);
+            }));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_all();
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    unsigned int ThreadPool::get_thread_count() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    size_t ThreadPool::get_steals() const
+    {
+        return steals;
+    }
+
+    void ThreadPool::run(size_t count, const std::function<void (size_t)>& t)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // a thread may still be leaving the last run
+        done.wait(lock, [this] () {
+            return busy == 0;
+        });
+
+        task      = &t;
+        remaining = count;
+        failed    = false;
+        error     = std::exception_ptr();
+
+        size_t n = workers.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            std::lock_guard<std::mutex> worker_lock(workers[i]->mutex);
+            for (size_t j = i * count / n; j < (i + 1) * count / n; j++)
+            {
+                workers[i]->tasks.push_back(j);
+            }
+        }
+
+        generation++;
+        wake.notify_all();
+        lock.unlock();
+
+        work(0, t);
+
+        lock.lock();
+        done.wait(lock, [this] () {
+            return remaining == 0 && busy == 0;
+        });
+        task = NULL;
+
+        if (error)
+        {
+            std::exception_ptr e = error;
+            error = std::exception_ptr();
+            std::rethrow_exception(e);
+        }
+    }
+
+    void ThreadPool::serve(unsigned int index)
+    {
+        unsigned int seen = 0;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] () {
+                return stopping || generation != seen;
+            });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            seen = generation;
+            // woken too late, the run is already over
+            if (task == NULL)
+            {
+                continue;
+            }
+
+            const std::function<void (size_t)>& t = *task;
+            busy++;
+            lock.unlock();
+
+            work(index, t);
+
+            lock.lock();
+            busy--;
+            done.notify_all();
+        }
+    }
+
+    void ThreadPool::work(unsigned int index, const std::function<void (size_t)>& t)
+    {
+        size_t i;
+        while (take(index, i) || steal(index, i))
+        {
+            if (!failed)
+            {
+                try
+                {
+                    t(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+
+            if (--remaining == 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    bool ThreadPool::take(unsigned int index, size_t& value)
+    {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+        {
+            return false;
+        }
+        value = worker.tasks.front();
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool ThreadPool::steal(unsigned int index, size_t& value)
+    {
+        size_t n = workers.size();
+        for (size_t i = 1; i < n; i++)
+        {
+            Worker& victim = *workers[(index + i) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                value = victim.tasks.back();
+                victim.tasks.pop_back();
+                steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+}
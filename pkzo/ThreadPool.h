@@ -0,0 +1,82 @@
+
+#ifndef _PKZO_THREAD_POOL_H_
+#define _PKZO_THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+
+#include "config.h"
+
+namespace pkzo
+{
+    // A fixed set of threads to run many small tasks, such as the tiles of
+    // the CPU filters. Every thread has its own deque of tasks and takes
+    // them from the front; once it runs out it steals from the back of
+    // another thread's deque. A run deals each thread one contiguous range
+    // of the tasks, so neighboring tiles tend to stay on one core and only
+    // the uneven ends of the ranges move.
+    class PKZO_EXPORT ThreadPool
+    {
+    public:
+
+        // The calling thread of run counts as one of the threads; 0 is one
+        // per hardware thread.
+        ThreadPool(unsigned int threads = 0);
+
+        ~ThreadPool();
+
+        unsigned int get_thread_count() const;
+
+        // Run task(0) .. task(count - 1) and return once all are done. If
+        // tasks throw, the remaining tasks are skipped and the first
+        // exception is thrown here. One run at a time.
+        void run(size_t count, const std::function<void (size_t)>& task);
+
+        // tasks that ran on another thread than they were dealt to
+        size_t get_steals() const;
+
+    private:
+        struct Worker
+        {
+            std::mutex         mutex;
+            std::deque<size_t> tasks;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread>             threads;
+
+        // guards the state of the current run and wakes the threads
+        std::mutex              mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        bool                    stopping;
+        unsigned int            generation;
+        unsigned int            busy;
+
+        const std::function<void (size_t)>* task;
+        std::atomic<size_t>                 remaining;
+        std::atomic<bool>                   failed;
+        std::exception_ptr                  error;
+        std::atomic<size_t>                 steals;
+
+        void serve(unsigned int index);
+
+        void work(unsigned int index, const std::function<void (size_t)>& task);
+
+        bool take(unsigned int index, size_t& value);
+
+        bool steal(unsigned int index, size_t& value);
+
+        ThreadPool(const ThreadPool&) = delete;
+        const ThreadPool& operator = (const ThreadPool&) = delete;
+    };
+}
+
+#endif
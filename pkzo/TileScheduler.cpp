@@ -0,0 +1,165 @@
+
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <vector>
+#else
+#include <unistd.h>
+#endif
+
+namespace pkzo
+{
+    // tiles start at multiples of this many pixels, a cache line of floats
+    const unsigned int tile_alignment = 16;
+
+    // tiles per thread, so that stealing can even out uneven tiles
+    const unsigned int tiles_per_thread = 4;
+
+    size_t detect_l2_cache_size()
+    {
+    #ifdef _WIN32
+        DWORD length = 0;
+        GetLogicalProcessorInformation(NULL, &length);
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || length == 0)
+        {
+            return 0;
+        }
+        std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        if (!GetLogicalProcessorInformation(&infos[0], &length))
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < infos.size(); i++)
+        {
+            if (infos[i].Relationship == RelationCache && infos[i].Cache.Level == 2)
+            {
+                return infos[i].Cache.Size;
+            }
+        }
+        return 0;
+    #elif defined(_SC_LEVEL2_CACHE_SIZE)
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return size > 0 ? (size_t)size : 0;
+    #else
+        return 0;
+    #endif
+    }
+
+    size_t get_l2_cache_size()
+    {
+        static const size_t detected = detect_l2_cache_size();
+        return detected != 0 ? detected : 256 * 1024;
+    }
+
+    unsigned int round_up(unsigned int value, unsigned int step)
+    {
+        return (value + step - 1) / step * step;
+    }
+
+    unsigned int divide_up(unsigned int value, unsigned int divisor)
+    {
+        return (value + divisor - 1) / divisor;
+    }
+
+    // Half of the cache is for the tile, the rest for what else the kernel
+    // and other threads on the core touch.
+    TileScheduler::TileScheduler(unsigned int threads, size_t c)
+    : pool(threads), cache_size(c != 0 ? c : get_l2_cache_size() / 2) {}
+
+    TileScheduler::~TileScheduler() {}
+
+    unsigned int TileScheduler::get_thread_count() const
+    {
+        return pool.get_thread_count();
+    }
+
+    size_t TileScheduler::get_cache_size() const
+    {
+        return cache_size;
+    }
+
+    ThreadPool& TileScheduler::get_pool()
+    {
+        return pool;
+    }
+
+    rgm::uvec2 TileScheduler::get_tile_size(rgm::uvec2 size, unsigned int halo, unsigned int planes) const
+    {
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return rgm::uvec2(1, 1);
+        }
+
+        size_t row_bytes = std::max(planes, 1u) * sizeof(float);
+
+        // Long rows are best for the SIMD kernels, but the tile should be
+        // higher than its halo or most of what is loaded is halo.
+        unsigned int width  = std::min(round_up(size[0], tile_alignment), 2048u);
+        unsigned int height = 0;
+        while (true)
+        {
+            size_t rows = cache_size / (row_bytes * (width + 2 * halo));
+            height = rows > 2 * halo ? (unsigned int)(rows - 2 * halo) : 0;
+            if (height >= std::max(halo, tile_alignment) || width <= tile_alignment)
+            {
+                break;
+            }
+            width = round_up(width / 2, tile_alignment);
+        }
+        height = std::min(std::max(height, 1u), size[1]);
+
+        // enough tiles to keep all threads busy
+        unsigned int columns = divide_up(size[0], width);
+        unsigned int wanted  = tiles_per_thread * pool.get_thread_count();
+        if (columns * divide_up(size[1], height) < wanted)
+        {
+            height = std::max(divide_up(size[1], divide_up(wanted, columns)), 1u);
+        }
+
+        return rgm::uvec2(width, height);
+    }
+
+    void TileScheduler::run(rgm::uvec2 size, rgm::uvec2 tile, const std::function<void (const Tile&)>& kernel)
+    {
+        if (size[0] == 0 || size[1] == 0)
+        {
+            return;
+        }
+
+        unsigned int width   = round_up(std::max(tile[0], 1u), tile_alignment);
+        unsigned int height  = std::max(tile[1], 1u);
+        unsigned int columns = divide_up(size[0], width);
+        unsigned int rows    = divide_up(size[1], height);
+
+        // row by row, so that each thread's range of tiles is a band
+        pool.run(columns * rows, [&] (size_t i) {
+            unsigned int x = (unsigned int)(i % columns) * width;
+            unsigned int y = (unsigned int)(i / columns) * height;
+            Tile t;
+            t.origin = rgm::uvec2(x, y);
+            t.size   = rgm::uvec2(std::min(width, size[0] - x), std::min(height, size[1] - y));
+            kernel(t);
+        });
+    }
+
+    void TileScheduler::run(rgm::uvec2 size, unsigned int halo, unsigned int planes, const std::function<void (const Tile&)>& kernel)
+    {
+        run(size, get_tile_size(size, halo, planes), kernel);
+    }
+
+    void TileScheduler::run_rows(unsigned int height, const std::function<void (unsigned int first, unsigned int count)>& kernel)
+    {
+        unsigned int bands = std::min(height, tiles_per_thread * pool.get_thread_count());
+        pool.run(bands, [&] (size_t i) {
+            unsigned int first = (unsigned int)(i * height / bands);
+            unsigned int last  = (unsigned int)((i + 1) * height / bands);
+            kernel(first, last - first);
+        });
+    }
+}
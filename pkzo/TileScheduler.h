@@ -0,0 +1,69 @@
+
+#ifndef _PKZO_TILE_SCHEDULER_H_
+#define _PKZO_TILE_SCHEDULER_H_
+
+#include <functional>
+#include <rgm/rgm.h>
+
+#include "config.h"
+#include "ThreadPool.h"
+
+namespace pkzo
+{
+    // a rectangle of the output, in pixels
+    struct Tile
+    {
+        rgm::uvec2 origin;
+        rgm::uvec2 size;
+    };
+
+    // Splits an image into tiles and runs a kernel on them on a ThreadPool.
+    //
+    // A tile is sized so that what the kernel reads and writes for it fits
+    // into the L2 cache of one core: its pixels and the halo of neighbors
+    // around it, in each float plane the kernel touches. Tiles start at
+    // multiples of 16 pixels along x, so that with rows aligned to 64
+    // bytes (see CpuImage) no two tiles write to the same cache line.
+    class PKZO_EXPORT TileScheduler
+    {
+    public:
+
+        // 0 threads is one per hardware thread, a cache size of 0 is the L2
+        // cache size of the processor
+        TileScheduler(unsigned int threads = 0, size_t cache_size = 0);
+
+        ~TileScheduler();
+
+        unsigned int get_thread_count() const;
+
+        // bytes per tile
+        size_t get_cache_size() const;
+
+        ThreadPool& get_pool();
+
+        // For a kernel that reads halo pixels around each output pixel in
+        // planes float planes (inputs and outputs together).
+        rgm::uvec2 get_tile_size(rgm::uvec2 size, unsigned int halo, unsigned int planes) const;
+
+        // Run kernel on every tile of an image of size and wait for it.
+        void run(rgm::uvec2 size, rgm::uvec2 tile, const std::function<void (const Tile&)>& kernel);
+
+        void run(rgm::uvec2 size, unsigned int halo, unsigned int planes, const std::function<void (const Tile&)>& kernel);
+
+        // Run kernel on bands of rows first .. first + count, for work that
+        // goes along whole rows.
+        void run_rows(unsigned int height, const std::function<void (unsigned int first, unsigned int count)>& kernel);
+
+    private:
+        ThreadPool pool;
+        size_t     cache_size;
+
+        TileScheduler(const TileScheduler&) = delete;
+        const TileScheduler& operator = (const TileScheduler&) = delete;
+    };
+
+    // the L2 cache of one core, or 256 KiB if it can not be found out
+    PKZO_EXPORT size_t get_l2_cache_size();
+}
+
+#endif
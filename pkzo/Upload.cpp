@@ -0,0 +1,164 @@
+
+#include "Upload.h"
+
+#include <stdexcept>
+#include <GL/glew.h>
+
+namespace pkzo
+{
+    UploadRing::UploadRing(unsigned int count)
+    : next(0), persistent(GLEW_ARB_buffer_storage == GL_TRUE)
+    {
+        if (count == 0)
+        {
+            throw std::invalid_argument("UploadRing: count must not be 0");
+        }
+
+        slots.resize(count);
+        for (Slot& slot : slots)
+        {
+            slot.pbo      = 0;
+            slot.capacity = 0;
+            slot.ptr      = NULL;
+            slot.fence    = NULL;
+            slot.busy     = false;
+        }
+    }
+
+    UploadRing::~UploadRing()
+    {
+        for (Slot& slot : slots)
+        {
+            release(slot);
+            if (slot.fence != NULL)
+            {
+                glDeleteSync((GLsync)slot.fence);
+            }
+            if (slot.pbo != 0)
+            {
+                glDeleteBuffers(1, &slot.pbo);
+            }
+        }
+    }
+
+    Staging UploadRing::map(size_t bytes)
+    {
+        // staging memory a decoder still fills is skipped
+        unsigned int i = next;
+        while (slots[i].busy)
+        {
+            i = (i + 1) % slots.size();
+            if (i == next)
+            {
+                Slot slot = {0, 0, NULL, NULL, false};
+                slots.push_back(slot);
+                i = slots.size() - 1;
+                break;
+            }
+        }
+        next = (i + 1) % slots.size();
+
+        Slot& slot = slots[i];
+
+        // the previous upload from this buffer must be done before it is 
+        // overwritten; with a deep enough ring this does not wait
+        if (slot.fence != NULL)
+        {
+            GLenum r = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (r == GL_TIMEOUT_EXPIRED)
+            {
+                r = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync((GLsync)slot.fence);
+            slot.fence = NULL;
+        }
+
+        if (persistent)
+        {
+            if (slot.capacity < bytes)
+            {
+                if (slot.pbo != 0)
+                {
+                    glDeleteBuffers(1, &slot.pbo);
+                }
+
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glGenBuffers(1, &slot.pbo);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags);
+                slot.ptr = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+                slot.capacity = bytes;
+            }
+        }
+        else
+        {
+            if (slot.pbo == 0)
+            {
+                glGenBuffers(1, &slot.pbo);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            // orphan the old storage, the driver can hand out fresh memory
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            slot.ptr = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            slot.capacity = bytes;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (slot.ptr == NULL)
+        {
+            throw std::runtime_error("Failed to map upload buffer.");
+        }
+
+        slot.busy = true;
+
+        Staging staging = {i, slot.ptr, bytes};
+        return staging;
+    }
+
+    void UploadRing::upload(Texture& texture, Staging staging)
+    {
+        rgm::uvec2  size   = texture.get_size();
+        ColorFormat format = texture.get_format();
+        if (staging.size < size[0] * size[1] * get_pixel_size(format))
+        {
+            throw std::invalid_argument("UploadRing::upload: staging buffer too small");
+        }
+
+        // allocate the storage before the unpack buffer is bound
+        texture.upload();
+
+        Slot& slot = slots.at(staging.slot);
+        release(slot);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glBindTexture(GL_TEXTURE_2D, texture.get_glid());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size[0], size[1], get_gl_format(format), get_gl_type(format), 0);
+        if (texture.get_levels() > 1)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void UploadRing::discard(Staging staging)
+    {
+        release(slots.at(staging.slot));
+    }
+
+    void UploadRing::release(Slot& slot)
+    {
+        if (slot.busy && !persistent)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            slot.ptr = NULL;
+        }
+        slot.busy = false;
+    }
+}
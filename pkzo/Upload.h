@@ -0,0 +1,63 @@
+
+#ifndef _PKZO_UPLOAD_H_
+#define _PKZO_UPLOAD_H_
+
+#include <vector>
+
+#include "config.h"
+#include "Texture.h"
+
+namespace pkzo
+{
+    // Driver visible memory for one upload. It may be filled from any thread,
+    // but has to be handed back to UploadRing::upload or discard on the GL
+    // thread.
+    struct Staging
+    {
+        unsigned int   slot;
+        unsigned char* data;
+        size_t         size;
+    };
+
+    // A ring of pixel unpack buffers to stream texture data. With 
+    // GL_ARB_buffer_storage the buffers are persistently mapped, otherwise
+    // they are orphaned and mapped for each upload. Either way the texture 
+    // upload is a copy on the GPU timeline, not a synchronous driver copy.
+    class PKZO_EXPORT UploadRing
+    {
+    public:
+
+        UploadRing(unsigned int count = 3);
+
+        ~UploadRing();
+
+        // Buffers stay taken until handed back, the ring grows if all are.
+        Staging map(size_t bytes);
+
+        void upload(Texture& texture, Staging staging);
+
+        // give back memory that was not filled after all
+        void discard(Staging staging);
+
+    private:
+        struct Slot
+        {
+            unsigned int   pbo;
+            size_t         capacity;
+            unsigned char* ptr;
+            void*          fence;
+            bool           busy;
+        };
+
+        std::vector<Slot> slots;
+        unsigned int      next;
+        bool              persistent;
+
+        void release(Slot& slot);
+
+        UploadRing(const UploadRing&) = delete;
+        const UploadRing& operator = (const UploadRing&) = delete;
+    };
+}
+
+#endif
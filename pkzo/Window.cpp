@@ -1,12 +1,32 @@
 #include "Window.h"
 
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
 #include <GL/glew.h>
+
+#ifdef _WIN32
 #include <GL/wglew.h>
+#else
+#define MESA_EGL_NO_X11_HEADERS
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 #include "utils.h"
+#include "compose.h"
+#include "FrameBuffer.h"
 
 namespace pkzo
 {
+    double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> d = std::chrono::high_resolution_clock::now() - start;
+        return d.count();
+    }
+
+#ifdef _WIN32
     LRESULT	CALLBACK ogl_wnd_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
     {
         switch(msg)
@@ -50,7 +70,7 @@ namespace pkzo
 
             if(!RegisterClassEx(&wc))
             {
-                throw std::runtime_error(get_last_error());
+                throw ContextError(get_last_error());
             }
 
             done = true;
@@ -58,23 +78,27 @@ namespace pkzo
     }
 
     Window::Window(const std::string& title, rgm::ivec2 pos, rgm::uvec2 s)
-    : hwnd(NULL), hdc(NULL), hrc(NULL), size(s)
+    : hwnd(NULL), hdc(NULL), hrc(NULL), size(s), startup_time(0)
     {
         // TODO clean up when an exception happens
 
+        // NOTE: this includes the throwaway context needed to get at 
+        // wglCreateContextAttribsARB; that is the price of the WGL path.
+        auto start = std::chrono::high_resolution_clock::now();
+
         HINSTANCE hInstance = GetModuleHandle(NULL);
         create_ogl_window_class(hInstance);
     
         hwnd = CreateWindowEx(NULL, L"OGL_WINDOW", widen(title).c_str(), WS_OVERLAPPEDWINDOW, pos[0], pos[1], size[0], size[1], NULL, NULL, hInstance, this);
         if(hwnd == NULL)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
         
         hdc = GetDC(hwnd);
         if (hdc == NULL)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
         
         PIXELFORMATDESCRIPTOR pfd; 
@@ -89,32 +113,32 @@ namespace pkzo
         int pf = ChoosePixelFormat(hdc, &pfd);
         if (pf == 0)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
 
         BOOL br = SetPixelFormat(hdc, pf, &pfd);
         if (br == FALSE)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
 
         HGLRC tmprc = wglCreateContext(hdc);
         if (tmprc == NULL)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
 
         br = wglMakeCurrent(hdc, tmprc);
         if (br == FALSE)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
 
         glewExperimental = GL_TRUE;
         GLenum err = glewInit();
         if (GLEW_OK != err)
         {
-            throw std::runtime_error((const char*)glewGetErrorString(err));
+            throw ContextError((const char*)glewGetErrorString(err));
         }  
         
         int attributes[] = {
@@ -128,7 +152,7 @@ namespace pkzo
         hrc = wglCreateContextAttribsARB(hdc, NULL, attributes);
         if (hrc == NULL)
         {
-            throw std::runtime_error(get_last_error());
+            throw ContextError(get_last_error());
         }
 
         wglMakeCurrent(NULL, NULL);
@@ -139,6 +163,8 @@ namespace pkzo
         glGetIntegerv(GL_MAJOR_VERSION, &glVersion[0]);
         glGetIntegerv(GL_MINOR_VERSION, &glVersion[1]);
 
+        startup_time = elapsed_ms(start);
+
         glViewport(0, 0, size[0], size[1]);
     }        
 
@@ -212,4 +238,202 @@ namespace pkzo
             }
         }        
     }
+#else
+    std::string get_egl_error()
+    {
+        std::stringstream buff;
+        buff << "0x" << std::hex << eglGetError();
+        return buff.str();
+    }
+
+    void check_egl(EGLBoolean r, const char* what)
+    {
+        if (r == EGL_FALSE)
+        {
+            throw ContextError(compose("%0 failed with %1.", what, get_egl_error()));
+        }
+    }
+
+    bool has_egl_extension(EGLDisplay dpy, const std::string& name)
+    {
+        const char* exts = eglQueryString(dpy, EGL_EXTENSIONS);
+        if (exts == NULL)
+        {
+            return false;
+        }
+        std::string all = std::string(" ") + exts + " ";
+        return all.find(" " + name + " ") != std::string::npos;
+    }
+
+    EGLDisplay get_egl_display()
+    {
+        // Prefer the surfaceless platform; it does not need a display server
+        // and works on bare render nodes. Fall back to the default display.
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display != NULL && has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+        {
+            EGLDisplay dpy = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (dpy != EGL_NO_DISPLAY)
+            {
+                return dpy;
+            }
+        }
+
+        EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (dpy == EGL_NO_DISPLAY)
+        {
+            throw ContextError("Failed to get an EGL display.");
+        }
+        return dpy;
+    }
+
+    Window::Window(const std::string&, rgm::ivec2, rgm::uvec2 s)
+    : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), target(NULL), running(false), size(s), startup_time(0)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        EGLDisplay dpy = get_egl_display();
+
+        EGLint major = 0;
+        EGLint minor = 0;
+        check_egl(eglInitialize(dpy, &major, &minor), "eglInitialize");
+        display = dpy;
+
+        // the destructor does not run if the constructor throws
+        try
+        {
+            if (!has_egl_extension(dpy, "EGL_KHR_surfaceless_context"))
+            {
+                throw ContextError("EGL_KHR_surfaceless_context is not supported.");
+            }
+
+            check_egl(eglBindAPI(EGL_OPENGL_API), "eglBindAPI");
+
+            EGLConfig config = NULL;
+            if (!has_egl_extension(dpy, "EGL_KHR_no_config_context"))
+            {
+                EGLint config_attributes[] = {
+                    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                    EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+                    EGL_NONE
+                };
+                EGLint count = 0;
+                check_egl(eglChooseConfig(dpy, config_attributes, &config, 1, &count), "eglChooseConfig");
+                if (count == 0)
+                {
+                    throw ContextError("No suitable EGL config.");
+                }
+            }
+
+            EGLint attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+                EGL_CONTEXT_MINOR_VERSION_KHR, 0,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+                EGL_NONE
+            };
+
+            EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, attributes);
+            if (ctx == EGL_NO_CONTEXT)
+            {
+                throw ContextError(compose("eglCreateContext failed with %0.", get_egl_error()));
+            }
+            context = ctx;
+
+            check_egl(eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx), "eglMakeCurrent");
+
+            // NOTE: glewInit will also try to initialize GLX, which does not apply 
+            // to an EGL context; only the GL part matters here.
+            glewExperimental = GL_TRUE;
+            GLenum err = glewInit();
+            if (err != GLEW_OK && err != GLEW_ERROR_GLX_VERSION_11_ONLY)
+            {
+                throw ContextError((const char*)glewGetErrorString(err));
+            }
+            // glewInit may leave a GL_INVALID_ENUM from glGetString(GL_EXTENSIONS)
+            glGetError();
+
+            startup_time = elapsed_ms(start);
+
+            target = new FrameBuffer(size);
+        }
+        catch (...)
+        {
+            eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT)
+            {
+                eglDestroyContext(dpy, context);
+            }
+            eglTerminate(dpy);
+            throw;
+        }
+    }
+
+    Window::~Window()
+    {
+        delete target;
+
+        EGLDisplay dpy = display;
+        eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(dpy, context);
+        eglTerminate(dpy);
+    }
+
+    void Window::show(int)
+    {
+        // there is nothing to show
+    }
+
+    void Window::hide() {}
+
+    void Window::close()
+    {
+        running = false;
+    }
+
+    void Window::on_draw(std::function<void ()> cb)
+    {
+        draw_cb = cb;
+    }
+
+    void Window::draw()
+    {
+        target->bind();
+        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+        if (draw_cb)
+        {
+            draw_cb();
+        }
+    }
+
+    Texture Window::read_color()
+    {
+        std::vector<unsigned char> data(size[0] * size[1] * 4);
+        target->bind();
+        glReadPixels(0, 0, size[0], size[1], GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        return Texture(size, RGBA, std::move(data));
+    }
+
+    void Window::run()
+    {
+        running = true;
+        while (running)
+        {
+            draw();
+        }
+    }
+#endif
+
+    double Window::get_startup_time() const
+    {
+        return startup_time;
+    }
+
+    void Window::finish()
+    {
+        glFinish();
+    }
 }
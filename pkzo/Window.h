@@ -5,13 +5,31 @@
 #include "config.h"
 
 #include <functional>
-#include <windows.h>
+#include <stdexcept>
 #include <rgm/rgm.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "Texture.h"
 
 namespace pkzo
 {
+    class FrameBuffer;
+
+    // No OpenGL context could be created, e.g. on a machine without a GPU
+    // or driver.
+    class PKZO_EXPORT ContextError : public std::runtime_error
+    {
+    public:
+        ContextError(const std::string& what)
+        : std::runtime_error(what) {}
+    };
+
+    // On Windows this is a window with a WGL 4.0 context. Everywhere else a 
+    // surfaceless EGL context is created and everything is rendered into an
+    // offscreen FrameBuffer; there is no window and no swap chain.
     class PKZO_EXPORT Window
     {
     public:
@@ -23,7 +41,11 @@ namespace pkzo
 
         const Window& operator = (const Window&);
 
+    #ifdef _WIN32
         void show(int cmd = SW_SHOW);
+    #else
+        void show(int cmd = 0);
+    #endif
 
         void hide();
 
@@ -37,12 +59,26 @@ namespace pkzo
         
         void run();
 
+        // time in ms it took to create the OpenGL context
+        double get_startup_time() const;
+
+        // wait until the GPU has run all commands so far, to time them
+        void finish();
+
     private:
+    #ifdef _WIN32
         HWND  hwnd;
         HDC   hdc;
         HGLRC hrc;
+    #else
+        void*        display;
+        void*        context;
+        FrameBuffer* target;
+        bool         running;
+    #endif
 
         rgm::uvec2 size;
+        double     startup_time;
 
         std::function<void ()> draw_cb;
     };
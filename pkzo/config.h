@@ -2,8 +2,14 @@
 #ifndef _PKZO_CONFIG_H_
 #define _PKZO_CONFIG_H_
 
+#ifdef _WIN32
 #define PKZO_EXPORT __declspec(dllexport)
+#else
+#define PKZO_EXPORT __attribute__((visibility("default")))
+#endif
 
+#ifdef _MSC_VER
 #pragma warning (disable: 4251)
+#endif
 
 #endif
@@ -4,8 +4,20 @@
 
 #include "Window.h"
 #include "FrameBuffer.h"
+#include "ResourcePool.h"
 #include "Texture.h"
+#include "Png.h"
+#include "Preprocessor.h"
 #include "Shader.h"
+#include "ProgramCache.h"
 #include "Mesh.h"
+#include "Kernel.h"
+#include "Readback.h"
+#include "Upload.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
+#include "CpuImage.h"
+#include "CpuFilter.h"
+#include "CpuProgram.h"
 
 #endif
@@ -1,6 +1,8 @@
 
 #include "utils.h"
 
+#ifdef _WIN32
+
 #include <vector>
 #include <stdexcept>
 #include <windows.h>
@@ -73,3 +75,4 @@ void show_message_box(const std::string& caption, const std::string& text)
     MessageBox(NULL, widen(text).c_str(), widen(caption).c_str(), MB_OK|MB_ICONERROR);
 }
 
+#endif
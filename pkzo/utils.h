@@ -4,6 +4,8 @@
 
 #include <string>
 
+#ifdef _WIN32
+
 std::wstring widen(const char* str);
 std::wstring widen(const std::string& str);
 std::string narrow(const wchar_t* str);
@@ -13,3 +15,5 @@ std::string get_last_error();
 void show_message_box(const std::string& caption, const std::string& text);
 
 #endif
+
+#endif
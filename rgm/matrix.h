@@ -183,6 +183,9 @@ namespace rgm
 
         matrix2(const matrix<T, 2>& v)
             : matrix<T, 2>(v) {}
+
+    protected:
+        using matrix<T, 2>::data;
     };
 
     template <typename T>
@@ -227,6 +230,9 @@ namespace rgm
             data[7] = v[2][1];
             data[8] = v[0][2];
         }
+
+    protected:
+        using matrix<T, 3>::data;
     };
 
     template <typename T>
@@ -264,6 +270,9 @@ namespace rgm
 
         matrix4(const matrix<T, 4>& v)
             : matrix<T, 4>(v) {}
+
+    protected:
+        using matrix<T, 4>::data;
     };
 
     template <typename T, unsigned int N>
@@ -311,10 +320,13 @@ namespace rgm
     template <typename T, unsigned int N>
     matrix<T, N> operator + (const matrix<T, N>& a, const matrix<T, N>& b)
     {
-        matrix<T, N> rt(0);
+        matrix<T, N> r((T)0);
         for (unsigned int i = 0; i < N; i++)
         {
-            r[i][j] = a[i][j] + b[i][j];
+            for (unsigned int j = 0; j < N; j++)
+            {
+                r[i][j] = a[i][j] + b[i][j];
+            }
         }
         return r;
     }
@@ -322,10 +334,13 @@ namespace rgm
     template <typename T, unsigned int N>
     matrix<T, N> operator - (const matrix<T, N>& a, const matrix<T, N>& b)
     {
-        matrix<T, N> rt(0);
+        matrix<T, N> r((T)0);
         for (unsigned int i = 0; i < N; i++)
         {
-            r[i][j] = a[i][j] + b[i][j];
+            for (unsigned int j = 0; j < N; j++)
+            {
+                r[i][j] = a[i][j] - b[i][j];
+            }
         }
         return r;
     }
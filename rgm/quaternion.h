@@ -45,6 +45,9 @@ namespace rgm
         {
             return vector3<T>(data[0], data[1], data[2]);
         }
+
+    protected:
+        using vector4<T>::data;
     };
 
     template <typename T>
@@ -0,0 +1,53 @@
+#version 400
+
+// The average of the (2 * RADIUS_X + 1) x (2 * RADIUS_Y + 1) rectangle 
+// around each pixel, from a summed-area table: prefix sums along x and then
+// along y (see sat.pipeline). Four lookups whatever the size. Pixels past 
+// the image count as 0. The table sums up to the whole image, so small
+// rectangles lose more to float rounding than with box.pipeline, which
+// sums only along rows or columns.
+
+#ifndef RADIUS
+#define RADIUS 25
+#endif
+
+#ifndef RADIUS_X
+#define RADIUS_X RADIUS
+#endif
+
+#ifndef RADIUS_Y
+#define RADIUS_Y RADIUS
+#endif
+
+#pragma cpu(satbox)
+#pragma footprint(RADIUS_X)
+#pragma footprint(RADIUS_Y)
+
+uniform sampler2D uTexture;
+uniform uvec2 uTextureSize;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+// the sum of the pixels up to and including p
+vec3 sat(ivec2 p)
+{
+    if (p.x < 0 || p.y < 0)
+    {
+        return vec3(0);
+    }
+    return texelFetch(uTexture, min(p, ivec2(uTextureSize) - 1), 0).rgb;
+}
+
+void main(void)
+{
+    ivec2 p  = ivec2(vTexCoord);
+    ivec2 lo = p - ivec2(RADIUS_X, RADIUS_Y) - 1;
+    ivec2 hi = p + ivec2(RADIUS_X, RADIUS_Y);
+
+    vec3 bottom = sat(hi) - sat(ivec2(lo.x, hi.y));
+    vec3 top    = sat(ivec2(hi.x, lo.y)) - sat(lo);
+
+    oFragColor = vec4((bottom - top) / float((2 * RADIUS_X + 1) * (2 * RADIUS_Y + 1)), 1);
+}
@@ -0,0 +1,43 @@
+#version 400
+
+// Prefix sums along DIRECTION in runs of CHUNK pixels: each pixel gets the
+// sum of itself and the pixels before it in its run. carry.frag adds the 
+// totals of the runs before, which gives the prefix sums of whole rows or
+// columns (see box.pipeline); scan.comp computes the same with --compute.
+// The sums outgrow 8 bit, so they are kept as rgba32f.
+//
+// No footprint: box.frag and satbox.frag only take differences of the 
+// sums, which are the same wherever the sums start, so the sums of a tile
+// do as well as those of the whole image.
+
+#ifndef DIRECTION
+#define DIRECTION ivec2(1, 0)
+#endif
+
+#ifndef CHUNK
+#define CHUNK 128
+#endif
+
+#pragma cpu(scan)
+#pragma output(rgba32f)
+
+uniform sampler2D uTexture;
+uniform uvec2 uTextureSize;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    ivec2 pixel = ivec2(vTexCoord);
+    int   run   = (pixel.x * DIRECTION.x + pixel.y * DIRECTION.y) % CHUNK;
+
+    vec3 result = vec3(0);
+    for (int i = -run; i <= 0; i++)
+    {
+        result += texelFetch(uTexture, pixel + DIRECTION * i, 0).rgb;
+    }
+
+    oFragColor = vec4(result, 1);
+}
@@ -0,0 +1,41 @@
+#version 400
+
+// Separable gaussian blur, one direction per pass; run it twice, the second
+// time with DIRECTION=ivec2(0,1) (see sepgauss.pipeline). The weights are 
+// computed once on the CPU from SIGMA (and optionally RADIUS) and passed in
+// uOffsets / uWeights, with neighboring taps merged into one bilinear 
+// lookup. glslproc defines TAPS and RADIUS to match.
+
+#ifndef TAPS
+#error sepgauss.frag needs SIGMA to be defined.
+#endif
+
+#ifndef DIRECTION
+#define DIRECTION ivec2(1, 0)
+#endif
+
+#pragma footprint(RADIUS)
+
+uniform sampler2D uTexture;
+uniform uvec2 uTextureSize;
+uniform float uOffsets[TAPS];
+uniform float uWeights[TAPS];
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    vec2 size   = vec2(uTextureSize);
+    vec2 step   = vec2(DIRECTION);
+    vec3 result = texelFetch(uTexture, ivec2(vTexCoord), 0).rgb * uWeights[0];
+    for (int i = 1; i < TAPS; i++)
+    {
+        vec2 offset = step * uOffsets[i];
+        result += textureLod(uTexture, (vTexCoord + offset) / size, 0.0).rgb * uWeights[i];
+        result += textureLod(uTexture, (vTexCoord - offset) / size, 0.0).rgb * uWeights[i];
+    }
+
+    oFragColor = vec4(result, 1);
+}
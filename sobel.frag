@@ -1,5 +1,8 @@
 #version 330 core
 
+#pragma cpu(sobel)
+#pragma footprint(1)
+
 uniform sampler2D uTexture;
 uniform uvec2 uTextureSize;
 
@@ -3,13 +3,17 @@
 
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
+
+#include "path.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #include <shlwapi.h>
 #pragma comment(lib, "shlwapi.lib")
 #else
-
+#include <sys/stat.h>
+#include <errno.h>
 #endif
 
 namespace fs
@@ -36,12 +40,58 @@ namespace fs
         return result;
     }
 
+    void write(const std::string& file, const std::string& data)
+    {
+        std::ofstream output(file.c_str(), std::ios::binary);
+        if (!output.good())
+        {
+            std::stringstream msg;
+            msg << "Failed to open file " << file << " for writing.";
+            throw std::runtime_error(msg.str());
+        }
+
+        output.write(data.data(), data.size());
+        if (!output.good())
+        {
+            std::stringstream msg;
+            msg << "Failed to write file " << file << ".";
+            throw std::runtime_error(msg.str());
+        }
+    }
+
     bool exists(const std::string& file)
     {
     #ifdef _WIN32
         return PathFileExistsA(file.c_str()) == TRUE;
     #else
-    #error PORT ME
+        struct stat st;
+        return stat(file.c_str(), &st) == 0;
+    #endif
+    }
+
+    void mkdir(const std::string& dir)
+    {
+        if (dir.empty() || exists(dir))
+        {
+            return;
+        }
+
+        std::string parent = path::dirname(dir);
+        if (parent != dir)
+        {
+            mkdir(parent);
+        }
+
+    #ifdef _WIN32
+        bool ok = CreateDirectoryA(dir.c_str(), NULL) == TRUE || GetLastError() == ERROR_ALREADY_EXISTS;
+    #else
+        bool ok = ::mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
     #endif
+        if (!ok)
+        {
+            std::stringstream msg;
+            msg << "Failed to create directory " << dir << ".";
+            throw std::runtime_error(msg.str());
+        }
     }
-}
\ No newline at end of file
+}
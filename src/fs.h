@@ -8,7 +8,12 @@ namespace fs
 {
     std::string read(const std::string& file);
 
+    void write(const std::string& file, const std::string& data);
+
     bool exists(const std::string& file);
+
+    // create dir and any missing parents
+    void mkdir(const std::string& dir);
 }
 
 #endif
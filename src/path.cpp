@@ -10,6 +10,8 @@
 #define SEP  '\\'
 #define WSEP '/'
 #else
+#include <climits>
+#include <cstdlib>
 #define SEP  '/'
 #define WSEP '\\'
 #endif
@@ -104,13 +106,21 @@ namespace path
             throw std::runtime_error("Failed to canocialize path.");
         }
         #else
-        #error PORT ME
+        char buffer[PATH_MAX];
+        if (realpath(path.c_str(), buffer) != NULL)
+        {
+            return std::string(buffer);
+        }
+        else
+        {
+            throw std::runtime_error("Failed to canocialize path.");
+        }
         #endif
     }
 
     std::string dirname(const std::string& file)
     {
-        unsigned int i = file.find_last_of("\\/");
+        size_t i = file.find_last_of("\\/");
         if (i == std::string::npos)
         {
             return "";
@@ -123,7 +133,7 @@ namespace path
 
     std::string basename(const std::string& file)
     {
-        unsigned int i = file.find_last_of("\\/");
+        size_t i = file.find_last_of("\\/");
         if (i == std::string::npos)
         {
             return file;
@@ -169,6 +179,16 @@ namespace path
         return normalize(ac + SEP + bc);
     }
 
+    bool is_absolute(const std::string& path)
+    {
+        if (path.empty())
+        {
+            return false;
+        }
+        // /foo, \\server\foo or C:\foo
+        return path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':');
+    }
+
     std::string diff(const std::string& start, const std::string& target)
     {
         std::string cstart  = canonicalize(start);
@@ -224,7 +244,12 @@ namespace path
             throw std::runtime_error("Failed to get temp path.");
         }
     #else
-    #error PORT ME
+        const char* tmp = getenv("TMPDIR");
+        if (tmp != NULL)
+        {
+            return std::string(tmp);
+        }
+        return "/tmp";
     #endif
     }
 
@@ -240,8 +265,13 @@ namespace path
 
         return join(tmp, name);
     #else
-    // $HOME/.<name>/
-    #error PORT ME
+        const char* home = getenv("HOME");
+        if (home == NULL)
+        {
+            throw std::runtime_error("Failed to get HOME folder!");
+        }
+
+        return join(home, "." + name);
     #endif
     }
 }
@@ -32,6 +32,8 @@ namespace path
     std::string diff(const std::string& start, const std::string& target);
 
     std::string ext(const std::string& file);
+
+    bool is_absolute(const std::string& path);
     
     std::string tempdir();
 
@@ -0,0 +1,55 @@
+
+// Checks of pkzo::Shader that need no OpenGL context; run from the
+// repository root, where the bundled shaders are.
+
+#include <iostream>
+#include <stdexcept>
+#include <pkzo/pkzo.h>
+
+unsigned int failed = 0;
+
+void check(bool value, const std::string& what)
+{
+    if (!value)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failed++;
+    }
+}
+
+bool needs_mipmaps(const std::string& fragment_code)
+{
+    pkzo::Shader shader;
+    shader.set_fragment_code(fragment_code);
+    return shader.needs_mipmaps();
+}
+
+int main()
+{
+    try
+    {
+        pkzo::Shader sepgauss;
+        sepgauss.load("pass.vert", "sepgauss.frag");
+        check(!sepgauss.needs_mipmaps(), "sepgauss.frag samples at LOD 0 only");
+
+        pkzo::Shader sobel;
+        sobel.load("pass.vert", "sobel.frag");
+        check(!sobel.needs_mipmaps(), "sobel.frag only uses texelFetch");
+
+        check(needs_mipmaps("vec4 c = texture(uTexture, uv);"), "texture is filtered");
+        check(needs_mipmaps("vec4 c = textureLod(uTexture, uv, 2.0);"), "textureLod at LOD 2 is filtered");
+        check(needs_mipmaps("vec4 c = textureLod(uTexture, f(uv, 0.0), lod);"), "textureLod at a computed LOD is filtered");
+        check(needs_mipmaps("vec4 c = textureGrad(uTexture, uv, dx, dy);"), "textureGrad is filtered");
+        check(!needs_mipmaps("vec4 c = textureLod(uTexture, f(uv, 1.0), 0.0);"), "textureLod at LOD 0.0 is not filtered");
+        check(!needs_mipmaps("vec4 c = textureLodOffset(uTexture, uv, 0, ivec2(1, 0));"), "textureLodOffset at LOD 0 is not filtered");
+        check(!needs_mipmaps("ivec2 s = textureSize(uTexture, 0); vec4 g = textureGather(uTexture, uv);"), "size queries and gathers are not filtered");
+        check(!needs_mipmaps("// texture(uTexture, uv)\nvec4 c = texelFetch(uTexture, p, 0);"), "comments are ignored");
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return -1;
+    }
+
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,14 @@
+#version 330 core
+
+// Black or white, depending on the luminance; alpha is kept.
+#pragma pointwise
+
+#ifndef THRESHOLD
+#define THRESHOLD 0.5
+#endif
+
+vec4 apply(vec4 color)
+{
+    float luminance = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+    return vec4(vec3(step(THRESHOLD, luminance)), color.a);
+}
@@ -0,0 +1,23 @@
+#version 400
+
+// Unsharp mask: sharpen by adding back what a blur took away.
+// uTexture0 is the original, uTexture1 the blurred image.
+
+#ifndef AMOUNT
+#define AMOUNT 1.0
+#endif
+
+uniform sampler2D uTexture0;
+uniform sampler2D uTexture1;
+
+in vec2 vTexCoord;
+
+out vec4 oFragColor;
+
+void main(void)
+{
+    vec3 original = texelFetch(uTexture0, ivec2(vTexCoord), 0).rgb;
+    vec3 blurred  = texelFetch(uTexture1, ivec2(vTexCoord), 0).rgb;
+
+    oFragColor = vec4(clamp(original + AMOUNT * (original - blurred), 0.0, 1.0), 1);
+}